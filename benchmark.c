@@ -0,0 +1,494 @@
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "src/magic.h"
+
+/**
+ * Reproducible benchmark of the MAGIC ADT
+ * Every workload is generated from a fixed seed with its own generator (not rand()),
+ * so two runs, or two engines, replay exactly the same operations and queries.
+ * Every operation and every query is timed on the monotonic wall clock (minus the
+ * cost of the timer itself) and reported in ns/op as mean, p50, p99 and p999.
+ *
+ * Workloads (positions spread over 10 x the number of operations):
+ * 1) uniform: operations and queries anywhere in the stream
+ * 2) clustered: operations in three hot regions, as in runStressTest
+ * 3) spike: uniform, with the middle third of the operations in a 1% window, as in runSpikeTest
+ * 4) append: operations at the end of the output stream, as when writing a file
+ * 5) large: lengths up to 2^30 and positions up to 2^40, as in runVolumeTest
+ *
+ * Usage: benchmark [--engine NAME] [--workload NAME] [--min-ops N] [--max-ops N]
+ *                  [--queries N] [--seed N] [--repeat N] [--budget SECONDS]
+ *                  [--json FILE] [--baseline FILE] [--threshold PERCENT]
+ * The number of operations sweeps powers of 10 from min-ops (10^2) to max-ops (10^5,
+ * up to 10^7). Every cell is run repeat times (3) and the run with the lowest p50
+ * is kept, which filters out most of the noise of a shared machine. A cell taking
+ * longer than the budget (60 s) is cut short and the larger sizes of its engine and
+ * workload are skipped. With --baseline, the p50 of every cell is compared with a
+ * previous JSON output: the exit status is 1 if one is slower by more than the
+ * threshold (10%).
+*/
+
+#define MAX_RESULTS 1024
+#define NAME_LENGTH 32
+
+/* Generator of a workload: xorshift64* seeded per workload, engine and size */
+typedef struct {
+    uint64_t state;
+} Random;
+
+/* Operation or query of a workload */
+typedef struct {
+    int64_t pos;
+    int64_t length;      // 0 for a query
+    int add;             // 1 for MAGICadd, 0 for MAGICremove
+} Step;
+
+/* Generator state of a workload */
+typedef struct {
+    Random random;
+    int64_t range;       // positions are drawn in [0, range)
+    int64_t end;         // length of the output stream (append workload)
+    size_t count;        // operations generated so far
+    size_t total;        // operations of the run
+} Workload;
+
+typedef void (*Generator)(Workload *w, Step *step, int query);
+
+/* Latency statistics of one phase of one cell */
+typedef struct {
+    char workload[NAME_LENGTH];
+    char engine[NAME_LENGTH];
+    size_t ops;
+    char phase[NAME_LENGTH];
+    size_t samples;
+    double mean;
+    double p50;
+    double p99;
+    double p999;
+} Result;
+
+/* Options of the run */
+typedef struct {
+    const char *engine;
+    const char *workload;
+    size_t minOps;
+    size_t maxOps;
+    size_t queries;
+    uint64_t seed;
+    int repeat;
+    double budget;
+    const char *json;
+    const char *baseline;
+    double threshold;
+} Options;
+
+static Result results[MAX_RESULTS];
+static size_t nbResults = 0;
+static double timerOverhead = 0;
+
+void printSectionHeader(const char* title) {
+    printf("\n====== %s ======\n", title);
+}
+
+/* Wall-clock time in nanoseconds */
+uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+uint64_t nextRandom(Random *r) {
+    r->state ^= r->state >> 12;
+    r->state ^= r->state << 25;
+    r->state ^= r->state >> 27;
+    return r->state * 2685821657736338717ULL;
+}
+
+/* Uniform in [0, bound) */
+int64_t randomBelow(Random *r, int64_t bound) {
+    return (bound <= 0) ? 0 : (int64_t)(nextRandom(r) % (uint64_t)bound);
+}
+
+/* Seed mixing the run seed with the names and the size, so every cell is independent */
+uint64_t cellSeed(uint64_t seed, const char *workload, const char *engine, size_t ops) {
+    uint64_t h = seed ^ 0x9E3779B97F4A7C15ULL;
+    const char *names[] = {workload, engine};
+    for (int i = 0; i < 2; i++) {
+        for (const char *c = names[i]; *c != '\0'; c++)
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    h ^= ops * 0xBF58476D1CE4E5B9ULL;
+    return (h == 0) ? 1 : h;
+}
+
+void generateUniform(Workload *w, Step *step, int query) {
+    step->pos = randomBelow(&w->random, w->range);
+    step->length = query ? 0 : randomBelow(&w->random, 10) + 1;
+    step->add = (int)(nextRandom(&w->random) & 1);
+}
+
+void generateClustered(Workload *w, Step *step, int query) {
+    // Same regions as runStressTest: first 10%, 40-60% and last 10% of the stream
+    int64_t tenth = w->range / 10;
+    int64_t region = randomBelow(&w->random, 3);
+    if (region == 0) {
+        step->pos = randomBelow(&w->random, tenth);
+    } else if (region == 1) {
+        step->pos = 4 * tenth + randomBelow(&w->random, 2 * tenth);
+    } else {
+        step->pos = 9 * tenth + randomBelow(&w->random, tenth);
+    }
+    step->length = query ? 0 : randomBelow(&w->random, 5) + 1;
+    step->add = (int)(nextRandom(&w->random) & 1);
+}
+
+void generateSpike(Workload *w, Step *step, int query) {
+    // The middle third of the operations hit a window of 1% of the stream
+    int burst = !query && w->count >= w->total / 3 && w->count < 2 * w->total / 3;
+    if (burst) {
+        step->pos = w->range / 2 + randomBelow(&w->random, w->range / 100 + 1);
+    } else {
+        step->pos = randomBelow(&w->random, w->range);
+    }
+    step->length = query ? 0 : randomBelow(&w->random, 10) + 1;
+    step->add = (int)(nextRandom(&w->random) & 1);
+    if (!query)
+        w->count++;
+}
+
+void generateAppend(Workload *w, Step *step, int query) {
+    if (query) {
+        step->pos = randomBelow(&w->random, w->end + 1);
+        step->length = 0;
+        step->add = 0;
+        return;
+    }
+
+    // Mostly appends, sometimes a truncation of the last bytes
+    step->length = randomBelow(&w->random, 100) + 1;
+    step->add = (randomBelow(&w->random, 10) != 0 || w->end < step->length);
+    if (step->add) {
+        step->pos = w->end;
+        w->end += step->length;
+    } else {
+        step->pos = w->end - step->length;
+        w->end -= step->length;
+    }
+}
+
+void generateLarge(Workload *w, Step *step, int query) {
+    step->pos = randomBelow(&w->random, (int64_t)1 << 40);
+    step->length = query ? 0 : randomBelow(&w->random, (int64_t)1 << 30) + 1;
+    step->add = (int)(nextRandom(&w->random) & 1);
+}
+
+int compareLatency(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort the samples and compute their statistics (r->samples is 0 if there is none) */
+void computeResult(Result *r, const char *workload, const char *engine, size_t ops, const char *phase,
+                   uint32_t *samples, size_t n) {
+    r->samples = 0;
+    if (n == 0)
+        return;
+
+    qsort(samples, n, sizeof(uint32_t), compareLatency);
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += samples[i];
+
+    snprintf(r->workload, NAME_LENGTH, "%s", workload);
+    snprintf(r->engine, NAME_LENGTH, "%s", engine);
+    snprintf(r->phase, NAME_LENGTH, "%s", phase);
+    r->ops = ops;
+    r->samples = n;
+    r->mean = sum / n;
+    r->p50 = samples[(n - 1) / 2];
+    r->p99 = samples[(size_t)(0.99 * (n - 1))];
+    r->p999 = samples[(size_t)(0.999 * (n - 1))];
+}
+
+/* Print a result and keep it for the JSON output */
+void storeResult(const Result *r) {
+    if (r->samples == 0 || nbResults == MAX_RESULTS)
+        return;
+
+    results[nbResults++] = *r;
+    printf("%-10s %-8s %9zu %-7s %9zu samples  mean %10.1f  p50 %8.0f  p99 %8.0f  p999 %8.0f ns\n",
+           r->workload, r->engine, r->ops, r->phase, r->samples, r->mean, r->p50, r->p99, r->p999);
+}
+
+/* Latency of a sample, minus the cost of reading the clock */
+uint32_t latency(uint64_t start, uint64_t end) {
+    double ns = (double)(end - start) - timerOverhead;
+    if (ns < 0)
+        return 0;
+    return (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)ns;
+}
+
+/* Cost of two consecutive clock reads (the lowest, the most stable) */
+void calibrateTimer() {
+    uint32_t samples[10001];
+    for (int i = 0; i < 10001; i++) {
+        uint64_t start = nowNs();
+        samples[i] = (uint32_t)(nowNs() - start);
+    }
+    qsort(samples, 10001, sizeof(uint32_t), compareLatency);
+    timerOverhead = samples[0];
+}
+
+/*
+ * One run of a cell: ops operations of a workload on an engine, then the queries.
+ * Returns 0 if the budget ran out (the run is cut short).
+ */
+int runCell(const Options *options, const char *workload, Generator generate, const char *engineName,
+            enum MAGICEngine engine, size_t ops, Result *update, Result *map) {
+    Workload w;
+    w.random.state = cellSeed(options->seed, workload, engineName, ops);
+    w.range = (ops < 1000) ? 10000 : 10 * (int64_t)ops;
+    w.end = w.range;
+    w.count = 0;
+    w.total = ops;
+
+    MAGIC m = MAGICinitEngine(engine);
+    uint32_t *samples = malloc((ops > options->queries ? ops : options->queries) * sizeof(uint32_t));
+    if (m == NULL || samples == NULL) {
+        printf("Failed to initialize %s/%s with %zu operations\n", workload, engineName, ops);
+        MAGICdestroy(m);
+        free(samples);
+        return 0;
+    }
+
+    uint64_t deadline = nowNs() + (uint64_t)(options->budget * 1e9);
+    size_t done = 0;
+    for (; done < ops; done++) {
+        Step step;
+        generate(&w, &step, 0);
+
+        uint64_t start = nowNs();
+        if (step.add) {
+            MAGICadd64(m, step.pos, step.length);
+        } else {
+            MAGICremove64(m, step.pos, step.length);
+        }
+        uint64_t end = nowNs();
+
+        samples[done] = latency(start, end);
+        if (end > deadline)
+            break;
+    }
+    int complete = (done == ops);
+    computeResult(update, workload, engineName, ops, "update", samples, complete ? done : done + 1);
+
+    size_t queries = 0;
+    for (; complete && queries < options->queries; queries++) {
+        Step step;
+        generate(&w, &step, 1);
+        enum MAGICDirection direction = (queries % 2 == 0) ? STREAM_IN_OUT : STREAM_OUT_IN;
+
+        uint64_t start = nowNs();
+        volatile int64_t mapped = MAGICmap64(m, direction, step.pos);
+        uint64_t end = nowNs();
+        (void)mapped;
+
+        samples[queries] = latency(start, end);
+        if (end > deadline) {
+            queries++;
+            complete = 0;
+            break;
+        }
+    }
+    computeResult(map, workload, engineName, ops, "map", samples, queries);
+
+    free(samples);
+    MAGICdestroy(m);
+    return complete;
+}
+
+int writeJson(const Options *options) {
+    FILE *file = fopen(options->json, "w");
+    if (file == NULL) {
+        printf("Cannot write %s\n", options->json);
+        return 0;
+    }
+
+    // One result per line, so that baselines are read back line by line
+    fprintf(file, "{\n  \"seed\": %llu,\n  \"timer_overhead_ns\": %.1f,\n  \"results\": [\n",
+            (unsigned long long)options->seed, timerOverhead);
+    for (size_t i = 0; i < nbResults; i++) {
+        Result *r = &results[i];
+        fprintf(file, "    {\"workload\": \"%s\", \"engine\": \"%s\", \"ops\": %zu, \"phase\": \"%s\", "
+                      "\"samples\": %zu, \"mean_ns\": %.1f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f}%s\n",
+                r->workload, r->engine, r->ops, r->phase, r->samples, r->mean, r->p50, r->p99, r->p999,
+                (i + 1 < nbResults) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    fclose(file);
+    printf("\nResults written to %s\n", options->json);
+    return 1;
+}
+
+/* Compare the p50 of every cell with the baseline; returns the number of regressions */
+int compareBaseline(const Options *options) {
+    FILE *file = fopen(options->baseline, "r");
+    if (file == NULL) {
+        printf("Cannot read %s\n", options->baseline);
+        return 1;
+    }
+
+    printSectionHeader("BASELINE COMPARISON");
+    int regressions = 0, compared = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        Result base;
+        if (sscanf(line, " {\"workload\": \"%31[^\"]\", \"engine\": \"%31[^\"]\", \"ops\": %zu, "
+                         "\"phase\": \"%31[^\"]\", \"samples\": %zu, \"mean_ns\": %lf, \"p50_ns\": %lf, "
+                         "\"p99_ns\": %lf, \"p999_ns\": %lf",
+                   base.workload, base.engine, &base.ops, base.phase, &base.samples,
+                   &base.mean, &base.p50, &base.p99, &base.p999) != 9)
+            continue;
+
+        for (size_t i = 0; i < nbResults; i++) {
+            Result *r = &results[i];
+            if (strcmp(r->workload, base.workload) != 0 || strcmp(r->engine, base.engine) != 0 ||
+                r->ops != base.ops || strcmp(r->phase, base.phase) != 0)
+                continue;
+
+            // Below a few nanoseconds, differences are noise of the timer
+            double change = (base.p50 > 0) ? 100.0 * (r->p50 - base.p50) / base.p50 : 0;
+            int regression = change > options->threshold && r->p50 - base.p50 > 5;
+            compared++;
+            regressions += regression;
+            if (regression || change < -options->threshold) {
+                printf("%-11s %-10s %-8s %9zu %-7s p50 %8.0f -> %8.0f ns (%+.1f%%)\n",
+                       regression ? "REGRESSION" : "improvement", r->workload, r->engine, r->ops,
+                       r->phase, base.p50, r->p50, change);
+            }
+        }
+    }
+    fclose(file);
+
+    printf("%d cells compared, %d regressions over %.0f%%\n", compared, regressions, options->threshold);
+    return regressions;
+}
+
+int parseOptions(int argc, char **argv, Options *options) {
+    options->engine = "all";
+    options->workload = "all";
+    options->minOps = 100;
+    options->maxOps = 100000;
+    options->queries = 10000;
+    options->seed = 42;
+    options->repeat = 3;
+    options->budget = 60;
+    options->json = NULL;
+    options->baseline = NULL;
+    options->threshold = 10;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            printf("Missing value for %s\n", argv[i]);
+            return 0;
+        }
+
+        if (strcmp(argv[i], "--engine") == 0) {
+            options->engine = value;
+        } else if (strcmp(argv[i], "--workload") == 0) {
+            options->workload = value;
+        } else if (strcmp(argv[i], "--min-ops") == 0) {
+            options->minOps = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--max-ops") == 0) {
+            options->maxOps = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--queries") == 0) {
+            options->queries = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--repeat") == 0) {
+            options->repeat = atoi(value);
+        } else if (strcmp(argv[i], "--budget") == 0) {
+            options->budget = atof(value);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            options->json = value;
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            options->baseline = value;
+        } else if (strcmp(argv[i], "--threshold") == 0) {
+            options->threshold = atof(value);
+        } else {
+            printf("Unknown option %s\n", argv[i]);
+            return 0;
+        }
+        i++;
+    }
+
+    if (options->minOps == 0 || options->maxOps < options->minOps) {
+        printf("Invalid range of operations\n");
+        return 0;
+    }
+    if (options->repeat < 1)
+        options->repeat = 1;
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *workloadNames[] = {"uniform", "clustered", "spike", "append", "large"};
+    Generator generators[] = {generateUniform, generateClustered, generateSpike, generateAppend, generateLarge};
+    const char *engineNames[] = {"rbtree", "compact", "hybrid", "flat", "rope", "succinct"};
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE, MAGIC_ENGINE_SUCCINCT};
+
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+        return 2;
+
+    calibrateTimer();
+    printf("Seed %llu, timer overhead %.0f ns (subtracted)\n", (unsigned long long)options.seed, timerOverhead);
+
+    for (int w = 0; w < 5; w++) {
+        if (strcmp(options.workload, "all") != 0 && strcmp(options.workload, workloadNames[w]) != 0)
+            continue;
+        printSectionHeader(workloadNames[w]);
+
+        for (int e = 0; e < 6; e++) {
+            if (strcmp(options.engine, "all") != 0 && strcmp(options.engine, engineNames[e]) != 0)
+                continue;
+
+            for (size_t ops = options.minOps; ops <= options.maxOps; ops *= 10) {
+                // Same operations every run: keep the least disturbed one
+                Result best[2], run[2];
+                int complete = 1;
+                best[0].samples = best[1].samples = 0;
+                for (int r = 0; r < options.repeat && complete; r++) {
+                    complete = runCell(&options, workloadNames[w], generators[w], engineNames[e], engines[e],
+                                       ops, &run[0], &run[1]);
+                    for (int p = 0; p < 2; p++) {
+                        if (best[p].samples == 0 || (run[p].samples > 0 && run[p].p50 < best[p].p50))
+                            best[p] = run[p];
+                    }
+                }
+                storeResult(&best[0]);
+                storeResult(&best[1]);
+
+                if (!complete) {
+                    printf("%-10s %-8s %9zu budget of %.0f s exceeded: larger sizes skipped\n",
+                           workloadNames[w], engineNames[e], ops, options.budget);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (options.json != NULL && !writeJson(&options))
+        return 2;
+
+    if (options.baseline != NULL && compareBaseline(&options) > 0)
+        return 1;
+    return 0;
+}
@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "src/magic.h"
 
 /**
@@ -10,6 +13,22 @@
  * 4) Check correct results for only remove operations
  * 5) Check correct results for sequential add/remove operations
  * 6) Check some error cases (negative pos, or negative length of bytes)
+ * 7) Check that the alternative engines give the same results as the interval tree
+ * 8) Check that batch mapping, also on several threads (started per batch or kept), gives the same results as mapping one position at a time, past INT_MAX too
+ * 9) Check 64-bit positions past 4 GiB, on instances widened after 32-bit operations
+ * 10) Check that range mapping gives the runs of mapping every byte of the range
+ * 11) Check that snapshots and older versions map as the instance did at that version, or are refused
+ * 12) Check that readers of the published version see whole versions while the writer goes on
+ * 13) Check that a saved mapping opened from its file maps as the instance did, and truncated files are rejected
+ * 14) Check that a journaled instance is recovered from its checkpoint and journal, past torn records
+ * 15) Check the statistics of an instance (counters only when compiled with MAGIC_STATS)
+ * 16) Check that composed and inverted mappings map as the stages they are built from
+ * 17) Check that merged operations map as the operations they replace
+ * 18) Check that cursors map a scan of the stream as MAGICmap does
+ * 19) Check that a batch of operations maps as the same operations applied one by one
+ * 20) Check that rolling back to a savepoint maps as the instance did at the savepoint
+ * 21) Check that instances of a registry map as before once compacted or spilled, and shrink
+ * 22) Check that adaptive instances migrate with the workload and map as a fixed engine
 */
 
 /* Test result tracking */
@@ -203,6 +222,1322 @@ void runErrorHandlingTests() {
     MAGICdestroy(m);
 }
 
+/* Engine tests: replay random operations and compare against the interval tree engine */
+void replayRandomOperations(MAGIC m, MAGIC reference, int nbOperations, int range) {
+    for (int i = 0; i < nbOperations; i++) {
+        int pos = rand() % range;
+        int len = (rand() % 10) + 1;
+        if (rand() % 2 == 0) {
+            MAGICadd(reference, pos, len);
+            MAGICadd(m, pos, len);
+        } else {
+            MAGICremove(reference, pos, len);
+            MAGICremove(m, pos, len);
+        }
+    }
+}
+
+int compareWithReference(MAGIC m, MAGIC reference, int range) {
+    int mismatches = 0;
+    for (int pos = 0; pos < range; pos++) {
+        if (MAGICmap(m, STREAM_IN_OUT, pos) != MAGICmap(reference, STREAM_IN_OUT, pos))
+            mismatches++;
+        if (MAGICmap(m, STREAM_OUT_IN, pos) != MAGICmap(reference, STREAM_OUT_IN, pos))
+            mismatches++;
+    }
+    return mismatches;
+}
+
+void runEngineTests() {
+    printSectionHeader("ENGINE TESTS");
+
+    // Figure 1 on the compact engine
+    MAGIC m = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    MAGICremove(m, 3, 2);
+    MAGICremove(m, 4, 3);
+    MAGICadd(m, 4, 2);
+    MAGICadd(m, 9, 3);
+    printTestResult("Compact IN_OUT position 5", MAGICmap(m, STREAM_IN_OUT, 5), 3);
+    printTestResult("Compact IN_OUT position 8", MAGICmap(m, STREAM_IN_OUT, 8), -1);
+    printTestResult("Compact OUT_IN position 8", MAGICmap(m, STREAM_OUT_IN, 8), 11);
+    printTestResult("Compact OUT_IN position 9", MAGICmap(m, STREAM_OUT_IN, 9), -1);
+
+    // Operations added after a first query must be folded on the next one
+    MAGICremove(m, 0, 1);
+    printTestResult("Compact after new remove", MAGICmap(m, STREAM_IN_OUT, 5), 2);
+    MAGICdestroy(m);
+
+    // Random operations, every position compared with the interval tree
+    srand(42);
+    MAGIC reference = MAGICinit();
+    MAGIC compact = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    replayRandomOperations(compact, reference, 2000, 1000);
+    printTestResult("Compact random mismatches", compareWithReference(compact, reference, 2000), 0);
+    MAGICdestroy(compact);
+    MAGICdestroy(reference);
+
+    // Flat log: skipped, shifted and scanned blocks
+    reference = MAGICinit();
+    MAGIC flat = MAGICinitEngine(MAGIC_ENGINE_FLAT);
+    replayRandomOperations(flat, reference, 3000, 1000);
+    printTestResult("Flat random mismatches", compareWithReference(flat, reference, 2000), 0);
+    MAGICdestroy(flat);
+    MAGICdestroy(reference);
+
+    // Rope: pieces split by every operation, removals spanning several pieces
+    reference = MAGICinit();
+    MAGIC rope = MAGICinitEngine(MAGIC_ENGINE_ROPE);
+    replayRandomOperations(rope, reference, 3000, 1000);
+    printTestResult("Rope random mismatches", compareWithReference(rope, reference, 2000), 0);
+    MAGICdestroy(rope);
+    MAGICdestroy(reference);
+
+    // Succinct: bitvectors over the whole edited stream, then cut short by a bound
+    reference = MAGICinit();
+    MAGIC succinct = MAGICinitEngine(MAGIC_ENGINE_SUCCINCT);
+    MAGIC bounded = MAGICinitBounded(300);
+    for (int i = 0; i < 3000; i++) {
+        int pos = rand() % 1000, len = (rand() % 10) + 1;
+        if (i % 2 == 0) {
+            MAGICadd(reference, pos, len);
+            MAGICadd(succinct, pos, len);
+            MAGICadd(bounded, pos, len);
+        } else {
+            MAGICremove(reference, pos, len);
+            MAGICremove(succinct, pos, len);
+            MAGICremove(bounded, pos, len);
+        }
+        // Queries between operations rebuild the index
+        if (i % 500 == 0)
+            MAGICmap(succinct, STREAM_IN_OUT, pos);
+    }
+    printTestResult("Succinct random mismatches", compareWithReference(succinct, reference, 20000), 0);
+    printTestResult("Succinct bounded random mismatches", compareWithReference(bounded, reference, 20000), 0);
+    MAGICdestroy(bounded);
+    MAGICdestroy(succinct);
+    MAGICdestroy(reference);
+
+    // Sparse bitvectors: a large hole between two edits, select across it
+    reference = MAGICinit();
+    succinct = MAGICinitEngine(MAGIC_ENGINE_SUCCINCT);
+    MAGICadd(reference, 5, 3);
+    MAGICadd(succinct, 5, 3);
+    MAGICremove(reference, 10, 2000000);
+    MAGICremove(succinct, 10, 2000000);
+    MAGICadd(reference, 20, 1000000);
+    MAGICadd(succinct, 20, 1000000);
+    int sparseMismatches = 0;
+    for (int pos = 0; pos < 4000000; pos += 997) {
+        sparseMismatches += (MAGICmap(succinct, STREAM_IN_OUT, pos) != MAGICmap(reference, STREAM_IN_OUT, pos));
+        sparseMismatches += (MAGICmap(succinct, STREAM_OUT_IN, pos) != MAGICmap(reference, STREAM_OUT_IN, pos));
+    }
+    printTestResult("Succinct sparse mismatches", sparseMismatches, 0);
+    MAGICdestroy(succinct);
+    MAGICdestroy(reference);
+
+    // Surviving bytes spread out: a byte every 1000 (sparse blocks), runs of 512 bytes
+    // every 150000 (sparse subblocks of dense blocks), against the compact table
+    reference = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    succinct = MAGICinitEngine(MAGIC_ENGINE_SUCCINCT);
+    for (int i = 0; i < 3 * 4096; i++) {
+        MAGICremove(reference, i + 1, 999);
+        MAGICremove(succinct, i + 1, 999);
+    }
+    for (int i = 0; i < 40; i++) {
+        MAGICremove(reference, 3 * 4096 + (i + 1) * 512, 150000);
+        MAGICremove(succinct, 3 * 4096 + (i + 1) * 512, 150000);
+    }
+    sparseMismatches = 0;
+    for (int pos = 0; pos < 20000000; pos += 331) {
+        sparseMismatches += (MAGICmap(succinct, STREAM_IN_OUT, pos) != MAGICmap(reference, STREAM_IN_OUT, pos));
+        sparseMismatches += (MAGICmap(succinct, STREAM_OUT_IN, pos) != MAGICmap(reference, STREAM_OUT_IN, pos));
+    }
+    printTestResult("Succinct sparse select blocks mismatches", sparseMismatches, 0);
+    MAGICdestroy(succinct);
+    MAGICdestroy(reference);
+
+    // Dense bitvectors: many select samples
+    reference = MAGICinit();
+    succinct = MAGICinitEngine(MAGIC_ENGINE_SUCCINCT);
+    replayRandomOperations(succinct, reference, 300, 100000);
+    printTestResult("Succinct dense mismatches", compareWithReference(succinct, reference, 200000), 0);
+    MAGICdestroy(succinct);
+    MAGICdestroy(reference);
+
+    // Interval tree with nodes in caller-supplied memory, then in huge page chunks
+    static char nodeMemory[64 * 1024];
+    MAGICmemory memory = {nodeMemory, sizeof(nodeMemory), 1};
+    reference = MAGICinit();
+    MAGIC arena = MAGICinitWithMemory(MAGIC_ENGINE_RBTREE, &memory);
+    replayRandomOperations(arena, reference, 5000, 1000);
+    printTestResult("Caller memory random mismatches", compareWithReference(arena, reference, 2000), 0);
+    MAGICdestroy(arena);
+    MAGICdestroy(reference);
+
+    // Hybrid engine, compacting in place and in background, queried between batches
+    for (int background = 0; background <= 1; background++) {
+        MAGICcompaction policy = {64, 0, background};
+        reference = MAGICinit();
+        MAGIC hybrid = MAGICinitEngine(MAGIC_ENGINE_HYBRID);
+        MAGICsetCompaction(hybrid, &policy);
+        int mismatches = 0;
+        for (int batch = 0; batch < 10; batch++) {
+            replayRandomOperations(hybrid, reference, 200, 1000);
+            mismatches += compareWithReference(hybrid, reference, 2000);
+        }
+        printTestResult(background ? "Hybrid (background) random mismatches" : "Hybrid random mismatches",
+                        mismatches, 0);
+        MAGICdestroy(hybrid);
+        MAGICdestroy(reference);
+    }
+
+    // Back to compacting in place while a background compaction of a large table runs
+    MAGICcompaction foreground = {64, 0, 0}, background = {64, 0, 1};
+    reference = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    MAGIC hybrid = MAGICinitEngine(MAGIC_ENGINE_HYBRID);
+    MAGICsetCompaction(hybrid, &foreground);
+    replayRandomOperations(hybrid, reference, 100000, 1000000);
+    int mismatches = 0;
+    for (int round = 0; round < 5; round++) {
+        MAGICsetCompaction(hybrid, &background);
+        replayRandomOperations(hybrid, reference, 64, 1000000);
+        MAGICsetCompaction(hybrid, &foreground);
+        replayRandomOperations(hybrid, reference, 200, 1000000);
+        mismatches += compareWithReference(hybrid, reference, 2000);
+    }
+    printTestResult("Hybrid background to foreground mismatches", mismatches, 0);
+    printTestResult("Hybrid background to foreground version", (int)MAGICversion(hybrid), (int)MAGICversion(reference));
+    MAGICdestroy(hybrid);
+    MAGICdestroy(reference);
+}
+
+/* Batch mapping tests */
+void runBatchTests() {
+    printSectionHeader("BATCH MAPPING TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    int n = 5000;
+    int *in = malloc(n * sizeof(int));
+    int *out = malloc(n * sizeof(int));
+
+    // Parallel batches: long enough for several chunks per thread
+    int nbParallel = 200000;
+    int *parallelIn = malloc(nbParallel * sizeof(int));
+    int *parallelOut = malloc(nbParallel * sizeof(int));
+    int *sequentialOut = malloc(nbParallel * sizeof(int));
+    MAGICWorkers workers = MAGICworkersCreate(4);
+
+    srand(7);
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 1000, 2000);
+
+        for (int sorted = 0; sorted <= 1; sorted++) {
+            for (int i = 0; i < n; i++)
+                in[i] = sorted ? i : rand() % n;
+
+            int mismatches = 0;
+            for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+                MAGICmapBatch(m, d, in, out, n);
+                for (int i = 0; i < n; i++) {
+                    if (out[i] != MAGICmap(reference, d, in[i]))
+                        mismatches++;
+                }
+            }
+
+            char testName[64];
+            snprintf(testName, sizeof(testName), "%s batch (%s queries) mismatches",
+                     names[e], sorted ? "sorted" : "random");
+            printTestResult(testName, mismatches, 0);
+        }
+
+        // Clustered queries, sorted in places, against the single-threaded batch
+        for (int i = 0; i < nbParallel; i++) {
+            if ((i / 20000) % 4 == 3) {
+                parallelIn[i] = i % 3000;
+            } else {
+                parallelIn[i] = ((i / 20000) % 3) * 700 + rand() % 300 - 5;
+            }
+        }
+
+        int mismatches = 0;
+        for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+            MAGICmapBatch(m, d, parallelIn, sequentialOut, nbParallel);
+            MAGICmapBatchParallel(m, d, parallelIn, parallelOut, nbParallel, 4);
+            for (int i = 0; i < nbParallel; i++) {
+                if (parallelOut[i] != sequentialOut[i])
+                    mismatches++;
+            }
+        }
+
+        char testName[64];
+        snprintf(testName, sizeof(testName), "%s parallel batch mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        // Threads kept between batches: every engine and direction on the same workers
+        mismatches = 0;
+        for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+            MAGICmapBatch(m, d, parallelIn, sequentialOut, nbParallel);
+            MAGICmapBatchWorkers(m, workers, d, parallelIn, parallelOut, nbParallel);
+            for (int i = 0; i < nbParallel; i++) {
+                if (parallelOut[i] != sequentialOut[i])
+                    mismatches++;
+            }
+        }
+        snprintf(testName, sizeof(testName), "%s workers batch mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // Sparse batch on a long rope: descents interleaved
+    MAGIC m = MAGICinitEngine(MAGIC_ENGINE_ROPE);
+    MAGIC reference = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    replayRandomOperations(m, reference, 40000, 100000);
+    for (int sorted = 0; sorted <= 1; sorted++) {
+        for (int i = 0; i < 1000; i++)
+            in[i] = sorted ? i * 100 - 50 : rand() % 110000;
+
+        int mismatches = 0;
+        for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+            MAGICmapBatch(m, d, in, out, 1000);
+            for (int i = 0; i < 1000; i++) {
+                if (out[i] != MAGICmap(reference, d, in[i]))
+                    mismatches++;
+            }
+        }
+
+        char testName[64];
+        snprintf(testName, sizeof(testName), "Rope sparse batch (%s queries) mismatches", sorted ? "sorted" : "random");
+        printTestResult(testName, mismatches, 0);
+    }
+    MAGICdestroy(reference);
+    MAGICdestroy(m);
+
+    // Batch results past INT_MAX: same -1 as MAGICmap, on every engine
+    for (int large = 0; large <= 1; large++) {
+        int mismatches = 0;
+        for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+            m = MAGICinitEngine(engines[e]);
+            for (int i = 0; i < 1000; i++)
+                MAGICadd(m, rand() % 2000, 1 + rand() % 3);
+            if (large)
+                MAGICadd64(m, 10, 3000000000LL);
+            else
+                MAGICadd(m, 0, 200000000);
+            for (int i = 0; i < 64; i++)
+                in[i] = large ? i * 50 : 1947483647 + i * 3000000;
+
+            for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+                MAGICmapBatch(m, d, in, out, 64);
+                for (int i = 0; i < 64; i++) {
+                    if (out[i] != MAGICmap(m, d, in[i]))
+                        mismatches++;
+                }
+            }
+            MAGICdestroy(m);
+        }
+
+        char testName[64];
+        snprintf(testName, sizeof(testName), "Batch past INT_MAX (%s) mismatches",
+                 large ? "3e9 long operation" : "positions near 2e9");
+        printTestResult(testName, mismatches, 0);
+    }
+
+    // Table past INT_MAX brought back by later operations (not wide: below UINT_MAX)
+    int mismatches = 0;
+    for (int e = 0; e < nbEngines; e++) {
+        m = MAGICinitEngine(engines[e]);
+        // Hybrid: the large addition ends the folded table, the removal is pending
+        for (int i = 0; i < 2047; i++)
+            MAGICadd(m, rand() % 2000, 1 + rand() % 3);
+        MAGICadd64(m, 0, 2500000000LL);
+        MAGICremove64(m, 0, 1000000000LL);
+        for (int i = 0; i < 64; i++)
+            in[i] = i * 10000000;
+
+        for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+            MAGICmapBatch(m, d, in, out, 64);
+            for (int i = 0; i < 64; i++) {
+                int64_t expected = MAGICmap64(m, d, in[i]);
+                if (out[i] != ((expected > INT_MAX) ? -1 : expected))
+                    mismatches++;
+            }
+        }
+        MAGICdestroy(m);
+    }
+    printTestResult("Batch across INT_MAX mismatches", mismatches, 0);
+
+    // Rope descents past INT_MAX, one position at a time (few pieces: not interleaved)
+    m = MAGICinitEngine(MAGIC_ENGINE_ROPE);
+    MAGICadd64(m, 0, 2500000000LL);
+    for (int i = 0; i < 2000; i++)
+        MAGICremove(m, 0, 1);
+    for (int i = 0; i < 64; i++)
+        in[i] = i * 1000000;
+    MAGICmapBatch(m, STREAM_IN_OUT, in, out, 64);
+    mismatches = 0;
+    for (int i = 0; i < 64; i++) {
+        if (out[i] != -1)
+            mismatches++;
+    }
+    printTestResult("Rope batch past INT_MAX mismatches", mismatches, 0);
+    MAGICdestroy(m);
+
+    free(in);
+    free(out);
+    free(parallelIn);
+    free(parallelOut);
+    free(sequentialOut);
+    MAGICworkersDestroy(workers);
+}
+
+/* 64-bit position tests */
+void run64BitTests() {
+    printSectionHeader("64-BIT POSITION TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    int64_t gib = (int64_t)1 << 30;
+
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        char testName[64];
+
+        // A 32-bit operation first, then one past 4 GiB widens the instance
+        MAGICadd(m, 10, 5);
+        MAGICremove64(m, 5 * gib, 100);
+
+        snprintf(testName, sizeof(testName), "%s IN_OUT before 4 GiB", names[e]);
+        printTestResult(testName, MAGICmap(m, STREAM_IN_OUT, 12), 17);
+        snprintf(testName, sizeof(testName), "%s IN_OUT removed past 4 GiB", names[e]);
+        printTestResult(testName, (int)MAGICmap64(m, STREAM_IN_OUT, 5 * gib + 45), -1);
+        snprintf(testName, sizeof(testName), "%s IN_OUT shifted past 4 GiB", names[e]);
+        printTestResult(testName, (int)(MAGICmap64(m, STREAM_IN_OUT, 5 * gib + 200) - 5 * gib), 105);
+        snprintf(testName, sizeof(testName), "%s OUT_IN shifted past 4 GiB", names[e]);
+        printTestResult(testName, (int)(MAGICmap64(m, STREAM_OUT_IN, 5 * gib + 105) - 5 * gib), 200);
+        snprintf(testName, sizeof(testName), "%s int map past INT_MAX", names[e]);
+        printTestResult(testName, MAGICmap(m, STREAM_IN_OUT, INT_MAX - 2), -1);
+
+        MAGICdestroy(m);
+    }
+}
+
+/* Range mapping tests */
+void runRangeTests() {
+    printSectionHeader("RANGE MAPPING TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    MAGICrun runs[256];
+    char testName[64];
+
+    srand(11);
+    for (int e = 0; e < nbEngines; e++) {
+        // Figure 1: input [0, 12) keeps [0, 3), 5 and [9, 12)
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGICremove(m, 3, 2);
+        MAGICremove(m, 4, 3);
+        MAGICadd(m, 4, 2);
+        MAGICadd(m, 9, 3);
+
+        size_t n = MAGICmapRange(m, STREAM_IN_OUT, 0, 12, runs, 256);
+        snprintf(testName, sizeof(testName), "%s Figure 1 IN_OUT runs", names[e]);
+        printTestResult(testName, (int)n, 3);
+        snprintf(testName, sizeof(testName), "%s Figure 1 last run", names[e]);
+        printTestResult(testName, (n == 3) ? (int)(runs[2].mapped * 10 + runs[2].length) : -1, 63);
+        MAGICdestroy(m);
+
+        // Random ranges against mapping every byte of the range
+        m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 500, 1000);
+
+        int mismatches = 0;
+        for (int q = 0; q < 200; q++) {
+            enum MAGICDirection d = q % 2;
+            int pos = rand() % 1200;
+            int length = (rand() % 100) + 1;
+            n = MAGICmapRange(m, d, pos, length, runs, 256);
+
+            size_t k = 0;
+            for (int x = pos; x < pos + length; x++) {
+                int expected = MAGICmap(reference, d, x);
+                while (k < n && x >= runs[k].pos + runs[k].length)
+                    k++;
+                int inRun = (k < n && x >= runs[k].pos);
+                if (expected < 0 ? inRun : (!inRun || runs[k].mapped + (x - runs[k].pos) != expected))
+                    mismatches++;
+            }
+        }
+        snprintf(testName, sizeof(testName), "%s random range mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+}
+
+/* Version tests: snapshots and older versions against an instance stopped at that version */
+void runVersionTests() {
+    printSectionHeader("VERSION TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    char testName[64];
+
+    srand(13);
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 500, 1000);
+
+        MAGICSnapshot snapshot = MAGICsnapshot(m);
+        size_t version = MAGICversion(m);
+
+        // Later operations must not change the snapshot
+        MAGIC later = MAGICinit();
+        replayRandomOperations(m, later, 500, 1000);
+        MAGICdestroy(later);
+
+        snprintf(testName, sizeof(testName), "%s snapshot version", names[e]);
+        printTestResult(testName, (int)MAGICsnapshotVersion(snapshot), 500);
+
+        int mismatches = 0;
+        for (int pos = 0; pos < 2000; pos++) {
+            for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+                if (MAGICsnapshotMap(snapshot, d, pos) != MAGICmap(reference, d, pos))
+                    mismatches++;
+            }
+        }
+        snprintf(testName, sizeof(testName), "%s snapshot mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        // The compact engine still has the version of its last fold, the rope none
+        int available = (engines[e] != MAGIC_ENGINE_ROPE);
+        snprintf(testName, sizeof(testName), "%s version available", names[e]);
+        printTestResult(testName, MAGICversionAvailable(m, version), available);
+
+        // A version the engine no longer has is refused, not mapped as removed bytes
+        mismatches = 0;
+        for (int pos = 0; pos < 2000; pos++) {
+            for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+                int64_t expected = available ? MAGICmap(reference, d, pos) : MAGIC_VERSION_UNAVAILABLE;
+                if (MAGICmapAt(m, version, d, pos) != expected)
+                    mismatches++;
+            }
+        }
+        snprintf(testName, sizeof(testName), "%s map at version mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        if (engines[e] == MAGIC_ENGINE_COMPACT) {
+            MAGICmap(m, STREAM_IN_OUT, 0);
+            printTestResult("Compact version unavailable once folded",
+                            (int)MAGICmapAt(m, version, STREAM_IN_OUT, 0), MAGIC_VERSION_UNAVAILABLE);
+        }
+
+        MAGICsnapshotRelease(snapshot);
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+}
+
+/* Reader of the concurrent tests: every published version prepends ADDS_PER_PUBLICATION bytes */
+#define ADDS_PER_PUBLICATION 10
+#define CONCURRENT_ADDS 20000
+
+typedef struct {
+    MAGIC m;
+    int errors;
+} Reader;
+
+static void *readPublished(void *arg) {
+    Reader *reader = arg;
+    int64_t shift = 0;
+
+    while (shift < CONCURRENT_ADDS) {
+        for (int64_t pos = 0; pos < 100; pos++) {
+            // A whole version shifts every input byte by the same multiple of the batch
+            int64_t current = MAGICmapPublished(reader->m, STREAM_IN_OUT, pos) - pos;
+            if (current < shift || current % ADDS_PER_PUBLICATION != 0) {
+                reader->errors++;
+                return NULL;
+            }
+            shift = current;
+        }
+    }
+    return NULL;
+}
+
+/* Concurrent tests: published versions against the instance, then under concurrent readers */
+void runConcurrentTests() {
+    printSectionHeader("CONCURRENT TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    char testName[64];
+
+    srand(17);
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        MAGICsetConcurrent(m, 0);
+
+        int mismatches = 0;
+        for (int round = 0; round < 3; round++) {
+            replayRandomOperations(m, reference, 300, 1000);
+            MAGICpublish(m);
+            for (int pos = 0; pos < 2000; pos++) {
+                for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+                    if (MAGICmapPublished(m, d, pos) != MAGICmap(reference, d, pos))
+                        mismatches++;
+                }
+            }
+        }
+        snprintf(testName, sizeof(testName), "%s published mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGICsetConcurrent(m, ADDS_PER_PUBLICATION);
+
+        Reader readers[4];
+        pthread_t threads[4];
+        for (int r = 0; r < 4; r++) {
+            readers[r].m = m;
+            readers[r].errors = 0;
+            pthread_create(&threads[r], NULL, readPublished, &readers[r]);
+        }
+
+        for (int i = 0; i < CONCURRENT_ADDS; i++)
+            MAGICadd(m, 0, 1);
+
+        int errors = 0;
+        for (int r = 0; r < 4; r++) {
+            pthread_join(threads[r], NULL);
+            errors += readers[r].errors;
+        }
+        snprintf(testName, sizeof(testName), "%s concurrent reader errors", names[e]);
+        printTestResult(testName, errors, 0);
+
+        MAGICdestroy(m);
+    }
+}
+
+/* Persistence tests: mappings saved then opened mapped from the file */
+int compareAtVersion(MAGIC m, MAGIC reference, size_t version) {
+    int64_t positions[] = {0, 1, 2, 1000, 1999, 2500, 4999999999LL, 5000000005LL, 5000002000LL};
+    int mismatches = 0;
+
+    for (int d = STREAM_IN_OUT; d <= STREAM_OUT_IN; d++) {
+        for (int64_t pos = 0; pos < 3000; pos++) {
+            if (MAGICmap64(m, d, pos) != MAGICmapAt(reference, version, d, pos))
+                mismatches++;
+        }
+        for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+            if (MAGICmap64(m, d, positions[i]) != MAGICmapAt(reference, version, d, positions[i]))
+                mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void runPersistenceTests() {
+    printSectionHeader("PERSISTENCE TESTS");
+
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    int nbEngines = sizeof(engines) / sizeof(engines[0]);
+    const char *path = "correctnessTest.img";
+    char testName[64];
+
+    srand(19);
+    for (int e = 0; e < nbEngines; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 1000, 2000);
+        MAGICadd64(m, 5000000000LL, 10);
+        MAGICadd64(reference, 5000000000LL, 10);
+        size_t version = MAGICversion(m);
+
+        MAGICsave(m, path);
+        MAGIC mapped = MAGICopenMapped(path);
+        snprintf(testName, sizeof(testName), "%s open mapped version", names[e]);
+        printTestResult(testName, (mapped == NULL) ? -1 : (int)MAGICversion(mapped), (int)version);
+
+        // Replacing the file leaves the open instance on its version
+        replayRandomOperations(m, reference, 100, 2000);
+        MAGICsave(m, path);
+        snprintf(testName, sizeof(testName), "%s mapped mismatches", names[e]);
+        printTestResult(testName, compareAtVersion(mapped, reference, version), 0);
+
+        // Operations on a mapped instance go to a private copy
+        MAGIC reopened = MAGICopenMapped(path);
+        replayRandomOperations(reopened, reference, 200, 2000);
+        snprintf(testName, sizeof(testName), "%s mapped then modified mismatches", names[e]);
+        printTestResult(testName, compareAtVersion(reopened, reference, MAGICversion(reference)), 0);
+
+        MAGICdestroy(reopened);
+        MAGICdestroy(mapped);
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // Anything but an image is rejected, a truncated image too
+    printTestResult("Open non-image file", MAGICopenMapped("correctnessTest.c") == NULL, 1);
+    MAGIC small = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    MAGICadd(small, 0, 10);
+    MAGICremove(small, 20, 5);
+    MAGICsave(small, path);
+    MAGICdestroy(small);
+    char image[4096];
+    FILE *file = fopen(path, "rb");
+    size_t bytes = (file == NULL) ? 0 : fread(image, 1, sizeof(image), file);
+    if (file != NULL)
+        fclose(file);
+    file = fopen(path, "wb");
+    if (file != NULL && bytes > 8) {
+        fwrite(image, 1, bytes - 8, file);
+        fclose(file);
+    }
+    printTestResult("Open truncated image", MAGICopenMapped(path) == NULL, 1);
+    remove(path);
+    printTestResult("Open removed file", MAGICopenMapped(path) == NULL, 1);
+}
+
+/* Journal tests: instances recovered while the journaled one is left open, as after a crash */
+void runJournalTests() {
+    printSectionHeader("JOURNAL TESTS");
+
+    const char *path = "correctnessTest.jnl";
+    char testName[64];
+    size_t checkpoints[] = {0, 100};
+
+    srand(23);
+    for (int c = 0; c < 2; c++) {
+        MAGICjournal config = {64, checkpoints[c]};
+        MAGIC m = MAGICinit();
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 50, 2000);
+
+        snprintf(testName, sizeof(testName), "Journal open (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, MAGICjournalOpen(m, path, &config), 1);
+        replayRandomOperations(m, reference, 550, 2000);
+        MAGICjournalSync(m);
+
+        MAGIC recovered = MAGICrecover(path, &config);
+        snprintf(testName, sizeof(testName), "Recovered version (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, (recovered == NULL) ? -1 : (int)MAGICversion(recovered), 600);
+        snprintf(testName, sizeof(testName), "Recovered mismatches (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, compareAtVersion(recovered, reference, 600), 0);
+
+        // The recovered instance journals in turn; a torn record ends its journal
+        replayRandomOperations(recovered, reference, 100, 2000);
+        MAGICjournalSync(recovered);
+        FILE *journal = fopen(path, "ab");
+        fwrite("torn", 1, 4, journal);
+        fclose(journal);
+
+        MAGIC again = MAGICrecover(path, NULL);
+        snprintf(testName, sizeof(testName), "Recovered twice mismatches (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, compareAtVersion(again, reference, 700), 0);
+
+        // A torn record whose bytes look like a valid operation fails its checksum
+        replayRandomOperations(again, reference, 50, 2000);
+        MAGICjournalSync(again);
+        unsigned char garbage[32];
+        for (size_t i = 0; i < sizeof(garbage); i++)
+            garbage[i] = 0x01;
+        journal = fopen(path, "ab");
+        fwrite(garbage, 1, sizeof(garbage), journal);
+        fclose(journal);
+
+        MAGIC third = MAGICrecover(path, NULL);
+        snprintf(testName, sizeof(testName), "Torn record ignored (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, (third == NULL) ? -1 : (int)MAGICversion(third), 750);
+        snprintf(testName, sizeof(testName), "Recovered past torn record mismatches (checkpoint every %zu)", checkpoints[c]);
+        printTestResult(testName, compareAtVersion(third, reference, 750), 0);
+
+        MAGICdestroy(third);
+        MAGICdestroy(again);
+        MAGICdestroy(recovered);
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // A failed checkpoint leaves the journal behind the instance, until a sync
+    // checkpoints it again (a directory in the way of the checkpoint file)
+    MAGIC m = MAGICinit();
+    MAGIC reference = MAGICinit();
+    replayRandomOperations(m, reference, 50, 2000);
+    MAGICjournalOpen(m, path, NULL);
+    replayRandomOperations(m, reference, 100, 2000);
+    mkdir("correctnessTest.jnl.ckpt.tmp", 0700);
+    printTestResult("Failed checkpoint", MAGICcheckpoint(m), 0);
+    replayRandomOperations(m, reference, 100, 2000);
+    printTestResult("Sync behind a failed checkpoint", MAGICjournalSync(m), 0);
+    remove("correctnessTest.jnl.ckpt.tmp");
+    printTestResult("Sync after a failed checkpoint", MAGICjournalSync(m), 1);
+    replayRandomOperations(m, reference, 50, 2000);
+    MAGICjournalSync(m);
+
+    MAGIC recovered = MAGICrecover(path, NULL);
+    printTestResult("Recovered after a failed checkpoint", (recovered == NULL) ? -1 : (int)MAGICversion(recovered), 300);
+    printTestResult("Recovered after a failed checkpoint mismatches", compareAtVersion(recovered, reference, 300), 0);
+    MAGICdestroy(recovered);
+    MAGICdestroy(reference);
+    MAGICdestroy(m);
+
+    remove(path);
+    remove("correctnessTest.jnl.ckpt");
+    printTestResult("Recover without checkpoint", MAGICrecover(path, NULL) == NULL, 1);
+}
+
+/* Statistics tests: the counters are checked against each other, as their values depend on the tree */
+void runStatsTests() {
+    printSectionHeader("STATISTICS TESTS");
+
+    MAGIC m = MAGICinit();
+    MAGICstatistics stats, before;
+    MAGICstats(m, &before);
+
+    srand(29);
+    for (int i = 0; i < 1000; i++) {
+        if (rand() % 3 == 0)
+            MAGICremove(m, rand() % 5000, 1 + rand() % 20);
+        else
+            MAGICadd(m, rand() % 5000, 1 + rand() % 20);
+    }
+    for (int pos = 0; pos < 500; pos++)
+        MAGICmap(m, pos % 2 ? STREAM_IN_OUT : STREAM_OUT_IN, pos * 10);
+    MAGICstats(m, &stats);
+
+    // A red-black tree of 1000 nodes is 10 to 20 levels high
+    printTestResult("Tree height balanced", stats.height >= 10 && stats.height <= 20, 1);
+    printTestResult("Bytes grow with the operations", stats.bytesAllocated > before.bytesAllocated, 1);
+
+    if (stats.enabled) {
+        uint64_t mapCalls = 0, updateCalls = 0;
+        for (int b = 0; b < MAGIC_STATS_BUCKETS; b++) {
+            mapCalls += stats.mapLatency[b];
+            updateCalls += stats.updateLatency[b];
+        }
+        printTestResult("Maps counted", (int)stats.maps, 500);
+        printTestResult("Map latencies counted", (int)mapCalls, 500);
+        printTestResult("Updates timed", (int)updateCalls, 1000);
+        printTestResult("Inserts counted", (int)stats.inserts, 1000);
+        printTestResult("At most 2 rotations per insert", stats.rotations <= 2 * stats.inserts, 1);
+        printTestResult("Nodes visited", stats.nodesVisited >= stats.maps, 1);
+        printTestResult("Subtrees pruned", stats.prunedLeft + stats.prunedRight > 0, 1);
+        printTestResult("Early exits at most one per map", stats.earlyExits <= stats.maps, 1);
+
+        MAGICstatsReset(m);
+        MAGICstats(m, &stats);
+        printTestResult("Counters reset", (int)(stats.maps + stats.nodesVisited + stats.inserts), 0);
+    } else {
+        printTestResult("Counters off by default", (int)(stats.maps + stats.nodesVisited + stats.inserts), 0);
+    }
+    MAGICdestroy(m);
+
+    // Engines without a tree report no height
+    MAGIC compact = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    MAGICadd(compact, 0, 10);
+    MAGICmap(compact, STREAM_IN_OUT, 5);
+    MAGICstats(compact, &stats);
+    printTestResult("Compact engine height", (int)stats.height, 0);
+    printTestResult("Compact engine bytes", stats.bytesAllocated > 0, 1);
+    MAGICdestroy(compact);
+}
+
+/* Composition tests: a fused mapping against mapping through each stage in sequence */
+void runComposeTests() {
+    printSectionHeader("COMPOSITION TESTS");
+
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    char testName[64];
+
+    srand(31);
+    for (int e = 0; e < 5; e++) {
+        MAGIC a = MAGICinitEngine(engines[e]);
+        MAGIC b = MAGICinitEngine(engines[(e + 1) % 5]);
+        MAGIC unused = MAGICinit();
+        replayRandomOperations(a, unused, 300, 1000);
+        replayRandomOperations(b, unused, 300, 1000);
+        MAGICdestroy(unused);
+
+        MAGIC ab = MAGICcompose(a, b);
+        MAGIC inverse = MAGICinvert(a);
+        int composeMismatches = 0, invertMismatches = 0;
+        for (int pos = 0; pos < 2000; pos++) {
+            int mid = MAGICmap(a, STREAM_IN_OUT, pos);
+            int expected = (mid < 0) ? -1 : MAGICmap(b, STREAM_IN_OUT, mid);
+            composeMismatches += (MAGICmap(ab, STREAM_IN_OUT, pos) != expected);
+
+            mid = MAGICmap(b, STREAM_OUT_IN, pos);
+            expected = (mid < 0) ? -1 : MAGICmap(a, STREAM_OUT_IN, mid);
+            composeMismatches += (MAGICmap(ab, STREAM_OUT_IN, pos) != expected);
+
+            invertMismatches += (MAGICmap(inverse, STREAM_IN_OUT, pos) != MAGICmap(a, STREAM_OUT_IN, pos));
+            invertMismatches += (MAGICmap(inverse, STREAM_OUT_IN, pos) != MAGICmap(a, STREAM_IN_OUT, pos));
+        }
+
+        snprintf(testName, sizeof(testName), "%s composed mismatches", names[e]);
+        printTestResult(testName, composeMismatches, 0);
+        snprintf(testName, sizeof(testName), "%s inverted mismatches", names[e]);
+        printTestResult(testName, invertMismatches, 0);
+
+        // A mapping followed by its inverse keeps every surviving byte in place
+        MAGIC roundTrip = MAGICcompose(a, inverse);
+        int roundTripMismatches = 0;
+        for (int pos = 0; pos < 2000; pos++) {
+            int mapped = MAGICmap(roundTrip, STREAM_IN_OUT, pos);
+            roundTripMismatches += (mapped != -1 && mapped != pos);
+            roundTripMismatches += ((mapped == -1) != (MAGICmap(a, STREAM_IN_OUT, pos) == -1));
+        }
+        snprintf(testName, sizeof(testName), "%s round trip mismatches", names[e]);
+        printTestResult(testName, roundTripMismatches, 0);
+
+        MAGICdestroy(roundTrip);
+        MAGICdestroy(inverse);
+        MAGICdestroy(ab);
+        MAGICdestroy(b);
+        MAGICdestroy(a);
+    }
+
+    printTestResult("Compose with NULL", MAGICcompose(NULL, NULL) == NULL, 1);
+    printTestResult("Invert NULL", MAGICinvert(NULL) == NULL, 1);
+}
+
+/* Coalescing tests: editor-like sessions (typing, backspace, jumps) on merging instances */
+void runCoalescingTests() {
+    printSectionHeader("COALESCING TESTS");
+
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    char testName[64];
+
+    srand(37);
+    for (int e = 0; e < 5; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        MAGICsetCoalescing(m, 1);
+
+        int cursor = 100;
+        for (int i = 0; i < 3000; i++) {
+            int r = rand() % 10, len = 1 + rand() % 3;
+            if (r < 5) {
+                MAGICadd(m, cursor, len);
+                MAGICadd(reference, cursor, len);
+                cursor += len;
+            } else if (r < 8 && cursor > len) {
+                cursor -= len;
+                MAGICremove(m, cursor, len);
+                MAGICremove(reference, cursor, len);
+            } else {
+                cursor = 50 + rand() % 1000;
+            }
+        }
+
+        snprintf(testName, sizeof(testName), "%s merged mismatches", names[e]);
+        printTestResult(testName, compareWithReference(m, reference, 3000), 0);
+        if (engines[e] != MAGIC_ENGINE_HYBRID && engines[e] != MAGIC_ENGINE_ROPE) {
+            snprintf(testName, sizeof(testName), "%s keeps fewer operations", names[e]);
+            printTestResult(testName, MAGICversion(m) < MAGICversion(reference) / 2, 1);
+        }
+
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // Typing then erasing a word leaves nothing
+    MAGIC m = MAGICinit();
+    MAGICsetCoalescing(m, 1);
+    for (int i = 0; i < 5; i++)
+        MAGICadd(m, 10 + i, 1);
+    for (int i = 4; i >= 0; i--)
+        MAGICremove(m, 10 + i, 1);
+    printTestResult("Typed and erased word", (int)MAGICversion(m), 0);
+    printTestResult("Typed and erased word maps", MAGICmap(m, STREAM_IN_OUT, 20), 20);
+
+    // A version held by a snapshot is not merged into
+    MAGICadd(m, 10, 5);
+    MAGICSnapshot s = MAGICsnapshot(m);
+    MAGICadd(m, 15, 5);
+    printTestResult("Snapshot version kept", (int)MAGICsnapshotMap(s, STREAM_IN_OUT, 10), 15);
+    printTestResult("Operation after snapshot recorded", (int)MAGICversion(m), 2);
+    MAGICadd(m, 20, 5);
+    printTestResult("Merging resumes after snapshot", (int)MAGICversion(m), 2);
+    MAGICsnapshotRelease(s);
+    MAGICdestroy(m);
+}
+
+/* Cursor tests: front to back scans, jumps and restarts, for every engine */
+void runCursorTests() {
+    printSectionHeader("CURSOR TESTS");
+
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope"};
+    enum MAGICEngine engines[] = {MAGIC_ENGINE_RBTREE, MAGIC_ENGINE_COMPACT, MAGIC_ENGINE_HYBRID,
+                                  MAGIC_ENGINE_FLAT, MAGIC_ENGINE_ROPE};
+    char testName[64];
+
+    srand(41);
+    for (int e = 0; e < 5; e++) {
+        MAGIC m = MAGICinitEngine(engines[e]);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 500, 2000);
+
+        int mismatches = 0;
+        for (int d = 0; d < 2; d++) {
+            enum MAGICDirection direction = d ? STREAM_OUT_IN : STREAM_IN_OUT;
+            MAGICCursor c = MAGICcursor(m, direction);
+
+            // Every position, then growing jumps, then a restart from the front
+            for (int pos = 0; pos < 3000; pos++)
+                mismatches += (MAGICcursorMap(c, pos) != MAGICmap(reference, direction, pos));
+            for (int pos = 3000; pos < 1000000; pos = pos * 3 / 2)
+                mismatches += (MAGICcursorMap(c, pos) != MAGICmap(reference, direction, pos));
+            for (int pos = 0; pos < 3000; pos += 7)
+                mismatches += (MAGICcursorMap(c, pos) != MAGICmap(reference, direction, pos));
+            MAGICcursorRelease(c);
+        }
+        snprintf(testName, sizeof(testName), "%s cursor mismatches", names[e]);
+        printTestResult(testName, mismatches, 0);
+
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // The cursor keeps the version it was created at
+    MAGIC m = MAGICinit();
+    MAGICadd(m, 0, 10);
+    MAGICCursor c = MAGICcursor(m, STREAM_IN_OUT);
+    MAGICremove(m, 0, 20);
+    printTestResult("Cursor version kept", (int)MAGICcursorMap(c, 5), 15);
+    printTestResult("Cursor negative position", (int)MAGICcursorMap(c, -1), -1);
+    MAGICcursorRelease(c);
+    MAGICdestroy(m);
+}
+
+/* Batch application tests: MAGICapplyBatch against the same calls one by one */
+void runBatchApplyTests() {
+    printSectionHeader("BATCH APPLICATION TESTS");
+
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope", "Succinct"};
+    char testName[64];
+
+    MAGICop *ops = malloc(1000 * sizeof(MAGICop));
+    srand(43);
+    for (int i = 0; i < 1000; i++) {
+        ops[i].pos = rand() % 2000;
+        ops[i].length = (rand() % 10) + 1;
+        ops[i].remove = (rand() % 2 == 0);
+    }
+
+    // Batches on an empty instance, then a long and a short batch after operations
+    for (int e = 0; e < 6; e++) {
+        MAGIC m = MAGICinitEngine((enum MAGICEngine)e);
+        MAGIC reference = MAGICinit();
+        MAGICapplyBatch(m, ops, 600);
+        for (int i = 0; i < 1000; i++) {
+            if (ops[i].remove)
+                MAGICremove(reference, (int)ops[i].pos, (int)ops[i].length);
+            else
+                MAGICadd(reference, (int)ops[i].pos, (int)ops[i].length);
+        }
+        MAGICapplyBatch(m, ops + 600, 390);
+        MAGICapplyBatch(m, ops + 990, 10);
+        snprintf(testName, sizeof(testName), "%s batch mismatches", names[e]);
+        printTestResult(testName, compareWithReference(m, reference, 4000), 0);
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // The rebuilt tree is balanced: 1000 nodes on 10 levels
+    MAGIC m = MAGICinit();
+    MAGICapplyBatch(m, ops, 1000);
+    MAGICstatistics stats;
+    MAGICstats(m, &stats);
+    printTestResult("Batch tree height", (int)stats.height, 10);
+    MAGICdestroy(m);
+
+    // Invalid operations are skipped, a wide operation widens the whole batch
+    MAGICop wide[] = {{0, 10, 0}, {-1, 5, 0}, {3, 0, 1}, {5000000000LL, 100, 0}, {2, 4, 1}};
+    m = MAGICinit();
+    MAGIC reference = MAGICinit();
+    MAGICapplyBatch(m, wide, 5);
+    MAGICadd64(reference, 0, 10);
+    MAGICadd64(reference, 5000000000LL, 100);
+    MAGICremove64(reference, 2, 4);
+    printTestResult("Batch invalid operations", compareWithReference(m, reference, 100), 0);
+    printTestResult("Batch wide operation",
+                    MAGICmap64(m, STREAM_IN_OUT, 5000000050LL) == MAGICmap64(reference, STREAM_IN_OUT, 5000000050LL), 1);
+    printTestResult("Batch wide position",
+                    MAGICmap64(m, STREAM_OUT_IN, 5000000200LL) == MAGICmap64(reference, STREAM_OUT_IN, 5000000200LL), 1);
+    MAGICdestroy(reference);
+    MAGICdestroy(m);
+
+    free(ops);
+}
+
+/* Rollback tests: speculative operations discarded, then the instance goes on */
+void runRollbackTests() {
+    printSectionHeader("ROLLBACK TESTS");
+
+    const char *names[] = {"Interval tree", "Compact", "Hybrid", "Flat", "Rope", "Succinct"};
+    char testName[64];
+
+    srand(47);
+    for (int e = 0; e < 6; e++) {
+        MAGIC m = MAGICinitEngine((enum MAGICEngine)e);
+        MAGIC reference = MAGICinit();
+        replayRandomOperations(m, reference, 300, 2000);
+
+        // Speculative operations, mapped in between, then discarded twice
+        size_t savepoint = MAGICsavepoint(m);
+        int rolledBack = 1;
+        for (int round = 0; round < 2; round++) {
+            for (int i = 0; i < 50; i++) {
+                MAGICadd(m, rand() % 2000, (rand() % 10) + 1);
+                MAGICremove(m, rand() % 2000, (rand() % 10) + 1);
+                MAGICmap(m, STREAM_IN_OUT, rand() % 2000);
+            }
+            // The compact engines keep the version of the savepoint
+            if (round == 0 && e != MAGIC_ENGINE_ROPE) {
+                int mismatches = 0;
+                for (int pos = 0; pos < 4000; pos++) {
+                    if (MAGICmapAt(m, savepoint, STREAM_IN_OUT, pos) != MAGICmap(reference, STREAM_IN_OUT, pos))
+                        mismatches++;
+                }
+                snprintf(testName, sizeof(testName), "%s savepoint map at mismatches", names[e]);
+                printTestResult(testName, mismatches, 0);
+            }
+            rolledBack &= MAGICrollback(m, savepoint);
+        }
+
+        if (e == MAGIC_ENGINE_ROPE) {
+            printTestResult("Rope rollback refused", rolledBack, 0);
+        } else {
+            snprintf(testName, sizeof(testName), "%s rollback", names[e]);
+            printTestResult(testName, rolledBack, 1);
+            snprintf(testName, sizeof(testName), "%s version after rollback", names[e]);
+            printTestResult(testName, (int)MAGICversion(m), 300);
+            snprintf(testName, sizeof(testName), "%s rollback mismatches", names[e]);
+            printTestResult(testName, compareWithReference(m, reference, 4000), 0);
+
+            // Operations after the rollback follow the savepoint
+            replayRandomOperations(m, reference, 100, 2000);
+            snprintf(testName, sizeof(testName), "%s mismatches after rollback", names[e]);
+            printTestResult(testName, compareWithReference(m, reference, 4000), 0);
+        }
+        MAGICdestroy(reference);
+        MAGICdestroy(m);
+    }
+
+    // Rollback of pending operations only, merged operations, and a held version
+    MAGIC m = MAGICinit();
+    MAGICsetCoalescing(m, 1);
+    MAGICadd(m, 0, 10);
+    size_t savepoint = MAGICsavepoint(m);
+    MAGICadd(m, 10, 5);
+    printTestResult("Savepoint not merged", (int)MAGICversion(m), 2);
+    printTestResult("Rollback merged instance", MAGICrollback(m, savepoint), 1);
+    printTestResult("Rollback merged mapping", (int)MAGICmap(m, STREAM_OUT_IN, 12), 2);
+    printTestResult("Rollback past the version", MAGICrollback(m, 5), 0);
+
+    MAGICSnapshot s = MAGICsnapshot(m);
+    MAGICadd(m, 0, 3);
+    printTestResult("Rollback before a snapshot", MAGICrollback(m, 0), 0);
+    printTestResult("Rollback to a snapshot", MAGICrollback(m, MAGICsnapshotVersion(s)), 1);
+    printTestResult("Snapshot after rollback", (int)MAGICsnapshotMap(s, STREAM_IN_OUT, 0), 10);
+
+    // Released snapshots no longer hold their version, the live ones still do
+    MAGICSnapshot later = MAGICsnapshot(m);
+    MAGICadd(m, 0, 3);
+    MAGICsnapshotRelease(later);
+    printTestResult("Rollback before a live snapshot", MAGICrollback(m, 0), 0);
+    MAGICsnapshotRelease(s);
+    printTestResult("Rollback after the release", MAGICrollback(m, 0), 1);
+    printTestResult("Mapping after the release rollback", (int)MAGICmap(m, STREAM_IN_OUT, 0), 0);
+    MAGICdestroy(m);
+
+    MAGIC compact = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    MAGICadd(compact, 0, 10);
+    MAGICmap(compact, STREAM_IN_OUT, 0);
+    MAGICremove(compact, 0, 4);
+    printTestResult("Compact rollback without savepoint", MAGICrollback(compact, 0), 0);
+    printTestResult("Compact rollback of pending operations", MAGICrollback(compact, 1), 1);
+    printTestResult("Compact mapping after rollback", (int)MAGICmap(compact, STREAM_IN_OUT, 0), 10);
+    MAGICdestroy(compact);
+}
+
+/* Registry tests: idle instances compacted, then spilled, against unregistered references */
+void runRegistryTests() {
+    printSectionHeader("REGISTRY TESTS");
+
+    MAGICRegistry r = MAGICregistryCreate(".");
+    MAGIC instances[6], references[6];
+    char testName[64];
+
+    srand(53);
+    for (int e = 0; e < 6; e++) {
+        instances[e] = MAGICregistryInit(r, (enum MAGICEngine)e);
+        references[e] = MAGICinit();
+        replayRandomOperations(instances[e], references[e], 1000, 2000);
+    }
+    MAGICadd64(instances[0], 5000000000LL, 10);
+    MAGICadd64(references[0], 5000000000LL, 10);
+
+    // Every instance was used: the first trim only marks them idle
+    printTestResult("Used instances kept", (int)MAGICregistryTrim(r), 0);
+    size_t before = MAGICregistryBytes(r);
+
+    // The four log engines are compacted, the compact ones spilled
+    printTestResult("Idle instances trimmed", (int)MAGICregistryTrim(r), 6);
+    size_t compacted = MAGICregistryBytes(r);
+    printTestResult("Compacted registry smaller", compacted < before, 1);
+    printTestResult("Compacted instances spilled", (int)MAGICregistryTrim(r), 4);
+    printTestResult("Spilled registry smaller", MAGICregistryBytes(r) < compacted, 1);
+
+    int mismatches = 0;
+    for (int e = 0; e < 6; e++)
+        mismatches += compareWithReference(instances[e], references[e], 4000);
+    printTestResult("Trimmed instances mismatches", mismatches, 0);
+    printTestResult("Wide operation after trim",
+                    MAGICmap64(instances[0], STREAM_IN_OUT, 5000000005LL) == MAGICmap64(references[0], STREAM_IN_OUT, 5000000005LL), 1);
+
+    // Spilled instances go on recording
+    for (int e = 0; e < 6; e++) {
+        replayRandomOperations(instances[e], references[e], 200, 2000);
+        snprintf(testName, sizeof(testName), "Engine %d mismatches after spill", e);
+        printTestResult(testName, compareWithReference(instances[e], references[e], 4000), 0);
+        MAGICdestroy(references[e]);
+    }
+
+    // A destroyed instance leaves the registry, the others keep their nodes in the pool
+    MAGICdestroy(instances[2]);
+    MAGIC m = MAGICregistryInit(r, MAGIC_ENGINE_RBTREE);
+    MAGIC reference = MAGICinit();
+    replayRandomOperations(m, reference, 3000, 2000);
+    MAGICadd64(m, 5000000000LL, 10);
+    MAGICadd64(reference, 5000000000LL, 10);
+    printTestResult("Pooled widened instance mismatches", compareWithReference(m, reference, 4000), 0);
+    MAGICdestroy(reference);
+
+    // A snapshot of the log keeps an instance from compacting
+    MAGICSnapshot s = MAGICsnapshot(m);
+    MAGICregistryTrim(r);
+    MAGICregistryTrim(r);
+    MAGICstatistics stats;
+    MAGICstats(m, &stats);
+    printTestResult("Snapshot keeps the tree", stats.height > 0, 1);
+    MAGICsnapshotRelease(s);
+
+    // The registry destroys the instances left
+    MAGICregistryDestroy(r);
+}
+
+void runAdaptiveTests() {
+    printSectionHeader("ADAPTIVE ENGINE TESTS");
+
+    MAGICpolicy policy = {MAGIC_ENGINE_COMPACT, 1, 256};
+    MAGIC m = MAGICinitWithPolicy(&policy);
+    MAGIC reference = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    printTestResult("Adaptive starts on its engine", MAGICengine(m), MAGIC_ENGINE_COMPACT);
+
+    // Each operation followed by a mapping: folding the table every time costs most
+    srand(59);
+    int mismatches = 0;
+    for (int i = 0; i < 4000; i++) {
+        replayRandomOperations(m, reference, 1, 20000);
+        int pos = rand() % 20000;
+        mismatches += (MAGICmap(m, STREAM_IN_OUT, pos) != MAGICmap(reference, STREAM_IN_OUT, pos));
+    }
+    printTestResult("Interleaved workload on the rope", MAGICengine(m), MAGIC_ENGINE_ROPE);
+    printTestResult("Interleaved workload mismatches", mismatches, 0);
+    printTestResult("Migrated version", (int)MAGICversion(m), (int)MAGICversion(reference));
+
+    // Mappings only: back to the binary search
+    mismatches = 0;
+    for (int i = 0; i < 20000; i++) {
+        int pos = rand() % 20000;
+        mismatches += (MAGICmap(m, STREAM_OUT_IN, pos) != MAGICmap(reference, STREAM_OUT_IN, pos));
+    }
+    printTestResult("Query workload on the compact engine", MAGICengine(m), MAGIC_ENGINE_COMPACT);
+    printTestResult("Query workload mismatches", mismatches, 0);
+    printTestResult("Adaptive mismatches", compareWithReference(m, reference, 20000), 0);
+    MAGICdestroy(m);
+    MAGICdestroy(reference);
+
+    // A log engine leaves its history when it migrates, unless a snapshot holds it
+    policy.engine = MAGIC_ENGINE_RBTREE;
+    m = MAGICinitWithPolicy(&policy);
+    MAGIC held = MAGICinitWithPolicy(&policy);
+    reference = MAGICinit();
+    MAGICadd(m, 0, 5);
+    MAGICadd(held, 0, 5);
+    MAGICadd(reference, 0, 5);
+    MAGICSnapshot s = MAGICsnapshot(held);
+    for (int i = 0; i < 2000; i++) {
+        int pos = rand() % 2000;
+        int len = (rand() % 10) + 1;
+        MAGICadd(m, pos, len);
+        MAGICadd(held, pos, len);
+        MAGICadd(reference, pos, len);
+        for (int j = 0; j < 4; j++) {
+            pos = rand() % 2000;
+            MAGICmap(m, STREAM_IN_OUT, pos);
+            MAGICmap(held, STREAM_IN_OUT, pos);
+        }
+    }
+    printTestResult("Log engine migrated", MAGICengine(m) != MAGIC_ENGINE_RBTREE, 1);
+    printTestResult("Snapshot keeps the log engine", MAGICengine(held), MAGIC_ENGINE_RBTREE);
+    printTestResult("Migrated log mismatches", compareWithReference(m, reference, 4000), 0);
+    printTestResult("Held log mismatches", compareWithReference(held, reference, 4000), 0);
+    printTestResult("Snapshot of the held log", (int)MAGICsnapshotMap(s, STREAM_IN_OUT, 10), 15);
+    MAGICsnapshotRelease(s);
+
+    // Once released, the snapshot no longer pins the engine
+    for (int i = 0; i < 2000; i++) {
+        int pos = rand() % 2000;
+        int len = (rand() % 10) + 1;
+        MAGICadd(held, pos, len);
+        MAGICadd(reference, pos, len);
+        for (int j = 0; j < 4; j++)
+            MAGICmap(held, STREAM_IN_OUT, rand() % 2000);
+    }
+    printTestResult("Released log migrated", MAGICengine(held) != MAGIC_ENGINE_RBTREE, 1);
+    printTestResult("Released log mismatches", compareWithReference(held, reference, 4000), 0);
+    MAGICdestroy(held);
+    MAGICdestroy(m);
+    MAGICdestroy(reference);
+
+    // No policy: the interval tree, never migrated
+    m = MAGICinitWithPolicy(NULL);
+    printTestResult("Default policy engine", MAGICengine(m), MAGIC_ENGINE_RBTREE);
+    MAGICdestroy(m);
+}
+
 int main() {
     printf("Starting tests for MAGIC ADT implementation...\n");
     
@@ -210,6 +1545,22 @@ int main() {
     runEdgeCaseTests();
     runSequentialTests();
     runErrorHandlingTests();
+    runEngineTests();
+    run64BitTests();
+    runBatchTests();
+    runRangeTests();
+    runVersionTests();
+    runConcurrentTests();
+    runPersistenceTests();
+    runJournalTests();
+    runStatsTests();
+    runComposeTests();
+    runCoalescingTests();
+    runCursorTests();
+    runBatchApplyTests();
+    runRollbackTests();
+    runRegistryTests();
+    runAdaptiveTests();
     
     // Print summary
     printf("\n==== TEST SUMMARY ====\n");
@@ -8,6 +8,7 @@
 /**
  * Performance test: Endurance test
  * Checks how MAGIC ADT performs over time as more operations are added 
+ * Totals only: benchmark.c reports comparable latencies (percentiles, JSON, baselines)
 */
 
 void printSectionHeader(const char* title) {
@@ -91,7 +92,7 @@ void runEnduranceTest(int durationSeconds) {
 }
 
 int main() {
-    srand(time(NULL));  // Initialize random seed once at program start
+    srand(42);  // Fixed seed: every run replays the same operations
     
     
     // Run the endurance test 
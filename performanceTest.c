@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 199309L  // clock_gettime, for wall-clock time of parallel batches
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -10,13 +11,26 @@
  * 1) Check program performance over increasing number of operations/maps: small, medium, large
  * 2) Check Stress test performance and robustness under load
  * 3) Check Spike test in order to test sudden increasing load  
- * 4) Check Volume test for large size bytestream 
+ * 4) Check Volume test for large size bytestream, past 4 GiB with the 64-bit API
+ * 5) Check Batch mapping against one MAGICmap call per position, on several threads, and sparse batches on a long rope
+ * 6) Check Startup time: replaying the operations, one by one or as one batch, against opening a saved mapping
+ * 7) Check Scan time: every position of a stream through MAGICmap against a cursor
+ * 8) Check Memory of many small instances: own chunks, a registry, then trimmed by the registry
+ * 9) Check a workload changing phase (interleaved operations and maps, then maps only) on fixed engines and an adaptive instance
+ * Totals only: benchmark.c reports comparable latencies (percentiles, JSON, baselines)
 */
 
 void printSectionHeader(const char* title) {
     printf("\n====== %s ======\n", title);
 }
 
+/* Wall-clock time in seconds (clock() adds up the time of every thread) */
+double wallClock() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
 /* Performance test: small workload with random operations */
 void runSmallPerformanceTest() {
     printSectionHeader("SMALL PERFORMANCE TEST");
@@ -439,10 +453,407 @@ void runVolumeTest() {
     printf("Time for 10,000 mappings with large positions: %f seconds\n", cpu_time_used);
     
     MAGICdestroy(m);
+
+    // Streams past 4 GiB go through the 64-bit API
+    m = MAGICinit();
+    if (m == NULL) {
+        printf("Failed to initialize MAGIC\n");
+        return;
+    }
+
+    int64_t maxPos64 = (int64_t)64 << 30;  // 64 GiB
+    printf("Position range: 0 to %lld\n", (long long)maxPos64);
+
+    printf("Adding operations with positions past 4 GiB...\n");
+    start = clock();
+
+    for (int i = 0; i < 5000; i++) {
+        int64_t pos = (((int64_t)rand() << 31) ^ rand()) % maxPos64;
+        int64_t len = (rand() % 1000000) + 1;  // Length between 1 and 1,000,000
+
+        if (i % 2 == 0) {
+            MAGICadd64(m, pos, len);
+        } else {
+            MAGICremove64(m, pos, len);
+        }
+    }
+
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    printf("Time to add 5,000 operations past 4 GiB: %f seconds\n", cpu_time_used);
+
+    // Every mapped byte must map back to itself
+    printf("Testing mapping past 4 GiB...\n");
+    int roundTripErrors = 0;
+    start = clock();
+
+    for (int i = 0; i < 10000; i++) {
+        int64_t pos = (((int64_t)rand() << 31) ^ rand()) % maxPos64;
+        int64_t mapped = MAGICmap64(m, STREAM_IN_OUT, pos);
+        if (mapped >= 0 && MAGICmap64(m, STREAM_OUT_IN, mapped) != pos)
+            roundTripErrors++;
+    }
+
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    printf("Time for 10,000 round trips past 4 GiB: %f seconds (%d errors)\n", cpu_time_used, roundTripErrors);
+
+    MAGICdestroy(m);
+}
+
+/*
+ * Batch Test: maps a large array of positions with MAGICmapBatch
+ */
+void runBatchTest() {
+    printSectionHeader("BATCH TEST");
+
+    int nbOperations = 10000;
+    int nbMaps = 100000;
+    int positionRange = 100000;
+
+    MAGIC m = MAGICinit();
+    int *in = malloc(nbMaps * sizeof(int));
+    int *out = malloc(nbMaps * sizeof(int));
+    if (m == NULL || in == NULL || out == NULL) {
+        printf("Failed to initialize batch test\n");
+        MAGICdestroy(m);
+        free(in);
+        free(out);
+        return;
+    }
+
+    clock_t start, end;
+    double cpu_time_used;
+
+    for (int i = 0; i < nbOperations; i++) {
+        int pos = rand() % positionRange;
+        int len = (rand() % 10) + 1;
+
+        if (i % 2 == 0) {
+            MAGICadd(m, pos, len);
+        } else {
+            MAGICremove(m, pos, len);
+        }
+    }
+
+    for (int i = 0; i < nbMaps; i++)
+        in[i] = rand() % positionRange;
+
+    start = clock();
+    for (int i = 0; i < nbMaps; i++)
+        out[i] = MAGICmap(m, STREAM_IN_OUT, in[i]);
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    printf("Time for %d MAGICmap calls: %f seconds\n", nbMaps, cpu_time_used);
+
+    start = clock();
+    MAGICmapBatch(m, STREAM_IN_OUT, in, out, nbMaps);
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    printf("Time for one MAGICmapBatch of %d random positions: %f seconds\n", nbMaps, cpu_time_used);
+
+    for (int i = 0; i < nbMaps; i++)
+        in[i] = (int)((long long)i * positionRange / nbMaps);
+
+    start = clock();
+    MAGICmapBatch(m, STREAM_IN_OUT, in, out, nbMaps);
+    end = clock();
+    cpu_time_used = ((double) (end - start)) / CLOCKS_PER_SEC;
+    printf("Time for one MAGICmapBatch of %d sorted positions: %f seconds\n", nbMaps, cpu_time_used);
+
+    free(in);
+    free(out);
+
+    // Parallel batch of queries clustered in the hot regions of the stress test
+    int nbParallelMaps = 4000000;
+    in = malloc(nbParallelMaps * sizeof(int));
+    out = malloc(nbParallelMaps * sizeof(int));
+    if (in == NULL || out == NULL) {
+        printf("Failed to initialize parallel batch test\n");
+        free(in);
+        free(out);
+        MAGICdestroy(m);
+        return;
+    }
+
+    for (int i = 0; i < nbParallelMaps; i++) {
+        int cluster = (i / 100000) % 3;
+        if (cluster == 0) {
+            in[i] = rand() % 10000;
+        } else if (cluster == 1) {
+            in[i] = 40000 + (rand() % 20000);
+        } else {
+            in[i] = 90000 + (rand() % 10000);
+        }
+    }
+
+    double wallStart = wallClock();
+    MAGICmapBatch(m, STREAM_IN_OUT, in, out, nbParallelMaps);
+    printf("Wall time for one MAGICmapBatch of %d clustered positions: %f seconds\n",
+           nbParallelMaps, wallClock() - wallStart);
+
+    for (unsigned int threads = 2; threads <= 8; threads *= 2) {
+        wallStart = wallClock();
+        MAGICmapBatchParallel(m, STREAM_IN_OUT, in, out, nbParallelMaps, threads);
+        printf("Wall time for one MAGICmapBatchParallel on %u threads: %f seconds\n",
+               threads, wallClock() - wallStart);
+    }
+
+    free(in);
+    free(out);
+    MAGICdestroy(m);
+
+    // Sparse batches on a rope of millions of pieces: descents interleaved
+    int nbRopeOperations = 2000000;
+    int nbBatches = 100;
+    int batchSize = 4096;
+    m = MAGICinitEngine(MAGIC_ENGINE_ROPE);
+    in = malloc(batchSize * sizeof(int));
+    out = malloc(batchSize * sizeof(int));
+    if (m == NULL || in == NULL || out == NULL) {
+        printf("Failed to initialize rope batch test\n");
+        MAGICdestroy(m);
+        free(in);
+        free(out);
+        return;
+    }
+
+    for (int i = 0; i < nbRopeOperations; i++)
+        MAGICadd(m, rand() % (i + 1000), (rand() % 10) + 1);
+
+    double single = 0, batched = 0;
+    for (int b = 0; b < nbBatches; b++) {
+        for (int i = 0; i < batchSize; i++)
+            in[i] = rand() % nbRopeOperations;
+
+        wallStart = wallClock();
+        for (int i = 0; i < batchSize; i++)
+            out[i] = MAGICmap(m, STREAM_OUT_IN, in[i]);
+        single += wallClock() - wallStart;
+
+        wallStart = wallClock();
+        MAGICmapBatch(m, STREAM_OUT_IN, in, out, batchSize);
+        batched += wallClock() - wallStart;
+    }
+    printf("Rope: %d MAGICmap calls in %f seconds, %d MAGICmapBatch of %d in %f seconds\n",
+           nbBatches * batchSize, single, nbBatches, batchSize, batched);
+
+    free(in);
+    free(out);
+    MAGICdestroy(m);
+}
+
+void runStartupTest() {
+    printSectionHeader("STARTUP TEST");
+
+    int nbOperations = 1000000;
+    int positionRange = 10000000;
+    const char *path = "performanceTest.img";
+    int *positions = malloc(nbOperations * sizeof(int));
+    int *lengths = malloc(nbOperations * sizeof(int));
+    if (positions == NULL || lengths == NULL) {
+        printf("Failed to initialize startup test\n");
+        free(positions);
+        free(lengths);
+        return;
+    }
+
+    for (int i = 0; i < nbOperations; i++) {
+        positions[i] = rand() % positionRange;
+        lengths[i] = (rand() % 10) + 1;
+    }
+
+    double wallStart = wallClock();
+    MAGIC m = MAGICinit();
+    for (int i = 0; i < nbOperations; i++) {
+        if (i % 2 == 0) {
+            MAGICadd(m, positions[i], lengths[i]);
+        } else {
+            MAGICremove(m, positions[i], lengths[i]);
+        }
+    }
+    printf("Wall time to replay %d operations: %f seconds\n", nbOperations, wallClock() - wallStart);
+
+    MAGICop *ops = malloc(nbOperations * sizeof(MAGICop));
+    if (ops != NULL) {
+        for (int i = 0; i < nbOperations; i++) {
+            ops[i].pos = positions[i];
+            ops[i].length = lengths[i];
+            ops[i].remove = (i % 2 != 0);
+        }
+
+        wallStart = wallClock();
+        MAGIC batch = MAGICinit();
+        MAGICapplyBatch(batch, ops, nbOperations);
+        printf("Wall time to apply them as one batch: %f seconds\n", wallClock() - wallStart);
+
+        int errors = 0;
+        for (int i = 0; i < 1000; i++) {
+            int pos = rand() % positionRange;
+            if (MAGICmap(batch, STREAM_OUT_IN, pos) != MAGICmap(m, STREAM_OUT_IN, pos))
+                errors++;
+        }
+        printf("Mapping errors after the batch: %d\n", errors);
+        MAGICdestroy(batch);
+        free(ops);
+    }
+
+    wallStart = wallClock();
+    MAGICsave(m, path);
+    printf("Wall time to save the mapping: %f seconds\n", wallClock() - wallStart);
+
+    wallStart = wallClock();
+    MAGIC mapped = MAGICopenMapped(path);
+    printf("Wall time to open the saved mapping: %f seconds\n", wallClock() - wallStart);
+
+    int errors = (mapped == NULL);
+    for (int i = 0; mapped != NULL && i < 1000; i++) {
+        int pos = rand() % positionRange;
+        if (MAGICmap(mapped, STREAM_IN_OUT, pos) != MAGICmap(m, STREAM_IN_OUT, pos))
+            errors++;
+    }
+    printf("Mapping errors after opening: %d\n", errors);
+
+    MAGICdestroy(mapped);
+    MAGICdestroy(m);
+    remove(path);
+    free(positions);
+    free(lengths);
+}
+
+/* Scan test: translating every offset of a stream front to back */
+void runScanTest() {
+    printSectionHeader("SCAN TEST");
+
+    int nbOperations = 5000;
+    int streamLength = 200000;
+
+    MAGIC m = MAGICinit();
+    for (int i = 0; i < nbOperations; i++) {
+        int pos = rand() % streamLength;
+        int len = (rand() % 10) + 1;
+        if (i % 2 == 0) {
+            MAGICadd(m, pos, len);
+        } else {
+            MAGICremove(m, pos, len);
+        }
+    }
+
+    enum MAGICDirection directions[] = {STREAM_IN_OUT, STREAM_OUT_IN};
+    const char *names[] = {"IN_OUT", "OUT_IN"};
+    for (int d = 0; d < 2; d++) {
+        long long checksum = 0, cursorChecksum = 0;
+
+        double wallStart = wallClock();
+        for (int pos = 0; pos < streamLength; pos++)
+            checksum += MAGICmap(m, directions[d], pos);
+        double mapTime = wallClock() - wallStart;
+
+        wallStart = wallClock();
+        MAGICCursor c = MAGICcursor(m, directions[d]);
+        for (int pos = 0; pos < streamLength; pos++)
+            cursorChecksum += MAGICcursorMap(c, pos);
+        MAGICcursorRelease(c);
+        double cursorTime = wallClock() - wallStart;
+
+        printf("%s scan of %d positions: MAGICmap %f seconds, cursor %f seconds (x%.1f)%s\n",
+               names[d], streamLength, mapTime, cursorTime, mapTime / cursorTime,
+               checksum == cursorChecksum ? "" : " MISMATCH");
+    }
+
+    MAGICdestroy(m);
+}
+
+/* Memory test: one small instance per document */
+void runRegistryTest() {
+    printSectionHeader("REGISTRY MEMORY TEST");
+
+    int nbInstances = 20000;
+    int nbOperations = 100;
+    MAGIC *instances = malloc(nbInstances * sizeof(MAGIC));
+    if (instances == NULL) {
+        printf("Failed to initialize registry test\n");
+        return;
+    }
+
+    // Instances with chunks of their own
+    size_t ownBytes = 0;
+    for (int i = 0; i < nbInstances; i++) {
+        instances[i] = MAGICinit();
+        for (int j = 0; j < nbOperations; j++)
+            MAGICadd(instances[i], rand() % 100000, (rand() % 10) + 1);
+        MAGICstatistics stats;
+        MAGICstats(instances[i], &stats);
+        ownBytes += stats.bytesAllocated;
+    }
+    for (int i = 0; i < nbInstances; i++)
+        MAGICdestroy(instances[i]);
+
+    // The same instances in a registry
+    double wallStart = wallClock();
+    MAGICRegistry r = MAGICregistryCreate(".");
+    for (int i = 0; i < nbInstances; i++) {
+        instances[i] = MAGICregistryInit(r, MAGIC_ENGINE_RBTREE);
+        for (int j = 0; j < nbOperations; j++)
+            MAGICadd(instances[i], rand() % 100000, (rand() % 10) + 1);
+    }
+    size_t pooledBytes = MAGICregistryBytes(r);
+    printf("Wall time to fill %d instances: %f seconds\n", nbInstances, wallClock() - wallStart);
+
+    wallStart = wallClock();
+    MAGICregistryTrim(r);
+    MAGICregistryTrim(r);
+    size_t compactedBytes = MAGICregistryBytes(r);
+    MAGICregistryTrim(r);
+    size_t spilledBytes = MAGICregistryBytes(r);
+    printf("Wall time to compact and spill them: %f seconds\n", wallClock() - wallStart);
+
+    double ops = (double)nbInstances * nbOperations;
+    printf("Bytes per operation: own chunks %.1f, registry %.1f, compacted %.1f, spilled %.1f\n",
+           ownBytes / ops, pooledBytes / ops, compactedBytes / ops, spilledBytes / ops);
+
+    MAGICregistryDestroy(r);
+    free(instances);
+}
+
+/* Phase test: one operation per map, then maps only */
+void runAdaptiveTest() {
+    printSectionHeader("ADAPTIVE ENGINE TEST");
+
+    int nbInterleaved = 20000;
+    int nbMaps = 2000000;
+    const char *names[] = {"compact", "rope", "adaptive"};
+    MAGICpolicy policies[] = {{MAGIC_ENGINE_COMPACT, 0, 0}, {MAGIC_ENGINE_ROPE, 0, 0},
+                              {MAGIC_ENGINE_COMPACT, 1, 0}};
+
+    for (int e = 0; e < 3; e++) {
+        srand(42);
+        MAGIC m = MAGICinitWithPolicy(&policies[e]);
+
+        double wallStart = wallClock();
+        for (int i = 0; i < nbInterleaved; i++) {
+            if (rand() % 2 == 0) {
+                MAGICadd(m, rand() % 1000000, (rand() % 10) + 1);
+            } else {
+                MAGICremove(m, rand() % 1000000, (rand() % 10) + 1);
+            }
+            MAGICmap(m, STREAM_IN_OUT, rand() % 1000000);
+        }
+        double interleaved = wallClock() - wallStart;
+
+        wallStart = wallClock();
+        for (int i = 0; i < nbMaps; i++)
+            MAGICmap(m, (enum MAGICDirection)(i % 2), rand() % 1000000);
+        double maps = wallClock() - wallStart;
+
+        printf("%-8s: %d interleaved in %f seconds, %d maps in %f seconds\n",
+               names[e], nbInterleaved, interleaved, nbMaps, maps);
+        MAGICdestroy(m);
+    }
 }
 
 int main() {
-    srand(time(NULL));  // Initialize random seed once at program start
+    srand(42);  // Fixed seed: every run replays the same operations
     
     printf("Starting performance tests with random operations\n");
     
@@ -453,4 +864,9 @@ int main() {
     runStressTest();
     runSpikeTest();    
     runVolumeTest();
+    runBatchTest();
+    runStartupTest();
+    runScanTest();
+    runRegistryTest();
+    runAdaptiveTest();
 }
\ No newline at end of file
@@ -0,0 +1,324 @@
+#define _DEFAULT_SOURCE  // mmap flags and madvise
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "arena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file arena.c
+ * \brief Implementation of the chunked arena
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * Chunks grow geometrically (64 objects first, doubling up to CHUNK_MAX_BYTES) so
+ * that small instances stay small. With huge pages, chunks are 2 MiB mappings
+ * advised for transparent huge pages (Linux only, malloc elsewhere). Pooled arenas
+ * use the chunks of their pool, all of the same size, and never huge pages.
+ *
+ */
+
+/* Alignment of every object */
+#define ARENA_ALIGN 16
+
+/* Number of objects of the first chunk */
+#define CHUNK_MIN_OBJECTS 64
+
+/* Chunks stop growing past this size */
+#define CHUNK_MAX_BYTES (4u << 20)
+
+/* Size of a huge page */
+#define HUGE_PAGE_BYTES (2u << 20)
+
+/* Header of a chunk, followed by the objects */
+typedef struct chunk {
+    struct chunk *next;  // previously allocated chunk
+    size_t bytes;        // size of the chunk, header included
+    int mapped;          // 1 if obtained with mmap
+} Chunk;
+
+struct arena {
+    size_t objectSize;   // size of an object, rounded to ARENA_ALIGN
+    Chunk *chunks;       // allocated chunks, most recent first
+    char *next;          // next free object
+    char *end;           // end of the current chunk (or caller memory)
+    size_t chunkBytes;   // size of the next chunk
+    size_t bytes;        // bytes reserved so far
+    int hugePages;       // back chunks with huge pages
+    ArenaPool *pool;     // pool of the chunks (NULL for chunks of its own)
+};
+
+struct arenaPool {
+    pthread_mutex_t lock;
+    size_t chunkBytes;   // size of every chunk
+    Chunk *chunks;       // chunks no arena holds (protected by lock)
+    size_t nbChunks;     // number of them
+};
+
+/* Prototypes of static functions */
+static size_t alignUp(size_t size, size_t alignment);
+static int arenaGrow(Arena *a);
+static Chunk *chunkAlloc(size_t bytes, int hugePages);
+static Chunk *poolTake(ArenaPool *p);
+
+/* Implementation of API */
+
+Arena *arenaCreate(size_t objectSize, void *memory, size_t memorySize, int hugePages) {
+    Arena *a = malloc(sizeof(Arena));
+    if (a == NULL) {
+        printf("arenaCreate: Allocation error\n");
+        return NULL;
+    }
+
+    a->objectSize = alignUp(objectSize, ARENA_ALIGN);
+    a->chunks = NULL;
+    a->next = NULL;
+    a->end = NULL;
+    a->chunkBytes = alignUp(sizeof(Chunk), ARENA_ALIGN) + CHUNK_MIN_OBJECTS * a->objectSize;
+    a->bytes = 0;
+    a->hugePages = hugePages;
+    a->pool = NULL;
+
+    if (hugePages && a->chunkBytes < HUGE_PAGE_BYTES)
+        a->chunkBytes = HUGE_PAGE_BYTES;
+
+    // Caller memory is used first, aligned
+    if (memory != NULL) {
+        uintptr_t start = alignUp((uintptr_t)memory, ARENA_ALIGN);
+        uintptr_t end = (uintptr_t)memory + memorySize;
+        if (start < end) {
+            a->next = (char *)start;
+            a->end = (char *)end;
+            a->bytes = memorySize;
+        }
+    }
+
+    return a;
+}
+
+Arena *arenaCreatePooled(size_t objectSize, ArenaPool *pool) {
+    Arena *a = arenaCreate(objectSize, NULL, 0, 0);
+    if (a == NULL || pool == NULL)
+        return a;
+
+    if (alignUp(sizeof(Chunk), ARENA_ALIGN) + a->objectSize <= pool->chunkBytes) {
+        a->pool = pool;
+        a->chunkBytes = pool->chunkBytes;
+    }
+    return a;
+}
+
+void *arenaAlloc(Arena *a) {
+    if (a == NULL)
+        return NULL;
+
+    if ((size_t)(a->end - a->next) < a->objectSize && !arenaGrow(a))
+        return NULL;
+
+    void *object = a->next;
+    a->next += a->objectSize;
+    return object;
+}
+
+void arenaFreeLast(Arena *a, void *object) {
+    if (a == NULL || object == NULL)
+        return;
+
+    // Only the object just below the next free one can be given back
+    if ((char *)object + a->objectSize == a->next)
+        a->next = object;
+}
+
+size_t arenaBytes(const Arena *a) {
+    return (a == NULL) ? 0 : a->bytes;
+}
+
+void arenaDestroy(Arena *a) {
+    if (a == NULL)
+        return;
+
+    if (a->pool != NULL && a->chunks != NULL) {
+        // Give the whole list back at once
+        Chunk *last = a->chunks;
+        size_t count = 1;
+        while (last->next != NULL) {
+            last = last->next;
+            count++;
+        }
+        pthread_mutex_lock(&a->pool->lock);
+        last->next = a->pool->chunks;
+        a->pool->chunks = a->chunks;
+        a->pool->nbChunks += count;
+        pthread_mutex_unlock(&a->pool->lock);
+        a->chunks = NULL;
+    }
+
+    Chunk *c = a->chunks;
+    while (c != NULL) {
+        Chunk *next = c->next;
+#ifdef __linux__
+        if (c->mapped) {
+            munmap(c, c->bytes);
+            c = next;
+            continue;
+        }
+#endif
+        free(c);
+        c = next;
+    }
+
+    free(a);
+}
+
+ArenaPool *arenaPoolCreate(size_t chunkBytes) {
+    ArenaPool *p = malloc(sizeof(ArenaPool));
+    if (p == NULL) {
+        printf("arenaPoolCreate: Allocation error\n");
+        return NULL;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    p->chunkBytes = alignUp(chunkBytes, ARENA_ALIGN);
+    p->chunks = NULL;
+    p->nbChunks = 0;
+
+    return p;
+}
+
+size_t arenaPoolBytes(ArenaPool *p) {
+    if (p == NULL)
+        return 0;
+
+    pthread_mutex_lock(&p->lock);
+    size_t bytes = p->nbChunks * p->chunkBytes;
+    pthread_mutex_unlock(&p->lock);
+    return bytes;
+}
+
+void arenaPoolRelease(ArenaPool *p) {
+    if (p == NULL)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    Chunk *c = p->chunks;
+    p->chunks = NULL;
+    p->nbChunks = 0;
+    pthread_mutex_unlock(&p->lock);
+
+    while (c != NULL) {
+        Chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
+
+void arenaPoolDestroy(ArenaPool *p) {
+    if (p == NULL)
+        return;
+
+    arenaPoolRelease(p);
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Round a size up to a multiple of a power of two
+ *
+ * @param size Size to round
+ * @param alignment Power of two
+ *
+ * @return size_t rounded size
+ */
+static size_t alignUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Allocate the next chunk and make it current
+ *
+ * @param a Arena
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+static int arenaGrow(Arena *a) {
+    Chunk *c = (a->pool != NULL) ? poolTake(a->pool) : chunkAlloc(a->chunkBytes, a->hugePages);
+    if (c == NULL) {
+        printf("arenaGrow: Allocation error\n");
+        return 0;
+    }
+
+    c->next = a->chunks;
+    a->chunks = c;
+    a->next = (char *)c + alignUp(sizeof(Chunk), ARENA_ALIGN);
+    a->end = (char *)c + c->bytes;
+    a->bytes += c->bytes;
+
+    if (a->pool == NULL && a->chunkBytes < CHUNK_MAX_BYTES)
+        a->chunkBytes *= 2;
+
+    return 1;
+}
+
+/**
+ * @brief Obtain the memory of a chunk
+ *
+ * @param bytes Size of the chunk
+ * @param hugePages Non-zero to request huge pages
+ *
+ * @return Chunk* the chunk, NULL on allocation error
+ */
+static Chunk *chunkAlloc(size_t bytes, int hugePages) {
+#ifdef __linux__
+    if (hugePages) {
+        bytes = alignUp(bytes, HUGE_PAGE_BYTES);
+        void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, bytes, MADV_HUGEPAGE);
+            Chunk *c = p;
+            c->bytes = bytes;
+            c->mapped = 1;
+            return c;
+        }
+    }
+#else
+    (void)hugePages;
+#endif
+
+    Chunk *c = malloc(bytes);
+    if (c == NULL)
+        return NULL;
+
+    c->bytes = bytes;
+    c->mapped = 0;
+    return c;
+}
+
+/**
+ * @brief Take a chunk of the pool, or allocate one
+ *
+ * @param p Pool
+ *
+ * @return Chunk* the chunk, NULL on allocation error
+ */
+static Chunk *poolTake(ArenaPool *p) {
+    pthread_mutex_lock(&p->lock);
+    Chunk *c = p->chunks;
+    if (c != NULL) {
+        p->chunks = c->next;
+        p->nbChunks--;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return (c != NULL) ? c : chunkAlloc(p->chunkBytes, 0);
+}
@@ -0,0 +1,119 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file arena.h
+ * @brief Interface of the chunked arena used to store the nodes of a MAGIC instance
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * Objects of a fixed size are carved out of large chunks. They are not freed
+ * one by one, except the last one allocated: the whole arena is released at once,
+ * in O(number of chunks).
+ *
+ * Arenas created on a pool share fixed-size chunks: a destroyed arena gives its
+ * chunks back to the pool, where the next arena to grow takes them.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena Arena;
+typedef struct arenaPool ArenaPool;
+
+/**
+ * @brief Creates an arena of fixed size objects
+ *
+ * @param objectSize Size of each object in bytes
+ * @param memory Caller-supplied memory used before any chunk is allocated (may be NULL)
+ * @param memorySize Size of memory in bytes
+ * @param hugePages Non-zero to back the chunks with huge pages when available
+ *
+ * @return Pointer to the new arena, NULL on allocation error
+ */
+Arena *arenaCreate(size_t objectSize, void *memory, size_t memorySize, int hugePages);
+
+/**
+ * @brief Creates an arena taking its chunks from a pool
+ *
+ * @param objectSize Size of each object in bytes (an arena of its own if a chunk cannot hold one)
+ * @param pool Pool shared by the arenas (thread-safe)
+ *
+ * @return Pointer to the new arena, NULL on allocation error
+ */
+Arena *arenaCreatePooled(size_t objectSize, ArenaPool *pool);
+
+/**
+ * @brief Allocates one object
+ *
+ * @param a Arena
+ *
+ * @return Pointer to the uninitialized object, NULL on allocation error
+ */
+void *arenaAlloc(Arena *a);
+
+/**
+ * @brief Gives back the last object allocated, to be returned by the next arenaAlloc
+ *
+ * Other objects (or the last one of a previous chunk) stay allocated until the
+ * arena is destroyed.
+ *
+ * @param a Arena
+ * @param object Object to give back
+ */
+void arenaFreeLast(Arena *a, void *object);
+
+/**
+ * @brief Number of bytes reserved by the arena (chunks and caller memory in use)
+ *
+ * @param a Arena
+ *
+ * @return Number of bytes
+ */
+size_t arenaBytes(const Arena *a);
+
+/**
+ * @brief Releases every object and chunk of the arena (caller memory is not freed)
+ * The chunks of a pooled arena go back to its pool
+ *
+ * @param a Arena to destroy
+ */
+void arenaDestroy(Arena *a);
+
+/**
+ * @brief Creates a pool of chunks of the same size
+ *
+ * @param chunkBytes Size of each chunk in bytes
+ *
+ * @return Pointer to the new pool, NULL on allocation error
+ */
+ArenaPool *arenaPoolCreate(size_t chunkBytes);
+
+/**
+ * @brief Number of bytes of the chunks no arena holds
+ *
+ * @param p Pool
+ *
+ * @return Number of bytes
+ */
+size_t arenaPoolBytes(ArenaPool *p);
+
+/**
+ * @brief Gives the chunks no arena holds back to the system
+ *
+ * @param p Pool
+ */
+void arenaPoolRelease(ArenaPool *p);
+
+/**
+ * @brief Destroys a pool (its arenas must have been destroyed)
+ *
+ * @param p Pool to destroy
+ */
+void arenaPoolDestroy(ArenaPool *p);
+
+#endif
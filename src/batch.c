@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "batch.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file batch.c
+ * \brief Helpers for mapping arrays of positions
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * Queries are sorted with a LSD radix sort (3 passes of 11 bits), which stays
+ * linear for the very large batches MAGICmapBatch is meant for
+ *
+ * Operations are applied to positions by branchless kernels, operation-major:
+ * each operation is broadcast and applied to a whole vector of positions.
+ * SSE4.2 (4 lanes), AVX2 (8 lanes) and AVX-512 (16 lanes) versions are picked at
+ * run time from the CPU features, with a scalar fallback (or -DMAGIC_NO_SIMD)
+ *
+ * The kernels compute on 32 bits: operations that could carry a position past
+ * INT32_MAX are applied by a 64-bit scalar loop instead, which caps the results
+ * like MAGICmap
+ *
+ */
+
+/* Radix sort parameters */
+#define RADIX_BITS 11
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_SIZE - 1)
+
+/* Number of operations converted per pass of the kernel */
+#define KERNEL_CHUNK 256
+
+/* SIMD kernels are built for x86 with GCC/Clang, selected at run time */
+#if !defined(MAGIC_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*
+ * One operation as seen by the kernels. Every test is a signed '>' comparison,
+ * so an operation is applied to a position p without any branch:
+ *   p > shiftAbove                      => p += shift
+ *   holeAbove < p <= holeLast           => p = -1 (removed or added byte)
+ * Negative positions (already unmapped) never pass a test since thresholds are >= -1.
+ */
+typedef struct {
+    int32_t shiftAbove;
+    int32_t shift;
+    int32_t holeAbove;
+    int32_t holeLast;
+} KernelOp;
+
+/* Signature of the kernels applying operations to positions in place */
+typedef void (*Kernel)(const KernelOp *ops, size_t nbOps, int *pos, size_t n);
+
+/* Kernel selected for the running CPU */
+static Kernel kernel = NULL;
+static size_t kernelLanes = 1;
+
+/* Prototypes of static functions */
+static uint32_t sortKey(int pos);
+static void toKernelOp(const Operation *op, enum MAGICDirection direction, KernelOp *kop);
+static void applyOperations(const Operation *ops, size_t nbOps, enum MAGICDirection direction, int *pos, size_t n);
+static void applyOperationsWide(const Operation *ops, size_t nbOps, enum MAGICDirection direction, int *pos, size_t n);
+static void selectKernel(void);
+static void kernelScalar(const KernelOp *ops, size_t nbOps, int *pos, size_t n);
+#ifdef BATCH_X86_KERNELS
+static void kernelSse(const KernelOp *ops, size_t nbOps, int *pos, size_t n);
+static void kernelAvx2(const KernelOp *ops, size_t nbOps, int *pos, size_t n);
+static void kernelAvx512(const KernelOp *ops, size_t nbOps, int *pos, size_t n);
+#endif
+
+/* Implementation of API */
+
+int batchIsSorted(const int *pos, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        if (pos[i] < pos[i - 1])
+            return 0;
+    }
+    return 1;
+}
+
+int batchSort(const int *pos, size_t n, int *sorted, size_t *order) {
+    uint32_t *keys = malloc(n * sizeof(uint32_t));
+    uint32_t *tmpKeys = malloc(n * sizeof(uint32_t));
+    size_t *tmpOrder = malloc(n * sizeof(size_t));
+    size_t *count = malloc(RADIX_SIZE * sizeof(size_t));
+    if (keys == NULL || tmpKeys == NULL || tmpOrder == NULL || count == NULL) {
+        printf("batchSort: Allocation error\n");
+        free(keys);
+        free(tmpKeys);
+        free(tmpOrder);
+        free(count);
+        return 0;
+    }
+
+    size_t *curOrder = order;
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = sortKey(pos[i]);
+        curOrder[i] = i;
+    }
+
+    // Stable counting sort on each digit, from the least significant one
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        memset(count, 0, RADIX_SIZE * sizeof(size_t));
+        for (size_t i = 0; i < n; i++)
+            count[(keys[i] >> shift) & RADIX_MASK]++;
+
+        size_t offset = 0;
+        for (size_t d = 0; d < RADIX_SIZE; d++) {
+            size_t c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            size_t dst = count[(keys[i] >> shift) & RADIX_MASK]++;
+            tmpKeys[dst] = keys[i];
+            tmpOrder[dst] = curOrder[i];
+        }
+
+        // The output of this pass is the input of the next one
+        uint32_t *swapKeys = keys;
+        keys = tmpKeys;
+        tmpKeys = swapKeys;
+        size_t *swapOrder = curOrder;
+        curOrder = tmpOrder;
+        tmpOrder = swapOrder;
+    }
+
+    if (curOrder != order) {
+        memcpy(order, curOrder, n * sizeof(size_t));
+        tmpOrder = curOrder;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        sorted[i] = pos[order[i]];
+
+    free(keys);
+    free(tmpKeys);
+    free(tmpOrder);
+    free(count);
+
+    return 1;
+}
+
+void batchApplyInOut(const Operation *ops, size_t nbOps, int *pos, size_t n) {
+    applyOperations(ops, nbOps, STREAM_IN_OUT, pos, n);
+}
+
+void batchApplyOutIn(const Operation *ops, size_t nbOps, int *pos, size_t n) {
+    applyOperations(ops, nbOps, STREAM_OUT_IN, pos, n);
+}
+
+int batchKernelFits(const Operation *ops, size_t nbOps, int64_t maxPos) {
+    // A position only grows by the lengths of the operations applied to it
+    int64_t reach = (maxPos > 0) ? maxPos : 0;
+
+    for (size_t k = 0; k < nbOps; k++) {
+        if (ops[k].pos + ops[k].length > INT32_MAX)
+            return 0;
+        reach += ops[k].length;
+        if (reach > INT32_MAX)
+            return 0;
+    }
+
+    return 1;
+}
+
+size_t batchKernelLanes(void) {
+    selectKernel();
+    return kernelLanes;
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Radix key of a position, ordered like the signed value
+ *
+ * @param pos Position
+ *
+ * @return uint32_t key
+ */
+static uint32_t sortKey(int pos) {
+    return (uint32_t)pos ^ 0x80000000u;
+}
+
+/**
+ * @brief Convert an operation to its kernel form for a mapping direction
+ *
+ * Adding bytes (or undoing a removal) shifts the positions at or after pos.
+ * Removing bytes (or undoing an addition) shifts the positions after the range
+ * back and unmaps the positions inside it.
+ * The operation must end below INT32_MAX (see batchKernelFits).
+ *
+ * @param op Operation
+ * @param direction Mapping direction
+ * @param kop Output kernel operation
+ */
+static void toKernelOp(const Operation *op, enum MAGICDirection direction, KernelOp *kop) {
+    int opensGap = (op->opType == ADD) == (direction == STREAM_IN_OUT);
+    int32_t low = (int32_t)op->pos;
+    int32_t last = (int32_t)(op->pos + op->length - 1);
+
+    if (opensGap) {
+        kop->shiftAbove = low - 1;
+        kop->shift = (int32_t)op->length;
+        kop->holeAbove = INT32_MAX; // no hole
+        kop->holeLast = INT32_MAX;
+    } else {
+        kop->shiftAbove = last;
+        kop->shift = -(int32_t)op->length;
+        kop->holeAbove = low - 1;
+        kop->holeLast = last;
+    }
+}
+
+/**
+ * @brief Apply operations to positions, by chunks of kernel operations
+ *
+ * @param ops Operations in chronological order
+ * @param nbOps Number of operations
+ * @param direction Mapping direction (STREAM_OUT_IN undoes them in reverse order)
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+static void applyOperations(const Operation *ops, size_t nbOps, enum MAGICDirection direction, int *pos, size_t n) {
+    KernelOp chunk[KERNEL_CHUNK];
+    int maxPos = 0;
+
+    for (size_t i = 0; i < n; i++)
+        maxPos = (pos[i] > maxPos) ? pos[i] : maxPos;
+
+    if (!batchKernelFits(ops, nbOps, maxPos)) {
+        applyOperationsWide(ops, nbOps, direction, pos, n);
+        return;
+    }
+
+    selectKernel();
+
+    for (size_t done = 0; done < nbOps; done += KERNEL_CHUNK) {
+        size_t count = (nbOps - done < KERNEL_CHUNK) ? nbOps - done : KERNEL_CHUNK;
+
+        for (size_t k = 0; k < count; k++) {
+            // Undo from the most recent operation when mapping output to input
+            const Operation *op = (direction == STREAM_IN_OUT) ? &ops[done + k] : &ops[nbOps - 1 - done - k];
+            toKernelOp(op, direction, &chunk[k]);
+        }
+
+        kernel(chunk, count, pos, n);
+    }
+}
+
+/**
+ * @brief Apply operations to positions on 64 bits, when they may not fit the kernels
+ * A position is mapped through every operation before being capped to INT_MAX,
+ * so an intermediate value past INT_MAX can still come back in range.
+ *
+ * @param ops Operations in chronological order
+ * @param nbOps Number of operations
+ * @param direction Mapping direction (STREAM_OUT_IN undoes them in reverse order)
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+static void applyOperationsWide(const Operation *ops, size_t nbOps, enum MAGICDirection direction, int *pos, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int64_t p = pos[i];
+
+        for (size_t k = 0; k < nbOps && p >= 0; k++) {
+            const Operation *op = (direction == STREAM_IN_OUT) ? &ops[k] : &ops[nbOps - 1 - k];
+            int opensGap = (op->opType == ADD) == (direction == STREAM_IN_OUT);
+
+            if (opensGap) {
+                if (p >= op->pos)
+                    p += op->length;
+            } else if (p >= op->pos + op->length) {
+                p -= op->length;
+            } else if (p >= op->pos) {
+                p = -1;
+            }
+        }
+
+        if (p != pos[i])
+            pos[i] = (p > INT_MAX) ? -1 : (int)p;
+    }
+}
+
+/**
+ * @brief Pick the widest kernel supported by the CPU (once)
+ */
+static void selectKernel(void) {
+    if (kernel != NULL)
+        return;
+
+    Kernel selected = kernelScalar;
+    size_t lanes = 1;
+#ifdef BATCH_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        selected = kernelAvx512;
+        lanes = 16;
+    } else if (__builtin_cpu_supports("avx2")) {
+        selected = kernelAvx2;
+        lanes = 8;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        selected = kernelSse;
+        lanes = 4;
+    }
+#endif
+
+    kernelLanes = lanes;
+    kernel = selected;
+}
+
+/**
+ * @brief Portable kernel, branchless on the position
+ *
+ * @param ops Kernel operations, in application order
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+static void kernelScalar(const KernelOp *ops, size_t nbOps, int *pos, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        int32_t p = pos[i];
+
+        for (size_t k = 0; k < nbOps; k++) {
+            int32_t shifted = -(int32_t)(p > ops[k].shiftAbove);
+            int32_t hole = -(int32_t)((p > ops[k].holeAbove) & (p <= ops[k].holeLast));
+            p = (int32_t)((uint32_t)p + (uint32_t)(shifted & ops[k].shift)) | hole;
+        }
+
+        pos[i] = p;
+    }
+}
+
+#ifdef BATCH_X86_KERNELS
+
+/**
+ * @brief SSE4.2 kernel: 4 positions per instruction
+ *
+ * @param ops Kernel operations, in application order
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+__attribute__((target("sse4.2")))
+static void kernelSse(const KernelOp *ops, size_t nbOps, int *pos, size_t n) {
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(pos + i));
+
+        for (size_t k = 0; k < nbOps; k++) {
+            __m128i shifted = _mm_cmpgt_epi32(p, _mm_set1_epi32(ops[k].shiftAbove));
+            __m128i hole = _mm_andnot_si128(_mm_cmpgt_epi32(p, _mm_set1_epi32(ops[k].holeLast)),
+                                            _mm_cmpgt_epi32(p, _mm_set1_epi32(ops[k].holeAbove)));
+            p = _mm_add_epi32(p, _mm_and_si128(shifted, _mm_set1_epi32(ops[k].shift)));
+            p = _mm_or_si128(p, hole);
+        }
+
+        _mm_storeu_si128((__m128i *)(pos + i), p);
+    }
+
+    kernelScalar(ops, nbOps, pos + i, n - i);
+}
+
+/**
+ * @brief AVX2 kernel: 8 positions per instruction, 4 vectors kept in registers
+ *
+ * @param ops Kernel operations, in application order
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+__attribute__((target("avx2")))
+static void kernelAvx2(const KernelOp *ops, size_t nbOps, int *pos, size_t n) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; ) {
+        // Up to 4 vectors share each broadcast of an operation
+        size_t nbVectors = (n - i) / 8;
+        if (nbVectors > 4)
+            nbVectors = 4;
+
+        __m256i p[4];
+        for (size_t v = 0; v < nbVectors; v++)
+            p[v] = _mm256_loadu_si256((const __m256i *)(pos + i + 8 * v));
+
+        for (size_t k = 0; k < nbOps; k++) {
+            __m256i shiftAbove = _mm256_set1_epi32(ops[k].shiftAbove);
+            __m256i shift = _mm256_set1_epi32(ops[k].shift);
+            __m256i holeAbove = _mm256_set1_epi32(ops[k].holeAbove);
+            __m256i holeLast = _mm256_set1_epi32(ops[k].holeLast);
+
+            for (size_t v = 0; v < nbVectors; v++) {
+                __m256i shifted = _mm256_cmpgt_epi32(p[v], shiftAbove);
+                __m256i hole = _mm256_andnot_si256(_mm256_cmpgt_epi32(p[v], holeLast),
+                                                   _mm256_cmpgt_epi32(p[v], holeAbove));
+                p[v] = _mm256_add_epi32(p[v], _mm256_and_si256(shifted, shift));
+                p[v] = _mm256_or_si256(p[v], hole);
+            }
+        }
+
+        for (size_t v = 0; v < nbVectors; v++)
+            _mm256_storeu_si256((__m256i *)(pos + i + 8 * v), p[v]);
+        i += 8 * nbVectors;
+    }
+
+    kernelScalar(ops, nbOps, pos + i, n - i);
+}
+
+/**
+ * @brief AVX-512 kernel: 16 positions per instruction, using mask registers
+ *
+ * @param ops Kernel operations, in application order
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+__attribute__((target("avx512f")))
+static void kernelAvx512(const KernelOp *ops, size_t nbOps, int *pos, size_t n) {
+    size_t i = 0;
+    const __m512i unmapped = _mm512_set1_epi32(-1);
+
+    for (; i + 16 <= n; i += 16) {
+        __m512i p = _mm512_loadu_si512((const void *)(pos + i));
+
+        for (size_t k = 0; k < nbOps; k++) {
+            __mmask16 shifted = _mm512_cmpgt_epi32_mask(p, _mm512_set1_epi32(ops[k].shiftAbove));
+            __mmask16 hole = _mm512_cmpgt_epi32_mask(p, _mm512_set1_epi32(ops[k].holeAbove)) &
+                             _mm512_cmple_epi32_mask(p, _mm512_set1_epi32(ops[k].holeLast));
+            p = _mm512_mask_add_epi32(p, shifted, p, _mm512_set1_epi32(ops[k].shift));
+            p = _mm512_mask_mov_epi32(p, hole, unmapped);
+        }
+
+        _mm512_storeu_si512((void *)(pos + i), p);
+    }
+
+    // Remaining positions with a masked load/store
+    if (i < n) {
+        __mmask16 lanes = (__mmask16)((1u << (n - i)) - 1);
+        __m512i p = _mm512_mask_loadu_epi32(unmapped, lanes, (const void *)(pos + i));
+
+        for (size_t k = 0; k < nbOps; k++) {
+            __mmask16 shifted = _mm512_cmpgt_epi32_mask(p, _mm512_set1_epi32(ops[k].shiftAbove));
+            __mmask16 hole = _mm512_cmpgt_epi32_mask(p, _mm512_set1_epi32(ops[k].holeAbove)) &
+                             _mm512_cmple_epi32_mask(p, _mm512_set1_epi32(ops[k].holeLast));
+            p = _mm512_mask_add_epi32(p, shifted, p, _mm512_set1_epi32(ops[k].shift));
+            p = _mm512_mask_mov_epi32(p, hole, unmapped);
+        }
+
+        _mm512_mask_storeu_epi32((void *)(pos + i), lanes, p);
+    }
+}
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file batch.h
+ * @brief Helpers for mapping arrays of positions
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * Engine independent building blocks of MAGICmapBatch: sorting the queries so the
+ * structures can be swept once, and applying operations to whole arrays of positions
+ *
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "magic.h"
+#include "operation.h"
+
+/**
+ * @brief Checks whether positions are in non-decreasing order
+ *
+ * @param pos Positions
+ * @param n Number of positions
+ *
+ * @return 1 if sorted, 0 otherwise
+ */
+int batchIsSorted(const int *pos, size_t n);
+
+/**
+ * @brief Sorts positions with a radix sort, keeping their original index
+ *
+ * @param pos Positions to sort
+ * @param n Number of positions
+ * @param sorted Output: the positions in non-decreasing order
+ * @param order Output: order[i] is the index in pos of sorted[i]
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+int batchSort(const int *pos, size_t n, int *sorted, size_t *order);
+
+/**
+ * @brief Applies operations in chronological order to positions (input to output)
+ * Negative positions are left untouched, removed positions and positions past INT_MAX become -1.
+ * Runs on the widest SIMD kernel supported by the CPU, on 64 bits when
+ * batchKernelFits rejects the operations.
+ *
+ * @param ops Operations
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+void batchApplyInOut(const Operation *ops, size_t nbOps, int *pos, size_t n);
+
+/**
+ * @brief Undoes operations in reverse order on positions (output to input)
+ * Negative positions are left untouched, added positions and positions past INT_MAX become -1.
+ * Runs on the widest SIMD kernel supported by the CPU, on 64 bits when
+ * batchKernelFits rejects the operations.
+ *
+ * @param ops Operations
+ * @param nbOps Number of operations
+ * @param pos Positions, mapped in place
+ * @param n Number of positions
+ */
+void batchApplyOutIn(const Operation *ops, size_t nbOps, int *pos, size_t n);
+
+/**
+ * @brief Checks whether operations can be applied by the 32-bit kernels
+ * Every operation must end below INT32_MAX, and no position up to maxPos may be
+ * shifted past it, even by all the operations together.
+ *
+ * @param ops Operations
+ * @param nbOps Number of operations
+ * @param maxPos Largest position to map
+ *
+ * @return 1 if the kernels map these positions exactly, 0 otherwise
+ */
+int batchKernelFits(const Operation *ops, size_t nbOps, int64_t maxPos);
+
+/**
+ * @brief Number of positions processed per instruction by the selected kernel
+ *
+ * @return 16 (AVX-512), 8 (AVX2), 4 (SSE4.2) or 1 (scalar)
+ */
+size_t batchKernelLanes(void);
+
+#endif
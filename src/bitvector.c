@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bitvector.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file bitvector.c
+ * \brief Implementation of the bitvector with constant-time rank and select
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * The rank index costs 64 bits per superblock (1/8 bit per bit). The select index
+ * costs two words per block, one per subblock of a dense block (1/8 bit per one),
+ * and the positions of the sparse blocks and subblocks (at most 1/8 bit per bit):
+ * about 1.25 bits per bit in all. Popcounts use the compiler builtin, a single
+ * instruction where the machine has one.
+ *
+ */
+
+/* Words of a superblock */
+#define SUPERBLOCK_WORDS (SUPERBLOCK_BITS / 64)
+
+/* Subblocks of a block */
+#define SUBBLOCKS_PER_BLOCK (SELECT_SAMPLE / SELECT_SUBSAMPLE)
+
+/* Flag of the entry of a sparse block */
+#define SPARSE_ENTRY ((uint64_t)1 << 63)
+
+/* Prototypes of static functions */
+static int buildSelect(BitVector *v, size_t *marks, size_t nbMarks);
+static void freeSelect(BitVector *v);
+static size_t nextOne(const BitVector *v, size_t i);
+static uint64_t rangeMask(size_t from, size_t to);
+static size_t selectInWord(uint64_t word, size_t k);
+
+/* Implementation of API */
+
+BitVector *bitVectorCreate(size_t nbBits) {
+    BitVector *v = malloc(sizeof(BitVector));
+    if (v == NULL) {
+        printf("bitVectorCreate: Allocation error\n");
+        return NULL;
+    }
+
+    v->nbBits = nbBits;
+    v->nbWords = (nbBits + 63) / 64;
+    v->nbSuperblocks = (v->nbWords + SUPERBLOCK_WORDS - 1) / SUPERBLOCK_WORDS;
+    v->words = calloc(v->nbSuperblocks * SUPERBLOCK_WORDS + 1, sizeof(uint64_t));
+    v->ranks = NULL;
+    v->ones = 0;
+    v->blocks = NULL;
+    v->nbBlocks = 0;
+    v->subblocks = NULL;
+    v->nbSubblocks = 0;
+    v->positions = NULL;
+    v->nbPositions = 0;
+    v->offsets = NULL;
+    v->nbOffsets = 0;
+    if (v->words == NULL) {
+        printf("bitVectorCreate: Allocation error\n");
+        free(v);
+        return NULL;
+    }
+
+    return v;
+}
+
+void bitVectorSetRange(BitVector *v, size_t start, size_t end) {
+    if (end > v->nbBits)
+        end = v->nbBits;
+    if (start >= end)
+        return;
+
+    size_t first = start / 64, last = (end - 1) / 64;
+    if (first == last) {
+        v->words[first] |= rangeMask(start % 64, (end - 1) % 64 + 1);
+        return;
+    }
+
+    v->words[first] |= rangeMask(start % 64, 64);
+    for (size_t w = first + 1; w < last; w++)
+        v->words[w] = UINT64_MAX;
+    v->words[last] |= rangeMask(0, (end - 1) % 64 + 1);
+}
+
+int bitVectorBuild(BitVector *v) {
+    free(v->ranks);
+    freeSelect(v);
+
+    v->ranks = malloc((v->nbSuperblocks + 1) * sizeof(uint64_t));
+    if (v->ranks == NULL) {
+        printf("bitVectorBuild: Allocation error\n");
+        return 0;
+    }
+
+    // Position of every SELECT_SUBSAMPLE-th one: at most one per superblock
+    size_t *marks = malloc((v->nbSuperblocks + 1) * sizeof(size_t));
+    if (marks == NULL) {
+        printf("bitVectorBuild: Allocation error\n");
+        return 0;
+    }
+
+    // Words past nbWords are zero: superblocks are counted whole
+    uint64_t ones = 0;
+    size_t nbMarks = 0;
+    for (size_t sb = 0; sb < v->nbSuperblocks; sb++) {
+        v->ranks[sb] = ones;
+        for (size_t w = sb * SUPERBLOCK_WORDS; w < (sb + 1) * SUPERBLOCK_WORDS; w++)
+            ones += (uint64_t)__builtin_popcountll(v->words[w]);
+
+        if (ones > (uint64_t)nbMarks * SELECT_SUBSAMPLE) {
+            size_t rest = (size_t)(nbMarks * SELECT_SUBSAMPLE - v->ranks[sb]);
+            size_t w = sb * SUPERBLOCK_WORDS;
+            while (rest >= (size_t)__builtin_popcountll(v->words[w]))
+                rest -= (size_t)__builtin_popcountll(v->words[w++]);
+            marks[nbMarks++] = w * 64 + selectInWord(v->words[w], rest);
+        }
+    }
+    v->ranks[v->nbSuperblocks] = ones;
+    v->ones = (size_t)ones;
+
+    return buildSelect(v, marks, nbMarks);
+}
+
+int bitVectorGet(const BitVector *v, size_t i) {
+    return (int)((v->words[i / 64] >> (i % 64)) & 1);
+}
+
+size_t bitVectorRank(const BitVector *v, size_t i) {
+    size_t sb = i / SUPERBLOCK_BITS;
+    size_t rank = (size_t)v->ranks[sb];
+
+    for (size_t w = sb * SUPERBLOCK_WORDS; w < i / 64; w++)
+        rank += (size_t)__builtin_popcountll(v->words[w]);
+    if (i % 64 != 0)
+        rank += (size_t)__builtin_popcountll(v->words[i / 64] & rangeMask(0, i % 64));
+
+    return rank;
+}
+
+size_t bitVectorSelect(const BitVector *v, size_t k) {
+    if (k >= v->ones)
+        return v->nbBits;
+
+    // Sparse block: the position is kept
+    const SelectBlock *block = &v->blocks[k / SELECT_SAMPLE];
+    if (block->entry & SPARSE_ENTRY)
+        return (size_t)v->positions[(block->entry & ~SPARSE_ENTRY) + k % SELECT_SAMPLE];
+
+    // Sparse subblock: the offset in the block is kept
+    size_t j = (k % SELECT_SAMPLE) / SELECT_SUBSAMPLE;
+    uint64_t subblock = v->subblocks[block->entry + j];
+    if (subblock >> 32)
+        return block->start + v->offsets[((subblock >> 32) - 1) * SELECT_SUBSAMPLE + k % SELECT_SUBSAMPLE];
+
+    // Dense subblock: last superblock with at most k ones before it, before the next
+    // subblock of the block, less than SPARSE_SUBBLOCK_BITS past its start
+    size_t low = (block->start + (size_t)(subblock & UINT32_MAX)) / SUPERBLOCK_BITS;
+    size_t high = low + SPARSE_SUBBLOCK_BITS / SUPERBLOCK_BITS;
+    if (j + 1 < SUBBLOCKS_PER_BLOCK && (k / SELECT_SUBSAMPLE + 1) * SELECT_SUBSAMPLE < v->ones)
+        high = (block->start + (size_t)(v->subblocks[block->entry + j + 1] & UINT32_MAX)) / SUPERBLOCK_BITS;
+    if (high > v->nbSuperblocks - 1)
+        high = v->nbSuperblocks - 1;
+    while (low < high) {
+        size_t mid = low + (high - low + 1) / 2;
+        if (v->ranks[mid] <= k) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    // Word of the superblock, then bit of the word
+    size_t rest = k - (size_t)v->ranks[low];
+    size_t w = low * SUPERBLOCK_WORDS;
+    for (;;) {
+        size_t count = (size_t)__builtin_popcountll(v->words[w]);
+        if (rest < count)
+            break;
+        rest -= count;
+        w++;
+    }
+
+    return w * 64 + selectInWord(v->words[w], rest);
+}
+
+size_t bitVectorBytes(const BitVector *v) {
+    if (v == NULL)
+        return 0;
+
+    size_t bytes = sizeof(BitVector) + (v->nbSuperblocks * SUPERBLOCK_WORDS + 1) * sizeof(uint64_t);
+    if (v->ranks != NULL)
+        bytes += (v->nbSuperblocks + 1) * sizeof(uint64_t);
+    if (v->blocks != NULL) {
+        bytes += (v->nbBlocks + 1) * sizeof(SelectBlock);
+        bytes += (v->nbSubblocks + 1 + v->nbPositions + 1) * sizeof(uint64_t);
+        bytes += (v->nbOffsets + 1) * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+void bitVectorDestroy(BitVector *v) {
+    if (v == NULL)
+        return;
+
+    free(v->words);
+    free(v->ranks);
+    freeSelect(v);
+    free(v);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Build the select index of a vector whose ranks are counted
+ * Blocks and subblocks start at the position of every SELECT_SUBSAMPLE-th one
+ *
+ * @param v Vector
+ * @param marks Position of every SELECT_SUBSAMPLE-th one, one more entry (freed)
+ * @param nbMarks Number of positions
+ * @return 1 on success, 0 on allocation error
+ */
+static int buildSelect(BitVector *v, size_t *marks, size_t nbMarks) {
+    marks[nbMarks] = v->nbBits;
+
+    // Sparse blocks, and subblocks (sparse or not) of the dense blocks
+    v->nbBlocks = (v->ones + SELECT_SAMPLE - 1) / SELECT_SAMPLE;
+    size_t sparseBlocks = 0, sparseSubblocks = 0;
+    v->nbSubblocks = 0;
+    for (size_t b = 0; b < v->nbBlocks; b++) {
+        size_t first = b * SUBBLOCKS_PER_BLOCK;
+        size_t end = (first + SUBBLOCKS_PER_BLOCK < nbMarks) ? first + SUBBLOCKS_PER_BLOCK : nbMarks;
+        if (marks[end] - marks[first] >= SPARSE_BLOCK_BITS) {
+            sparseBlocks++;
+            continue;
+        }
+        v->nbSubblocks += end - first;
+        for (size_t j = first; j < end; j++) {
+            if (marks[j + 1] - marks[j] >= SPARSE_SUBBLOCK_BITS)
+                sparseSubblocks++;
+        }
+    }
+
+    v->nbPositions = sparseBlocks * SELECT_SAMPLE;
+    v->nbOffsets = sparseSubblocks * SELECT_SUBSAMPLE;
+    v->blocks = malloc((v->nbBlocks + 1) * sizeof(SelectBlock));
+    v->subblocks = malloc((v->nbSubblocks + 1) * sizeof(uint64_t));
+    v->positions = malloc((v->nbPositions + 1) * sizeof(uint64_t));
+    v->offsets = malloc((v->nbOffsets + 1) * sizeof(uint32_t));
+    if (v->blocks == NULL || v->subblocks == NULL || v->positions == NULL || v->offsets == NULL) {
+        printf("buildSelect: Allocation error\n");
+        free(marks);
+        freeSelect(v);
+        return 0;
+    }
+
+    size_t subblock = 0, position = 0, offset = 0;
+    for (size_t b = 0; b < v->nbBlocks; b++) {
+        size_t first = b * SUBBLOCKS_PER_BLOCK;
+        size_t end = (first + SUBBLOCKS_PER_BLOCK < nbMarks) ? first + SUBBLOCKS_PER_BLOCK : nbMarks;
+        v->blocks[b].start = marks[first];
+
+        // Positions of the ones of a sparse block: few for the bits they span
+        if (marks[end] - marks[first] >= SPARSE_BLOCK_BITS) {
+            v->blocks[b].entry = SPARSE_ENTRY | position;
+            size_t count = (v->ones - b * SELECT_SAMPLE < SELECT_SAMPLE) ? v->ones - b * SELECT_SAMPLE : SELECT_SAMPLE;
+            for (size_t i = 0, p = marks[first]; i < count; i++, p = nextOne(v, p + 1))
+                v->positions[position + i] = p;
+            position += SELECT_SAMPLE;
+            continue;
+        }
+
+        // Offsets in the block, below SPARSE_BLOCK_BITS
+        v->blocks[b].entry = subblock;
+        for (size_t j = first; j < end; j++) {
+            uint64_t entry = marks[j] - marks[first];
+            if (marks[j + 1] - marks[j] >= SPARSE_SUBBLOCK_BITS) {
+                entry |= (uint64_t)(offset / SELECT_SUBSAMPLE + 1) << 32;
+                size_t count = (v->ones - j * SELECT_SUBSAMPLE < SELECT_SUBSAMPLE) ? v->ones - j * SELECT_SUBSAMPLE : SELECT_SUBSAMPLE;
+                for (size_t i = 0, p = marks[j]; i < count; i++, p = nextOne(v, p + 1))
+                    v->offsets[offset + i] = (uint32_t)(p - marks[first]);
+                offset += SELECT_SUBSAMPLE;
+            }
+            v->subblocks[subblock++] = entry;
+        }
+    }
+
+    free(marks);
+    return 1;
+}
+
+/**
+ * @brief Free the select index of a vector
+ *
+ * @param v Vector
+ */
+static void freeSelect(BitVector *v) {
+    free(v->blocks);
+    free(v->subblocks);
+    free(v->positions);
+    free(v->offsets);
+    v->blocks = NULL;
+    v->subblocks = NULL;
+    v->positions = NULL;
+    v->offsets = NULL;
+}
+
+/**
+ * @brief Position of the first one from a bit
+ *
+ * @param v Vector
+ * @param i First bit searched
+ * @return size_t index of the one, nbBits if there is none
+ */
+static size_t nextOne(const BitVector *v, size_t i) {
+    if (i >= v->nbBits)
+        return v->nbBits;
+
+    size_t w = i / 64;
+    uint64_t word = v->words[w] & rangeMask(i % 64, 64);
+    while (word == 0) {
+        if (++w >= v->nbWords)
+            return v->nbBits;
+        word = v->words[w];
+    }
+    return w * 64 + (size_t)__builtin_ctzll(word);
+}
+
+/**
+ * @brief Mask of the bits of a word in [from, to)
+ *
+ * @param from First bit (0 to 63)
+ * @param to End of the range (from + 1 to 64)
+ * @return uint64_t mask
+ */
+static uint64_t rangeMask(size_t from, size_t to) {
+    uint64_t high = (to == 64) ? UINT64_MAX : (((uint64_t)1 << to) - 1);
+    return high & ~(((uint64_t)1 << from) - 1);
+}
+
+/**
+ * @brief Position of a one in a word
+ *
+ * @param word Word
+ * @param k Rank of the one in the word (below its popcount)
+ * @return size_t index of the bit
+ */
+static size_t selectInWord(uint64_t word, size_t k) {
+    // Halves, quarters and bytes without the one are skipped
+    size_t shift = 0;
+    for (size_t width = 32; width >= 8; width /= 2) {
+        size_t count = (size_t)__builtin_popcountll(word & rangeMask(0, width));
+        if (k >= count) {
+            k -= count;
+            word >>= width;
+            shift += width;
+        }
+    }
+
+    for (size_t i = 0; i < k; i++)
+        word &= word - 1;  // clear the lowest one
+    return shift + (size_t)__builtin_ctzll(word);
+}
@@ -0,0 +1,140 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file bitvector.h
+ * @brief Interface of the bitvector with constant-time rank and select
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * Bits are set while the vector is filled, then bitVectorBuild indexes them: the
+ * number of ones before every superblock of 512 bits (rank is one lookup and at
+ * most 8 popcounts), and the select index. The ones are cut in blocks of
+ * SELECT_SAMPLE ones: a sparse block, spread over SPARSE_BLOCK_BITS bits or more,
+ * keeps the position of each of its ones. A dense block is cut again in subblocks of
+ * SELECT_SUBSAMPLE ones, with their offsets in the block: a sparse subblock keeps the
+ * offset of each of its ones, a dense one spans less than SPARSE_SUBBLOCK_BITS bits,
+ * where select binary searches at most 256 superblocks. Select is thus O(1), and the
+ * explicit positions never cost more than 1/8 bit per bit of the vector.
+ *
+ */
+
+#ifndef BITVECTOR_H
+#define BITVECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bits of a superblock of the rank index */
+#define SUPERBLOCK_BITS 512
+
+/* Ones of a block of the select index */
+#define SELECT_SAMPLE 4096
+
+/* Bits spanned by a block whose positions are kept (64 bits per one, 1/8 bit per bit) */
+#define SPARSE_BLOCK_BITS ((size_t)SELECT_SAMPLE * 64 * 8)
+
+/* Ones of a subblock of a dense block */
+#define SELECT_SUBSAMPLE 512
+
+/* Bits spanned by a subblock whose offsets are kept (32 bits per one, 1/8 bit per bit) */
+#define SPARSE_SUBBLOCK_BITS ((size_t)SELECT_SUBSAMPLE * 32 * 8)
+
+typedef struct selectBlock {
+    size_t start;          // position of the first one of the block
+    uint64_t entry;        // first subblock of a dense block, or SPARSE_ENTRY and first position
+} SelectBlock;
+
+typedef struct bitVector {
+    uint64_t *words;       // bits, least significant first
+    size_t nbBits;         // number of bits
+    size_t nbWords;        // number of words
+    uint64_t *ranks;       // ones before each superblock (one more entry for the end)
+    size_t nbSuperblocks;  // number of superblocks
+    size_t ones;           // number of ones (once built)
+    SelectBlock *blocks;   // blocks of the select index
+    size_t nbBlocks;       // number of blocks
+    uint64_t *subblocks;   // offset in the block of each first one, above bit 32 the offsets kept (0 if dense)
+    size_t nbSubblocks;    // number of subblocks (of the dense blocks)
+    uint64_t *positions;   // positions of the ones of the sparse blocks
+    size_t nbPositions;    // number of positions (SELECT_SAMPLE per sparse block)
+    uint32_t *offsets;     // offsets of the ones of the sparse subblocks
+    size_t nbOffsets;      // number of offsets (SELECT_SUBSAMPLE per sparse subblock)
+} BitVector;
+
+/**
+ * @brief Creates a vector of zeros
+ *
+ * @param nbBits Number of bits
+ *
+ * @return Pointer to the new vector, NULL on allocation error
+ */
+BitVector *bitVectorCreate(size_t nbBits);
+
+/**
+ * @brief Sets the bits of a range to one, a word at a time (before bitVectorBuild)
+ *
+ * @param v Vector
+ * @param start First bit of the range
+ * @param end End of the range (excluded, at most nbBits)
+ */
+void bitVectorSetRange(BitVector *v, size_t start, size_t end);
+
+/**
+ * @brief Builds the rank and select indexes, in O(nbBits / 64) plus the ones of the
+ * sparse blocks and subblocks
+ *
+ * @param v Vector
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+int bitVectorBuild(BitVector *v);
+
+/**
+ * @brief Reads a bit
+ *
+ * @param v Vector
+ * @param i Index of the bit (below nbBits)
+ *
+ * @return 1 if the bit is set, 0 otherwise
+ */
+int bitVectorGet(const BitVector *v, size_t i);
+
+/**
+ * @brief Number of ones before a bit, in O(1)
+ *
+ * @param v Built vector
+ * @param i Index of the bit (at most nbBits)
+ *
+ * @return Number of ones in [0, i)
+ */
+size_t bitVectorRank(const BitVector *v, size_t i);
+
+/**
+ * @brief Position of a one, in O(1)
+ *
+ * @param v Built vector
+ * @param k Rank of the one (0 for the first)
+ *
+ * @return Index of the k-th one, nbBits if there are only k ones or less
+ */
+size_t bitVectorSelect(const BitVector *v, size_t k);
+
+/**
+ * @brief Number of bytes allocated by a vector and its indexes
+ *
+ * @param v Vector (may be NULL)
+ *
+ * @return Number of bytes
+ */
+size_t bitVectorBytes(const BitVector *v);
+
+/**
+ * @brief Destroys a vector
+ *
+ * @param v Vector to destroy
+ */
+void bitVectorDestroy(BitVector *v);
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "epoch.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file epoch.c
+ * \brief Implementation of the epoch-based reclamation
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * Readers count themselves in the parity of the current epoch; every retirement
+ * flips the epoch so that new readers move to the other parity and the old one
+ * drains. A reader may hold an object retired after it entered whatever its
+ * parity, so an object is released once each parity has been seen empty after
+ * its retirement.
+ *
+ */
+
+/* Number of reader counters per parity */
+#define EPOCH_STRIPES 16
+
+/* Size of a cache line */
+#define CACHE_LINE 64
+
+/* Reader counter, alone on its cache line */
+typedef struct {
+    long count;
+    char pad[CACHE_LINE - sizeof(long)];
+} ReaderCount;
+
+/* Object waiting for the readers that may hold it */
+typedef struct retired {
+    void *object;
+    void (*release)(void *);
+    unsigned int seenEmpty;     // parities seen without reader since retirement (bit mask)
+    struct retired *next;
+} Retired;
+
+struct epoch {
+    ReaderCount readers[2][EPOCH_STRIPES];  // readers in each parity
+    unsigned long epoch;                    // current epoch (written by the writer only)
+    Retired *retired;                       // objects not released yet (writer only)
+};
+
+/* Prototypes of static functions */
+static unsigned int readerStripe(void);
+static int parityEmpty(Epoch *e, unsigned int parity);
+static void epochReclaim(Epoch *e);
+
+/* Implementation of API */
+
+Epoch *epochCreate(void) {
+    Epoch *e = calloc(1, sizeof(Epoch));
+    if (e == NULL) {
+        printf("epochCreate: Allocation error\n");
+        return NULL;
+    }
+
+    return e;
+}
+
+unsigned int epochEnter(Epoch *e) {
+    unsigned int stripe = readerStripe();
+
+    for (;;) {
+        unsigned long epoch = __atomic_load_n(&e->epoch, __ATOMIC_SEQ_CST);
+        unsigned int parity = epoch & 1;
+
+        __atomic_fetch_add(&e->readers[parity][stripe].count, 1, __ATOMIC_SEQ_CST);
+
+        // The epoch may have flipped before the increment was visible: retry in the new parity
+        if (__atomic_load_n(&e->epoch, __ATOMIC_SEQ_CST) == epoch)
+            return stripe * 2 + parity;
+
+        __atomic_fetch_sub(&e->readers[parity][stripe].count, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void epochExit(Epoch *e, unsigned int ticket) {
+    __atomic_fetch_sub(&e->readers[ticket & 1][ticket / 2].count, 1, __ATOMIC_SEQ_CST);
+}
+
+int epochRetire(Epoch *e, void *object, void (*release)(void *)) {
+    // New readers move to the other parity
+    __atomic_store_n(&e->epoch, e->epoch + 1, __ATOMIC_SEQ_CST);
+
+    Retired *r = malloc(sizeof(Retired));
+    if (r == NULL) {
+        printf("epochRetire: Allocation error\n");
+
+        // Wait for every reader that may hold the object
+        unsigned int seenEmpty = 0;
+        while (seenEmpty != 3) {
+            for (unsigned int parity = 0; parity < 2; parity++) {
+                if (parityEmpty(e, parity))
+                    seenEmpty |= 1u << parity;
+            }
+        }
+        release(object);
+        return 0;
+    }
+
+    r->object = object;
+    r->release = release;
+    r->seenEmpty = 0;
+    r->next = e->retired;
+    e->retired = r;
+
+    epochReclaim(e);
+    return 1;
+}
+
+void epochDestroy(Epoch *e) {
+    if (e == NULL)
+        return;
+
+    Retired *r = e->retired;
+    while (r != NULL) {
+        Retired *next = r->next;
+        r->release(r->object);
+        free(r);
+        r = next;
+    }
+
+    free(e);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Counter stripe of the calling thread
+ *
+ * @return unsigned int stripe
+ */
+static unsigned int readerStripe(void) {
+    uintptr_t id = (uintptr_t)pthread_self();
+
+    // Thread handles are aligned pointers on most systems: mix the high bits in
+    id ^= id >> 12;
+    id ^= id >> 7;
+    return (unsigned int)(id % EPOCH_STRIPES);
+}
+
+/**
+ * @brief Whether no reader is counted in a parity
+ *
+ * @param e State
+ * @param parity Parity
+ *
+ * @return 1 if every counter of the parity is zero, 0 otherwise
+ */
+static int parityEmpty(Epoch *e, unsigned int parity) {
+    for (unsigned int s = 0; s < EPOCH_STRIPES; s++) {
+        if (__atomic_load_n(&e->readers[parity][s].count, __ATOMIC_SEQ_CST) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Release the retired objects no reader may hold anymore
+ *
+ * @param e State
+ */
+static void epochReclaim(Epoch *e) {
+    unsigned int empty = 0;
+    for (unsigned int parity = 0; parity < 2; parity++) {
+        if (parityEmpty(e, parity))
+            empty |= 1u << parity;
+    }
+
+    Retired **link = &e->retired;
+    while (*link != NULL) {
+        Retired *r = *link;
+        r->seenEmpty |= empty;
+
+        if (r->seenEmpty == 3) {
+            *link = r->next;
+            r->release(r->object);
+            free(r);
+        } else {
+            link = &r->next;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file epoch.h
+ * @brief Interface of the epoch-based reclamation of published objects
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * A single writer replaces objects that readers use without locks. Readers enter
+ * and exit a read-side section around every use; the writer retires the objects
+ * it replaced, and they are released once no reader that may hold them remains.
+ * Readers only increment and decrement a counter, chosen among padded stripes so
+ * that readers on different cores rarely share a cache line.
+ *
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stddef.h>
+
+typedef struct epoch Epoch;
+
+/**
+ * @brief Creates the reclamation state of a set of published objects
+ *
+ * @return Pointer to the new state, NULL on allocation error
+ */
+Epoch *epochCreate(void);
+
+/**
+ * @brief Enters a read-side section (any thread, lock-free)
+ *
+ * @param e State
+ *
+ * @return Ticket to give back to epochExit
+ */
+unsigned int epochEnter(Epoch *e);
+
+/**
+ * @brief Exits a read-side section
+ *
+ * @param e State
+ * @param ticket Ticket returned by epochEnter
+ */
+void epochExit(Epoch *e, unsigned int ticket);
+
+/**
+ * @brief Retires an object no longer reachable by new readers (writer only)
+ *
+ * @param e State
+ * @param object Object replaced by the writer
+ * @param release Function releasing the object once no reader may hold it
+ *
+ * @return 1 on success, 0 on allocation error (the object is then released at once,
+ *         after waiting for the readers)
+ */
+int epochRetire(Epoch *e, void *object, void (*release)(void *));
+
+/**
+ * @brief Releases the retired objects and the state (no reader may be active)
+ *
+ * @param e State to destroy
+ */
+void epochDestroy(Epoch *e);
+
+#endif
@@ -0,0 +1,270 @@
+#define _DEFAULT_SOURCE  // fileno, fsync
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "journal.h"
+#include "segtable.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define JOURNAL_FSYNC 1
+#include <unistd.h>
+#endif
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file journal.c
+ * \brief Implementation of the append-only journal of operations
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * A journal file is a JournalHeader followed by 24-byte records: the position,
+ * the length, negated for a removal, and a checksum of both with the number of
+ * the record. Whatever a crash leaves at the end of the file (zeros, or parts of
+ * records not yet written) fails the checksum and ends the journal.
+ *
+ */
+
+/* Identification of a journal file */
+#define JOURNAL_MAGIC "MAGICJNL"
+#define JOURNAL_FORMAT 2
+#define JOURNAL_BYTE_ORDER 0x01020304u
+
+/* Seed of the record checksums, so a record of zeros never checks */
+#define JOURNAL_CHECK_SEED 0x4A4E4C5245434F52ull
+
+/* Size of the write buffer */
+#define JOURNAL_BUFFER (64u << 10)
+
+/* Header of a journal file */
+typedef struct {
+    char magic[8];          // JOURNAL_MAGIC
+    uint32_t format;        // JOURNAL_FORMAT
+    uint32_t byteOrder;     // JOURNAL_BYTE_ORDER as written by the machine
+    uint64_t baseVersion;   // version the first record applies to
+} JournalHeader;
+
+/* One operation in the file */
+typedef struct {
+    int64_t pos;
+    int64_t length;         // negative for a removal
+    uint64_t check;         // recordChecksum of the record and its number
+} JournalRecord;
+
+struct journal {
+    FILE *file;
+    char *path;
+    size_t length;          // records appended
+    size_t syncEvery;       // records between two syncs (0 for journalSync only)
+    size_t unsynced;        // records appended since the last sync
+    int failed;             // a write or a sync failed: the file may end with a partial record
+};
+
+/* Prototypes of static functions */
+static int writeHeader(FILE *file, size_t baseVersion);
+static uint64_t recordChecksum(const JournalRecord *record, uint64_t index);
+
+/* Implementation of API */
+
+Journal *journalCreate(const char *path, size_t baseVersion, size_t syncEvery) {
+    if (path == NULL)
+        return NULL;
+
+    Journal *j = malloc(sizeof(Journal));
+    char *copy = malloc(strlen(path) + 1);
+    char *tmp = malloc(strlen(path) + 5);
+    if (j == NULL || copy == NULL || tmp == NULL) {
+        printf("journalCreate: Allocation error\n");
+        free(j);
+        free(copy);
+        free(tmp);
+        return NULL;
+    }
+    j->path = copy;
+    strcpy(j->path, path);
+    strcpy(tmp, path);
+    strcat(tmp, ".tmp");
+
+    // The header reaches the disk before the new journal replaces the old one
+    j->file = fopen(tmp, "wb");
+    if (j->file != NULL)
+        setvbuf(j->file, NULL, _IOFBF, JOURNAL_BUFFER);
+    if (j->file == NULL || !writeHeader(j->file, baseVersion) || rename(tmp, path) != 0 ||
+        !segTableSyncDirectory(path)) {
+        printf("journalCreate: Cannot create %s\n", path);
+        if (j->file != NULL) {
+            fclose(j->file);
+            remove(tmp);
+        }
+        free(j->path);
+        free(j);
+        free(tmp);
+        return NULL;
+    }
+    free(tmp);
+
+    j->length = 0;
+    j->syncEvery = syncEvery;
+    j->unsynced = 0;
+    j->failed = 0;
+
+    return j;
+}
+
+int journalAppend(Journal *j, const Operation *op) {
+    if (j == NULL || j->failed)
+        return 0;
+
+    JournalRecord record;
+    record.pos = op->pos;
+    record.length = (op->opType == ADD) ? op->length : -op->length;
+    record.check = recordChecksum(&record, j->length);
+
+    if (fwrite(&record, sizeof(JournalRecord), 1, j->file) != 1) {
+        printf("journalAppend: Cannot write %s\n", j->path);
+        j->failed = 1;
+        return 0;
+    }
+    j->length++;
+    j->unsynced++;
+
+    // Group commit: one sync for syncEvery records
+    if (j->syncEvery > 0 && j->unsynced >= j->syncEvery)
+        return journalSync(j);
+    return 1;
+}
+
+int journalSync(Journal *j) {
+    if (j == NULL || j->failed)
+        return 0;
+
+    if (fflush(j->file) != 0) {
+        printf("journalSync: Cannot write %s\n", j->path);
+        j->failed = 1;
+        return 0;
+    }
+#ifdef JOURNAL_FSYNC
+    if (fsync(fileno(j->file)) != 0) {
+        printf("journalSync: Cannot sync %s\n", j->path);
+        j->failed = 1;
+        return 0;
+    }
+#endif
+
+    j->unsynced = 0;
+    return 1;
+}
+
+size_t journalLength(const Journal *j) {
+    return (j == NULL) ? 0 : j->length;
+}
+
+const char *journalPath(const Journal *j) {
+    return (j == NULL) ? NULL : j->path;
+}
+
+int journalLoad(const char *path, size_t *baseVersion, Operation **ops, size_t *n) {
+    *ops = NULL;
+    *n = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+
+    JournalHeader header;
+    if (fread(&header, sizeof(JournalHeader), 1, file) != 1 ||
+        memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.format != JOURNAL_FORMAT || header.byteOrder != JOURNAL_BYTE_ORDER) {
+        printf("journalLoad: %s is not a journal\n", path);
+        fclose(file);
+        return 0;
+    }
+    *baseVersion = (size_t)header.baseVersion;
+
+    size_t capacity = 0;
+    JournalRecord record;
+    while (fread(&record, sizeof(JournalRecord), 1, file) == 1) {
+        // Torn record: the journal ends here
+        if (record.check != recordChecksum(&record, *n) || record.length == 0 || record.pos < 0)
+            break;
+
+        if (*n == capacity) {
+            capacity = (capacity == 0) ? 1024 : 2 * capacity;
+            Operation *grown = realloc(*ops, capacity * sizeof(Operation));
+            if (grown == NULL) {
+                printf("journalLoad: Allocation error\n");
+                free(*ops);
+                *ops = NULL;
+                *n = 0;
+                fclose(file);
+                return 0;
+            }
+            *ops = grown;
+        }
+
+        (*ops)[*n].pos = record.pos;
+        (*ops)[*n].length = (record.length > 0) ? record.length : -record.length;
+        (*ops)[*n].opType = (record.length > 0) ? ADD : REMOVE;
+        (*n)++;
+    }
+
+    fclose(file);
+    return 1;
+}
+
+void journalClose(Journal *j) {
+    if (j == NULL)
+        return;
+
+    if (fclose(j->file) != 0)
+        printf("journalClose: Cannot write %s\n", j->path);
+    free(j->path);
+    free(j);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Write the header of a new journal and sync it
+ *
+ * @param file File open for writing
+ * @param baseVersion Version the first record applies to
+ * @return 1 on success, 0 on write error
+ */
+static int writeHeader(FILE *file, size_t baseVersion) {
+    JournalHeader header;
+    memset(&header, 0, sizeof(JournalHeader));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.format = JOURNAL_FORMAT;
+    header.byteOrder = JOURNAL_BYTE_ORDER;
+    header.baseVersion = baseVersion;
+
+    if (fwrite(&header, sizeof(JournalHeader), 1, file) != 1 || fflush(file) != 0)
+        return 0;
+#ifdef JOURNAL_FSYNC
+    if (fsync(fileno(file)) != 0)
+        return 0;
+#endif
+    return 1;
+}
+
+/**
+ * @brief Checksum of a record, mixing its number so a record never checks elsewhere
+ *
+ * @param record Record (its check field is ignored)
+ * @param index Number of the record in the journal
+ * @return 64-bit checksum
+ */
+static uint64_t recordChecksum(const JournalRecord *record, uint64_t index) {
+    uint64_t h = JOURNAL_CHECK_SEED ^ index;
+
+    h = (h ^ (uint64_t)record->pos) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 32;
+    h = (h ^ (uint64_t)record->length) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    return h;
+}
@@ -0,0 +1,95 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file journal.h
+ * @brief Interface of the append-only journal of operations
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * A journal records the operations applied after a given version (the version of
+ * the checkpoint it continues) as fixed-size binary records. Records are buffered
+ * and reach the disk in groups: on every syncEvery-th record, or on journalSync.
+ * Records carry a checksum: a record torn by a crash ends the journal. A failed
+ * write or sync is final: the journal takes no more records.
+ *
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include "operation.h"
+
+typedef struct journal Journal;
+
+/**
+ * @brief Creates an empty journal, replacing the file atomically
+ * The new file and its directory entry are synced before returning.
+ *
+ * @param path Path of the journal
+ * @param baseVersion Version the first record applies to
+ * @param syncEvery Records between two syncs to the disk (0 to sync only on journalSync)
+ *
+ * @return Pointer to the journal, NULL on error
+ */
+Journal *journalCreate(const char *path, size_t baseVersion, size_t syncEvery);
+
+/**
+ * @brief Appends an operation (buffered)
+ *
+ * @param j Journal
+ * @param op Operation
+ *
+ * @return 1 on success, 0 on write error (now or before)
+ */
+int journalAppend(Journal *j, const Operation *op);
+
+/**
+ * @brief Writes the buffered records and waits for the disk
+ *
+ * @param j Journal
+ *
+ * @return 1 on success, 0 on write error (now or before)
+ */
+int journalSync(Journal *j);
+
+/**
+ * @brief Number of records appended since the journal was created
+ *
+ * @param j Journal
+ *
+ * @return Number of records
+ */
+size_t journalLength(const Journal *j);
+
+/**
+ * @brief Path of the journal file
+ *
+ * @param j Journal
+ *
+ * @return Path given to journalCreate
+ */
+const char *journalPath(const Journal *j);
+
+/**
+ * @brief Reads the complete records of a journal file
+ *
+ * @param path Path of the journal
+ * @param baseVersion Output: version the first record applies to
+ * @param ops Output: operations in order (NULL if there is none, to free)
+ * @param n Output: number of operations
+ *
+ * @return 1 on success, 0 if the file is missing, not a journal or cannot be read
+ */
+int journalLoad(const char *path, size_t *baseVersion, Operation **ops, size_t *n);
+
+/**
+ * @brief Writes the buffered records and closes the journal
+ *
+ * @param j Journal to close
+ */
+void journalClose(Journal *j);
+
+#endif
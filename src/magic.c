@@ -1,6 +1,23 @@
+#ifdef MAGIC_STATS
+#define _DEFAULT_SOURCE  // clock_gettime (instrumented build)
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 #include "magic.h"
+#include "operation.h"
+#include "segtable.h"
+#include "batch.h"
+#include "arena.h"
+#include "oplog.h"
+#include "rope.h"
+#include "epoch.h"
+#include "pool.h"
+#include "journal.h"
+#include "succinct.h"
 
 /**
  * INFO0027: - Programming Techniques (Algorithmics)
@@ -14,6 +31,41 @@
  *
  * Implements the MAGIC ADT using an Interval Tree based on a Red-Black Tree
  * Sorted by sequence number with interval metadata (minSubtree) for pruning 
+ * Nodes live in a chunked arena owned by the instance (see arena.h)
+ * Boundaries are stored on 32 bits; the first operation past 32 bits widens the
+ * instance, and its tree is rebuilt once with 64-bit boundaries (WNode)
+ *
+ * The compact engine instead buffers the operations and folds them lazily into
+ * a segment table (see segtable.h) on which MAGICmap is a binary search
+ *
+ * The hybrid engine keeps the interval tree as log, and answers queries through a
+ * segment table of the operations up to an epoch, followed by the short delta of
+ * operations recorded since. The delta is folded once it exceeds the compaction
+ * policy, optionally on a worker thread
+ *
+ * The flat engine appends the operations to arrays (see oplog.h) and scans them
+ *
+ * The rope engine describes the output stream as pieces in a tree keyed by output
+ * position (see rope.h), its nodes live in the arena as well
+ *
+ * The succinct engine records like the compact one, and indexes each folded table
+ * with rank/select bitvectors up to a bound (see succinct.h)
+ *
+ * In concurrent mode the writer publishes immutable snapshots through an atomic
+ * pointer; readers map against the published one without locks, and replaced
+ * snapshots are released once no reader may hold them (see epoch.h)
+ *
+ * An adaptive instance estimates the cost of its recent operations and mappings on
+ * each engine, and migrates between the compact and rope engines when the cost saved
+ * since the workload changed exceeds that of rebuilding the structure
+ *
+ * Instances of a registry share one pool of small node chunks; the registry
+ * compacts the instances idle since its previous trim into segment tables, and
+ * spills idle compact instances to files mapped back in memory
+ *
+ * Compiled with MAGIC_STATS, the instance counts the nodes its mappings traverse
+ * and prune, its rotations and the latency of each call (see MAGICstats); the
+ * counting macros are empty otherwise
  * 
  */
 
@@ -23,502 +75,3278 @@ typedef struct INode_t INode;
 /* Enum for tracking colors */
 typedef enum {RED=0, BLACK=1} Color;
 
-/* Enum for operation type */
-typedef enum {REMOVE=0, ADD=1} OperationType;
-
+/*
+ * Sequence numbers only grow: nodes are inserted and removed at the end of the
+ * right spine, which rbInsert and rbRemoveLast walk down, so nodes keep no parent.
+ * Nodes are aligned by their arena: the color and the type live in the low bit of
+ * the child links, and the sequence number keeps 32 bits (32 bytes per node)
+ */
 struct INode_t {
     unsigned int low;  // lower boundary of the interval (pos)
     unsigned int high;      // high boundary of the interval (pos + length)
-    unsigned int seqNumber;   // sequence number to track chronological order
-    OperationType opType;  // 1 for add, -1 for remove
-
     unsigned int minSubtree;  // minimum low value in this subtree (for pruning)
-    
-    Color color;  // Color of node in RB tree 
-    INode *left, *right, *parent;
+
+    unsigned int seqNumber;   // sequence number to track chronological order
+    uintptr_t leftLink;       // left child, color of the node in the low bit
+    uintptr_t rightLink;      // right child, operation type (ADD or REMOVE) in the low bit
 };
 
+/* Children, color and type of a node, packed in its links */
+#define LINK_TAG ((uintptr_t)1)
+#define LEFT(n) ((INode *)((n)->leftLink & ~LINK_TAG))
+#define RIGHT(n) ((INode *)((n)->rightLink & ~LINK_TAG))
+#define SET_LEFT(n, child) ((n)->leftLink = (uintptr_t)(child) | ((n)->leftLink & LINK_TAG))
+#define SET_RIGHT(n, child) ((n)->rightLink = (uintptr_t)(child) | ((n)->rightLink & LINK_TAG))
+#define COLOR(n) ((Color)((n)->leftLink & LINK_TAG))
+#define SET_COLOR(n, c) ((n)->leftLink = ((n)->leftLink & ~LINK_TAG) | (uintptr_t)(c))
+#define OP_TYPE(n) ((OperationType)((n)->rightLink & LINK_TAG))
+
+/* Interval Node of a wide instance: 64-bit boundaries follow the node */
+typedef struct {
+    INode node;            // links, color, sequence number and type (32-bit boundaries unused)
+    int64_t low;           // lower boundary of the interval (pos)
+    int64_t high;          // high boundary of the interval (pos + length)
+    int64_t minSubtree;    // minimum low value in this subtree (for pruning)
+} WNode;
+
+/* 64-bit view of a node of a wide instance */
+#define WIDE(n) ((WNode *)(n))
+
+/* Operations of an interval tree (sequence numbers fit in 32 bits, see MAGICEngine) */
+#define MAX_TREE_SIZE ((size_t)UINT_MAX)
+
+/* Bound on the length of the right spine of a red-black tree of MAX_TREE_SIZE nodes */
+#define MAX_SPINE 64
+
+/* Positions and lengths of the 64-bit API stay below this bound */
+#define MAX_POSITION ((int64_t)1 << 60)
+
+/* Default bytes of each stream covered by the bitvectors of the succinct engine */
+#define DEFAULT_SUCCINCT_BOUND ((int64_t)1 << 27)
+
+/* Default number of operations in the delta of the hybrid engine */
+#define DEFAULT_MAX_DELTA 512
+
+/* Default calls between two estimations of the workload of an adaptive instance */
+#define DEFAULT_ADAPT_WINDOW 4096
+
+/* Estimated cost of a migration, per segment (units of the workload cost model) */
+#define MIGRATION_COST 8
+
+/* Size of the node chunks shared by the instances of a registry */
+#define REGISTRY_CHUNK_BYTES (4u << 10)
+
+/* Batches smaller than this are mapped query by query */
+#define BATCH_MIN_SWEEP 32
+
+/* Sorted batches on the rope with fewer queries than pieces / ROPE_SPARSE_BATCH interleave their descents */
+#define ROPE_SPARSE_BATCH 16
+
+/* Queries per chunk of a parallel batch (unit of work stealing) */
+#define PARALLEL_CHUNK 16384
+
+/* Counters of the instrumented build */
+#ifdef MAGIC_STATS
+#define STATS_COUNT(m, counter) ((m)->stats.counter++)
+#define STATS_TRAVERSAL(counter) (traversalStats->counter++)
+#define STATS_START(start) uint64_t start = clockNanoseconds()
+#define STATS_LATENCY(m, histogram, start) recordLatency((m)->stats.histogram, clockNanoseconds() - (start))
+#else
+#define STATS_COUNT(m, counter) ((void)0)
+#define STATS_TRAVERSAL(counter) ((void)0)
+#define STATS_START(start) ((void)0)
+#define STATS_LATENCY(m, histogram, start) ((void)0)
+#endif
+
+/* Background compaction of the hybrid engine */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int done;              // result is ready (protected by lock)
+
+    const SegTable *base;  // table at the epoch, not modified while the job runs
+    Operation *ops;        // copy of the delta operations being folded
+    size_t nbOps;          // number of operations being folded
+    SegTable *result;      // folded table (NULL on allocation error)
+} Compaction;
+
+/* Parallel batch: chunks of queries mapped through a shared table */
+typedef struct {
+    const SegTable *table;           // table of the current version, read only
+    enum MAGICDirection direction;
+    const int *in;
+    int *out;
+    size_t n;
+    int **sorted;                    // per-worker buffer of sorted queries (allocated on demand)
+    size_t **order;                  // per-worker original index of the sorted queries
+} ParallelBatch;
+
 /* MAGIC ADT */
 struct magic {
+    enum MAGICEngine engine;  // data structure storing the operations
+
     INode *root;
     size_t size;           // store number of nodes (operations)
+    Arena *nodes;          // memory of the nodes
+    int hugePages;         // back the node chunks with huge pages
+    int wide;              // 1 once an operation did not fit in 32 bits
+
+    SegTable *table;       // compacted mapping of the folded operations (compact, hybrid)
+    Operation *pending;    // operations not yet folded into table (compact, hybrid delta)
+    size_t nbPending;      // number of pending operations
+    size_t capPending;     // allocated number of pending operations
+
+    OpLog *log;            // operations in chronological order (flat engine)
+    Succinct *index;       // rank/select index of table, built on demand (succinct engine)
+    int indexFailed;       // the index of table could not be built: table searched until the next fold
+    int64_t bound;         // bytes of each stream covered by the index
+    Rope *rope;            // pieces of the output stream (rope engine)
+
+    MAGICcompaction compaction;  // compaction policy (hybrid engine)
+    Compaction *job;             // compaction running in background, if any
+
+    Epoch *readers;              // readers of the published snapshots (concurrent mode)
+    struct magicSnapshot *published;  // last published snapshot (atomic pointer)
+    size_t publishEvery;         // operations between automatic publications (0 for none)
+    size_t sincePublish;         // operations recorded since the last publication
+
+    Journal *journal;            // journal of the operations (NULL if not journaled)
+    MAGICjournal durability;     // sync and checkpoint policy of the journal
+    int journalBehind;           // a record or a checkpoint failed: the journal misses operations
+
+    int coalesce;          // merge each operation with the previous one when possible
+    Operation last;        // last operation recorded (after merging)
+    int lastOpen;          // last may still be merged: no snapshot holds its version
+
+    size_t held;           // last version held by a live snapshot of a log engine (no rollback before)
+    size_t *heldVersions;  // versions of the live snapshots holding the log (in no order)
+    size_t nbHeld;         // number of such snapshots
+    size_t capHeld;        // allocated entries of heldVersions
+    SegTable *saved;       // table at the last savepoint (compact engines)
+    size_t savedVersion;   // version of saved
+
+    struct magicRegistry *registry;  // registry of the instance (NULL if none)
+    size_t registryIndex;  // index of the instance in its registry
+    int used;              // operations or mappings since the last trim of the registry
+
+    int adaptive;          // migrate between the compact and rope engines (adaptive policy)
+    size_t window;         // calls between two estimations of the workload
+    size_t calls;          // calls of the current window
+    size_t updates;        // operations of the current window
+    size_t maps;           // mappings of the current window
+    size_t folds;          // mappings of the current window right after an operation
+    int afterUpdate;       // the last call was an operation
+    uint64_t regret;       // cost the cheapest engine would have saved since the workload changed
+
+#ifdef MAGIC_STATS
+    MAGICstatistics stats;       // counters of the instrumented build
+#endif
+};
+
+#ifdef MAGIC_STATS
+/* Counters of the instance traversed by the current thread (set by mapTree) */
+static __thread MAGICstatistics *traversalStats;
+#endif
+
+/* Snapshot of an instance at a version */
+struct magicSnapshot {
+    MAGIC m;               // instance (the log engines fold their log on first use)
+    size_t version;        // number of operations applied
+    SegTable *table;       // table of the version (shared, copied or folded lazily)
+    Operation *delta;      // hybrid delta at the version, applied after table
+    size_t nbDelta;        // number of delta operations
+    int holds;             // the log of m is held at version until the release
+};
+
+/* Cursor over the segments of a version */
+struct magicCursor {
+    SegTable *table;                 // table of the version (held by the cursor)
+    enum MAGICDirection direction;
+    size_t segment;                  // segment of the last position mapped
+};
+
+/* Threads kept between parallel batches */
+struct magicWorkers {
+    Pool *pool;
+};
+
+/* Instances sharing a pool of node chunks */
+struct magicRegistry {
+    pthread_mutex_t lock;            // protects the instances
+    ArenaPool *pool;                 // chunks of the nodes of the instances
+    char *spillDirectory;            // directory of the spill files (NULL for none)
+    size_t spills;                   // spill files written (names them)
+    MAGIC *instances;
+    size_t nbInstances;
+    size_t capInstances;
 };
 
 /* Prototypes of static functions */
-static INode *createNode(int low, int high, OperationType OperationType, unsigned int seqNumber);
-static void destroyTree(INode *root);
-static void updateMinSubtree(INode *node);
-static void leftRotate(MAGIC m, INode *x);
-static void rightRotate(MAGIC m, INode *x);
-static void rbInsertFixup(MAGIC m, INode *newNode);
+static INode *createNode(Arena *nodes, int wide, int64_t low, int64_t high, OperationType OperationType, unsigned int seqNumber);
+static void updateMinSubtree(INode *node, int wide);
+static void leftRotate(MAGIC m, INode *x, INode *parent);
+static void rightRotate(MAGIC m, INode *x, INode *parent);
+static void rbInsertFixup(MAGIC m, INode **spine, size_t depth);
 static void rbInsert(MAGIC m, INode *newNode);
-static int mapInOut(INode *node, int pos);
-static int mapOutIn(INode *node, int pos);
+static void rbRemoveLast(MAGIC m);
+static void rbRemoveFixup(MAGIC m, INode **spine, size_t depth);
+static size_t rightSpine(MAGIC m, INode **spine);
+static void updateSpine(MAGIC m);
+static int64_t mapTree(MAGIC m, enum MAGICDirection direction, int64_t pos, size_t limit);
+static int64_t mapInOut(INode *node, int64_t pos, size_t limit);
+static int64_t mapOutIn(INode *node, int64_t pos, size_t limit);
+static int64_t mapInOutWide(INode *node, int64_t pos, size_t limit);
+static int64_t mapOutInWide(INode *node, int64_t pos, size_t limit);
+static size_t treeHeight(const INode *node);
+static int widenTree(MAGIC m);
+static void collectNodes(INode *node, INode **nodes);
+static INode *linkBalanced(INode **nodes, size_t count, int wide);
+static INode *buildBalanced(INode **nodes, size_t count, size_t depth, size_t height, int wide);
+static int validOperation(int64_t pos, int64_t length);
+static int bulkLoad(MAGIC m, const MAGICop *ops, size_t n);
+static void recordOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType);
+static int applyOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType);
+static int coalesceOperations(const Operation *last, int64_t pos, int64_t length, OperationType opType, Operation *merged);
+static int dropLastOperation(MAGIC m);
+static int publishSnapshot(MAGIC m);
+static void releaseSnapshot(void *snapshot);
+static int holdVersion(MAGIC m, size_t version);
+static void unholdVersion(MAGIC m, size_t version);
+static void journalOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType);
+static int startJournal(MAGIC m, const char *path, const MAGICjournal *config);
+static char *checkpointPath(const char *path);
+static int pendingAppend(MAGIC m, int64_t pos, int64_t length, OperationType opType);
+static int compactFold(MAGIC m);
+static int64_t mapDeltaInOut(const Operation *ops, size_t n, int64_t pos);
+static int64_t mapDeltaOutIn(const Operation *ops, size_t n, int64_t pos);
+static void hybridCompact(MAGIC m);
+static void hybridAdopt(MAGIC m, int wait);
+static void *compactionWorker(void *arg);
+static void collectOperations(const INode *node, int wide, Operation *ops);
+static Operation *collectLog(MAGIC m);
+static SegTable *currentTable(MAGIC m, int *owned);
+static SegTable *fullTable(MAGIC m, int *owned);
+static MAGIC adoptTable(SegTable *t, size_t version);
+static size_t ceilLog2(size_t n);
+static int deltaFitsKernel(MAGIC m, const SegTable *t, enum MAGICDirection direction, int maxPos);
+static void mapSortedBatch(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n);
+static void mapParallel(MAGIC m, Pool *pool, unsigned int nbThreads, enum MAGICDirection direction,
+                        const int *in, int *out, size_t n);
+static void mapParallelChunk(void *context, size_t chunk, unsigned int worker);
+static int64_t mapPosition(MAGIC m, enum MAGICDirection direction, int64_t pos);
+static int compactEngine(enum MAGICEngine engine);
+static MAGIC initInstance(enum MAGICEngine engine, const MAGICmemory *memory, ArenaPool *pool);
+static size_t instanceBytes(MAGIC m);
+static int migrateInstance(MAGIC m, enum MAGICEngine engine);
+static int spillInstance(MAGICRegistry r, MAGIC m);
+static void observeCall(MAGIC m, int update);
+static uint64_t workloadCost(MAGIC m, enum MAGICEngine engine, size_t n);
+static void adaptEngine(MAGIC m);
+#ifdef MAGIC_STATS
+static uint64_t clockNanoseconds(void);
+static void recordLatency(uint64_t *histogram, uint64_t nanoseconds);
+#endif
 
 /* Implementation of API */
 
 MAGIC MAGICinit() {
-    MAGIC m = malloc(sizeof(struct magic));
-    if (m == NULL) {
-        printf("MAGICinit: Allocation error\n");
-        return NULL;
-    }
+    return MAGICinitEngine(MAGIC_ENGINE_RBTREE);
+}
 
-    m->root = NULL;
-    m->size = 0;
+MAGIC MAGICinitEngine(enum MAGICEngine engine) {
+    return MAGICinitWithMemory(engine, NULL);
+}
+
+MAGIC MAGICinitWithMemory(enum MAGICEngine engine, const MAGICmemory *memory) {
+    return initInstance(engine, memory, NULL);
+}
+
+MAGIC MAGICinitBounded(int64_t streamLength) {
+    MAGIC m = MAGICinitEngine(MAGIC_ENGINE_SUCCINCT);
+    if (m != NULL && streamLength >= 0)
+        m->bound = streamLength;
+    return m;
+}
 
+MAGIC MAGICinitWithPolicy(const MAGICpolicy *policy) {
+    if (policy == NULL)
+        return MAGICinit();
+
+    MAGIC m = MAGICinitEngine(policy->engine);
+    if (m != NULL && policy->adaptive) {
+        m->adaptive = 1;
+        m->window = (policy->window > 0) ? policy->window : DEFAULT_ADAPT_WINDOW;
+    }
     return m;
 }
 
+enum MAGICEngine MAGICengine(MAGIC m) {
+    return (m == NULL) ? MAGIC_ENGINE_RBTREE : m->engine;
+}
+
+MAGIC MAGICopenMapped(const char *path) {
+    size_t version;
+    SegTable *t = segTableOpenMapped(path, &version);
+    if (t == NULL)
+        return NULL;
+
+    return adoptTable(t, version);
+}
+
+int MAGICsave(MAGIC m, const char *path) {
+    if (m == NULL || path == NULL)
+        return 0;
+
+    int owned;
+    SegTable *t = fullTable(m, &owned);
+    if (t == NULL)
+        return 0;
+
+    int saved = segTableSave(t, m->size, path, 1);
+
+    if (owned)
+        segTableDestroy(t);
+    return saved;
+}
+
+MAGIC MAGICcompose(MAGIC a, MAGIC b) {
+    if (a == NULL || b == NULL)
+        return NULL;
+
+    int ownedA, ownedB;
+    SegTable *tableA = fullTable(a, &ownedA);
+    SegTable *tableB = fullTable(b, &ownedB);
+    SegTable *t = (tableA == NULL || tableB == NULL) ? NULL : segTableCompose(tableA, tableB);
+
+    if (ownedA)
+        segTableDestroy(tableA);
+    if (ownedB)
+        segTableDestroy(tableB);
+    if (t == NULL)
+        return NULL;
+
+    return adoptTable(t, a->size + b->size);
+}
+
+MAGIC MAGICinvert(MAGIC m) {
+    if (m == NULL)
+        return NULL;
+
+    int owned;
+    SegTable *table = fullTable(m, &owned);
+    SegTable *t = (table == NULL) ? NULL : segTableInvert(table);
+
+    if (owned)
+        segTableDestroy(table);
+    if (t == NULL)
+        return NULL;
+
+    return adoptTable(t, m->size);
+}
+
 void MAGICadd(MAGIC m, int pos, int length) {
-    if (m == NULL || length <= 0 || pos < 0)
+    MAGICadd64(m, pos, length);
+}
+
+void MAGICremove(MAGIC m, int pos, int length) {
+    MAGICremove64(m, pos, length);
+}
+
+int MAGICmap(MAGIC m, enum MAGICDirection direction, int pos) {
+    int64_t mapped = MAGICmap64(m, direction, pos);
+
+    // Positions past INT_MAX are only reachable through MAGICmap64
+    return (mapped > INT_MAX) ? -1 : (int)mapped;
+}
+
+void MAGICadd64(MAGIC m, int64_t pos, int64_t length) {
+    if (m == NULL || !validOperation(pos, length))
         return;
-    // create a new operation node (ADD)
-    INode *newNode = createNode(pos, pos + length, ADD, m->size);
-    if (newNode == NULL)
+
+    // record a new operation (ADD)
+    STATS_START(start);
+    recordOperation(m, pos, length, ADD);
+    if (m->adaptive)
+        observeCall(m, 1);
+    STATS_LATENCY(m, updateLatency, start);
+}
+
+void MAGICremove64(MAGIC m, int64_t pos, int64_t length) {
+    if (m == NULL || !validOperation(pos, length))
         return;
 
-    rbInsert(m, newNode);
+    // record a new operation (REMOVE)
+    STATS_START(start);
+    recordOperation(m, pos, length, REMOVE);
+    if (m->adaptive)
+        observeCall(m, 1);
+    STATS_LATENCY(m, updateLatency, start);
 }
 
-void MAGICremove(MAGIC m, int pos, int length) {
-    if (m == NULL || length <= 0 || pos < 0)
+void MAGICapplyBatch(MAGIC m, const MAGICop *ops, size_t n) {
+    if (m == NULL || ops == NULL || n == 0)
         return;
 
-    // create a new operation node (REMOVE)
-    INode *newNode = createNode(pos, pos + length, REMOVE, m->size);
-    if (newNode == NULL)
+    // A batch longer than the log: rebuild the tree once
+    if (m->engine == MAGIC_ENGINE_RBTREE && m->readers == NULL && m->journal == NULL &&
+        !m->coalesce && n >= m->size && bulkLoad(m, ops, n))
         return;
 
-    rbInsert(m, newNode);
+    for (size_t i = 0; i < n; i++) {
+        if (ops[i].remove) {
+            MAGICremove64(m, ops[i].pos, ops[i].length);
+        } else {
+            MAGICadd64(m, ops[i].pos, ops[i].length);
+        }
+    }
 }
 
-int MAGICmap(MAGIC m, enum MAGICDirection direction, int pos) {
+int64_t MAGICmap64(MAGIC m, enum MAGICDirection direction, int64_t pos) {
     if (m == NULL || pos < 0)
         return -1;
-    
-    if (m->root == NULL) 
-        return pos; // No operations, mapping is identity
-    
-    // Choose mapping function based on direction
+
+    STATS_START(start);
+    if (m->adaptive)
+        observeCall(m, 0);
+    int64_t mapped = mapPosition(m, direction, pos);
+    STATS_COUNT(m, maps);
+    STATS_LATENCY(m, mapLatency, start);
+
+    return mapped;
+}
+
+void MAGICmapBatch(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n) {
+    if (in == NULL || out == NULL || n == 0)
+        return;
+
+    // Small batches do not amortize a sweep
+    if (m == NULL || n < BATCH_MIN_SWEEP) {
+        for (size_t i = 0; i < n; i++)
+            out[i] = MAGICmap(m, direction, in[i]);
+        return;
+    }
+
+    if (batchIsSorted(in, n)) {
+        mapSortedBatch(m, direction, in, out, n);
+        return;
+    }
+
+    // Sort the queries, sweep, then scatter the results back in query order
+    int *sorted = malloc(n * sizeof(int));
+    size_t *order = malloc(n * sizeof(size_t));
+    if (sorted == NULL || order == NULL || !batchSort(in, n, sorted, order)) {
+        free(sorted);
+        free(order);
+        for (size_t i = 0; i < n; i++)
+            out[i] = MAGICmap(m, direction, in[i]);
+        return;
+    }
+
+    mapSortedBatch(m, direction, sorted, sorted, n);
+    for (size_t i = 0; i < n; i++)
+        out[order[i]] = sorted[i];
+
+    free(sorted);
+    free(order);
+}
+
+void MAGICmapBatchParallel(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n,
+                           unsigned int nbThreads) {
+    mapParallel(m, NULL, nbThreads, direction, in, out, n);
+}
+
+MAGICWorkers MAGICworkersCreate(unsigned int nbThreads) {
+    MAGICWorkers w = malloc(sizeof(struct magicWorkers));
+    if (w == NULL) {
+        printf("MAGICworkersCreate: Allocation error\n");
+        return NULL;
+    }
+
+    w->pool = poolCreate(nbThreads);
+    if (w->pool == NULL) {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void MAGICmapBatchWorkers(MAGIC m, MAGICWorkers w, enum MAGICDirection direction, const int *in, int *out,
+                          size_t n) {
+    Pool *pool = (w == NULL) ? NULL : w->pool;
+    mapParallel(m, pool, poolWorkers(pool), direction, in, out, n);
+}
+
+void MAGICworkersDestroy(MAGICWorkers w) {
+    if (w == NULL)
+        return;
+
+    poolDestroy(w->pool);
+    free(w);
+}
+
+size_t MAGICmapRange(MAGIC m, enum MAGICDirection direction, int64_t pos, int64_t length,
+                     MAGICrun *runs, size_t maxRuns) {
+    if (m == NULL || pos < 0 || length <= 0 || length > MAX_POSITION || pos > MAX_POSITION - length)
+        return 0;
+
+    RunList list = {runs, (runs == NULL) ? 0 : maxRuns, 0, {0, 0, 0}};
+
+    if (m->engine == MAGIC_ENGINE_ROPE) {
+        ropeMapRange(m->rope, direction, pos, length, &list);
+        return list.count;
+    }
+
+    int owned;
+    SegTable *t = fullTable(m, &owned);
+    if (t == NULL)
+        return 0;
+
+    segTableMapRange(t, direction, pos, length, &list);
+
+    if (owned)
+        segTableDestroy(t);
+    return list.count;
+}
+
+size_t MAGICversion(MAGIC m) {
+    return (m == NULL) ? 0 : m->size;
+}
+
+int64_t MAGICmapAt(MAGIC m, size_t version, enum MAGICDirection direction, int64_t pos) {
+    if (m == NULL || pos < 0)
+        return -1;
+
+    m->used = 1;
+    if (version >= m->size)
+        return MAGICmap64(m, direction, pos);
+
+    // The interval tree skips operations past the version by sequence number
+    if (m->engine == MAGIC_ENGINE_RBTREE || m->engine == MAGIC_ENGINE_HYBRID)
+        return mapTree(m, direction, pos, version);
+
+    if (m->engine == MAGIC_ENGINE_FLAT)
+        return opLogMapAt(m->log, version, direction, pos);
+
+    if (!MAGICversionAvailable(m, version))
+        return MAGIC_VERSION_UNAVAILABLE;
+    if (version == 0)
+        return pos;
+
+    // Compact engines: the table then the first pending operations, or the savepoint table
+    size_t base = m->size - m->nbPending;
+    if (version < base)
+        return segTableMap(m->saved, direction, pos);
     if (direction == STREAM_IN_OUT) {
-        return mapInOut(m->root, pos);
-    } else { // STREAM_OUT_IN
-        return mapOutIn(m->root, pos);
+        int64_t mid = segTableMap(m->table, STREAM_IN_OUT, pos);
+        return (mid < 0) ? -1 : mapDeltaInOut(m->pending, version - base, mid);
+    } else {
+        int64_t mid = mapDeltaOutIn(m->pending, version - base, pos);
+        return (mid < 0) ? -1 : segTableMap(m->table, STREAM_OUT_IN, mid);
     }
 }
 
-void MAGICdestroy(MAGIC m) {
-    if (m == NULL) {
+int MAGICversionAvailable(MAGIC m, size_t version) {
+    if (m == NULL)
+        return 0;
+    if (version == 0 || version >= m->size)
+        return 1;
+
+    if (m->engine == MAGIC_ENGINE_ROPE)
+        return 0;
+    if (compactEngine(m->engine)) {
+        // Versions since the last fold, and the version of the last savepoint
+        return version >= m->size - m->nbPending ||
+               (m->saved != NULL && version == m->savedVersion);
+    }
+    return 1;
+}
+
+MAGICSnapshot MAGICsnapshot(MAGIC m) {
+    if (m == NULL)
+        return NULL;
+
+    MAGICSnapshot s = malloc(sizeof(struct magicSnapshot));
+    if (s == NULL) {
+        printf("MAGICsnapshot: Allocation error\n");
+        return NULL;
+    }
+
+    s->m = m;
+    s->version = m->size;
+    m->lastOpen = 0;  // the version is held: its last operation is no longer merged
+    s->table = NULL;
+    s->delta = NULL;
+    s->nbDelta = 0;
+    s->holds = 0;
+
+    if (compactEngine(m->engine)) {
+        if (m->nbPending > 0 && !compactFold(m)) {
+            free(s);
+            return NULL;
+        }
+        s->table = segTableRetain(m->table);
+    } else if (m->engine == MAGIC_ENGINE_HYBRID) {
+        // Share the base table, copy the (short) delta
+        hybridAdopt(m, 0);
+        if (m->nbPending > 0) {
+            s->delta = malloc(m->nbPending * sizeof(Operation));
+            if (s->delta == NULL) {
+                printf("MAGICsnapshot: Allocation error\n");
+                free(s);
+                return NULL;
+            }
+            memcpy(s->delta, m->pending, m->nbPending * sizeof(Operation));
+            s->nbDelta = m->nbPending;
+        }
+        s->table = segTableRetain(m->table);
+    } else if (m->engine == MAGIC_ENGINE_ROPE) {
+        // Rope nodes are modified in place: copy the pieces
+        s->table = ropeToTable(m->rope);
+        if (s->table == NULL) {
+            free(s);
+            return NULL;
+        }
+    } else if (m->size == 0) {
+        // Nothing to fold: the log may even be dropped (see migrateInstance)
+        s->table = segTableCreate();
+        if (s->table == NULL) {
+            free(s);
+            return NULL;
+        }
+    } else {
+        // The log is folded on the first mapping: it must keep the version
+        if (!holdVersion(m, m->size)) {
+            free(s);
+            return NULL;
+        }
+        s->holds = 1;
+    }
+
+    return s;
+}
+
+size_t MAGICsnapshotVersion(MAGICSnapshot s) {
+    return (s == NULL) ? 0 : s->version;
+}
+
+int64_t MAGICsnapshotMap(MAGICSnapshot s, enum MAGICDirection direction, int64_t pos) {
+    if (s == NULL || pos < 0)
+        return -1;
+
+    // Log engines: the operations up to the version never change, fold them once
+    if (s->table == NULL) {
+        Operation *ops = collectLog(s->m);
+        if (ops != NULL) {
+            s->table = segTableFromOps(ops, s->version);
+            free(ops);
+        }
+        if (s->table == NULL)
+            return MAGICmapAt(s->m, s->version, direction, pos);
+    }
+
+    if (direction == STREAM_IN_OUT) {
+        int64_t mid = segTableMap(s->table, STREAM_IN_OUT, pos);
+        return (mid < 0) ? -1 : mapDeltaInOut(s->delta, s->nbDelta, mid);
+    } else {
+        int64_t mid = mapDeltaOutIn(s->delta, s->nbDelta, pos);
+        return (mid < 0) ? -1 : segTableMap(s->table, STREAM_OUT_IN, mid);
+    }
+}
+
+void MAGICsnapshotRelease(MAGICSnapshot s) {
+    if (s == NULL)
         return;
+
+    if (s->holds)
+        unholdVersion(s->m, s->version);
+    segTableDestroy(s->table);
+    free(s->delta);
+    free(s);
+}
+
+size_t MAGICsavepoint(MAGIC m) {
+    if (m == NULL)
+        return 0;
+
+    m->lastOpen = 0;  // operations before the savepoint are no longer merged
+
+    if (compactEngine(m->engine) && (m->nbPending == 0 || compactFold(m))) {
+        segTableDestroy(m->saved);
+        m->saved = segTableRetain(m->table);
+        m->savedVersion = m->size;
     }
-    
-    // Destroy the tree
-    destroyTree(m->root);
-    
-    // Free MAGIC structure
-    free(m);
+
+    return m->size;
 }
 
+int MAGICrollback(MAGIC m, size_t savepoint) {
+    if (m == NULL || savepoint > m->size || savepoint < m->held ||
+        m->readers != NULL || m->journal != NULL)
+        return 0;
 
-/* Static Functions Implementation */
+    size_t discarded = m->size - savepoint;
+    if (discarded == 0)
+        return 1;
 
-/**
- * @brief Create a new Interval Tree node with a given range.
- *
- * @param low low value of the interval
- * @param high high value of the interval
- * @param opType operation type (1 for add, -1 for remove)
- * @param seqNumber sequence number for ordering
- * 
- * @return INode* a pointer to the new created Interval Node
- */
-static INode *createNode(int low, int high, OperationType opType, unsigned int seqNumber) {
-    if (low < 0 || high < 0 || low > high) {
-        printf("createNode: Invalid interval boundaries\n");
+    if (compactEngine(m->engine)) {
+        if (discarded <= m->nbPending) {
+            m->nbPending -= discarded;
+        } else if (m->saved != NULL && m->savedVersion == savepoint) {
+            // Back to the table kept by the savepoint
+            segTableDestroy(m->table);
+            m->table = segTableRetain(m->saved);
+            m->nbPending = 0;
+            succinctDestroy(m->index);
+            m->index = NULL;
+            m->indexFailed = 0;
+        } else {
+            return 0;
+        }
+    } else if (m->engine == MAGIC_ENGINE_FLAT) {
+        opLogTruncate(m->log, savepoint);
+    } else if (m->engine == MAGIC_ENGINE_RBTREE || m->engine == MAGIC_ENGINE_HYBRID) {
+        // The base table of the hybrid engine cannot be unfolded
+        if (m->engine == MAGIC_ENGINE_HYBRID) {
+            hybridAdopt(m, 1);
+            if (discarded > m->nbPending)
+                return 0;
+            m->nbPending -= discarded;
+        }
+        for (size_t i = 0; i < discarded; i++)
+            rbRemoveLast(m);
+    } else {
+        return 0;
+    }
+
+    m->size = savepoint;
+    m->lastOpen = 0;
+    return 1;
+}
+
+MAGICCursor MAGICcursor(MAGIC m, enum MAGICDirection direction) {
+    if (m == NULL)
+        return NULL;
+
+    MAGICCursor c = malloc(sizeof(struct magicCursor));
+    if (c == NULL) {
+        printf("MAGICcursor: Allocation error\n");
         return NULL;
     }
-    
-    INode *n = malloc(sizeof(INode));
-    if (n == NULL) {
-        printf("createNode: Allocation error\n");
+
+    // Tables are immutable: the cursor shares the one of the engine when it can
+    int owned;
+    SegTable *t = fullTable(m, &owned);
+    if (t == NULL) {
+        free(c);
         return NULL;
     }
 
-    n->low = low;
-    n->high = high;
-    n->seqNumber = seqNumber;
-    n->opType = opType;
-    n->color = RED;     // New nodes are RED by default
-    n->parent = NULL;
-    n->left = NULL;
-    n->right = NULL;
-    
-    // Initialize minSubtree with the node's own low value
-    n->minSubtree = low;
-    
-    return n;
+    c->table = owned ? t : segTableRetain(t);
+    c->direction = direction;
+    c->segment = 0;
+
+    return c;
+}
+
+int64_t MAGICcursorMap(MAGICCursor c, int64_t pos) {
+    if (c == NULL || pos < 0)
+        return -1;
+
+    const SegTable *t = c->table;
+    size_t i = segTableSeek(t, c->direction, pos, c->segment);
+    if (i == t->size)
+        return -1; // before the first segment
+    c->segment = i;
+
+    const int64_t *from = (c->direction == STREAM_IN_OUT) ? t->inStart : t->outStart;
+    const int64_t *to = (c->direction == STREAM_IN_OUT) ? t->outStart : t->inStart;
+    if (pos - from[i] >= t->length[i])
+        return -1; // pos falls in a hole (removed or added bytes)
+
+    return to[i] + (pos - from[i]);
+}
+
+void MAGICcursorRelease(MAGICCursor c) {
+    if (c == NULL)
+        return;
+
+    segTableDestroy(c->table);
+    free(c);
+}
+
+int MAGICsetConcurrent(MAGIC m, size_t publishEvery) {
+    if (m == NULL)
+        return 0;
+
+    m->publishEvery = publishEvery;
+    if (m->readers != NULL)
+        return 1;
+
+    m->readers = epochCreate();
+    if (m->readers == NULL)
+        return 0;
+
+    // Readers may start as soon as the first snapshot is out
+    if (!publishSnapshot(m)) {
+        epochDestroy(m->readers);
+        m->readers = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+void MAGICpublish(MAGIC m) {
+    if (m == NULL || m->readers == NULL)
+        return;
+
+    publishSnapshot(m);
+}
+
+int64_t MAGICmapPublished(MAGIC m, enum MAGICDirection direction, int64_t pos) {
+    if (m == NULL || pos < 0)
+        return -1;
+
+    if (m->readers == NULL)
+        return MAGICmap64(m, direction, pos);
+
+    // The snapshot stays allocated until this reader exits
+    unsigned int ticket = epochEnter(m->readers);
+    MAGICSnapshot s = __atomic_load_n(&m->published, __ATOMIC_SEQ_CST);
+    int64_t mapped = MAGICsnapshotMap(s, direction, pos);
+    epochExit(m->readers, ticket);
+
+    return mapped;
+}
+
+int MAGICjournalOpen(MAGIC m, const char *path, const MAGICjournal *config) {
+    if (m == NULL || path == NULL)
+        return 0;
+
+    journalClose(m->journal);
+    m->journal = NULL;
+
+    return startJournal(m, path, config);
+}
+
+int MAGICjournalSync(MAGIC m) {
+    if (m == NULL || m->journal == NULL)
+        return 0;
+
+    // Only a checkpoint brings a journal missing operations up to date
+    if (m->journalBehind)
+        return MAGICcheckpoint(m);
+    return journalSync(m->journal);
+}
+
+int MAGICcheckpoint(MAGIC m) {
+    if (m == NULL || m->journal == NULL)
+        return 0;
+
+    // The old journal is replaced once the checkpoint is on disk: a crash in between
+    // replays the old journal past the checkpoint version
+    Journal *old = m->journal;
+    MAGICjournal config = m->durability;
+    if (!startJournal(m, journalPath(old), &config)) {
+        // The old file may have been replaced: it no longer takes operations
+        m->journal = old;
+        m->journalBehind = 1;
+        return 0;
+    }
+
+    journalClose(old);
+    return 1;
+}
+
+MAGIC MAGICrecover(const char *path, const MAGICjournal *config) {
+    if (path == NULL)
+        return NULL;
+
+    char *ckpt = checkpointPath(path);
+    if (ckpt == NULL)
+        return NULL;
+    MAGIC m = MAGICopenMapped(ckpt);
+    free(ckpt);
+    if (m == NULL)
+        return NULL;
+
+    // A missing or unreadable journal leaves the checkpoint alone
+    size_t base = 0, n = 0;
+    Operation *ops = NULL;
+    if (journalLoad(path, &base, &ops, &n) && base > m->size) {
+        printf("MAGICrecover: %s is newer than its checkpoint\n", path);
+        free(ops);
+        MAGICdestroy(m);
+        return NULL;
+    }
+
+    // Replay the tail past the checkpoint (the journal may start before it)
+    for (size_t i = m->size - base; i < n; i++)
+        recordOperation(m, ops[i].pos, ops[i].length, ops[i].opType);
+    free(ops);
+
+    if (!startJournal(m, path, config)) {
+        MAGICdestroy(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+void MAGICsetCompaction(MAGIC m, const MAGICcompaction *config) {
+    if (m == NULL || config == NULL)
+        return;
+
+    // A running compaction was started under the previous policy
+    hybridAdopt(m, 1);
+
+    m->compaction = *config;
+    if (m->compaction.maxDelta == 0)
+        m->compaction.maxDelta = DEFAULT_MAX_DELTA;
+}
+
+void MAGICsetCoalescing(MAGIC m, int enabled) {
+    if (m == NULL)
+        return;
+
+    m->coalesce = enabled;
+    m->lastOpen = 0;
+}
+
+void MAGICstats(MAGIC m, MAGICstatistics *out) {
+    if (out == NULL)
+        return;
+
+    memset(out, 0, sizeof(MAGICstatistics));
+    if (m == NULL)
+        return;
+
+#ifdef MAGIC_STATS
+    *out = m->stats;
+    out->enabled = 1;
+#endif
+
+    out->height = treeHeight(m->root);
+
+    out->bytesAllocated = instanceBytes(m);
+}
+
+void MAGICstatsReset(MAGIC m) {
+    if (m == NULL)
+        return;
+
+#ifdef MAGIC_STATS
+    memset(&m->stats, 0, sizeof(MAGICstatistics));
+#endif
+}
+
+MAGICRegistry MAGICregistryCreate(const char *spillDirectory) {
+    MAGICRegistry r = malloc(sizeof(struct magicRegistry));
+    if (r == NULL) {
+        printf("MAGICregistryCreate: Allocation error\n");
+        return NULL;
+    }
+
+    r->pool = arenaPoolCreate(REGISTRY_CHUNK_BYTES);
+    r->spillDirectory = NULL;
+    if (spillDirectory != NULL) {
+        r->spillDirectory = malloc(strlen(spillDirectory) + 1);
+        if (r->spillDirectory != NULL)
+            strcpy(r->spillDirectory, spillDirectory);
+    }
+    if (r->pool == NULL || (spillDirectory != NULL && r->spillDirectory == NULL)) {
+        printf("MAGICregistryCreate: Allocation error\n");
+        arenaPoolDestroy(r->pool);
+        free(r->spillDirectory);
+        free(r);
+        return NULL;
+    }
+
+    pthread_mutex_init(&r->lock, NULL);
+    r->spills = 0;
+    r->instances = NULL;
+    r->nbInstances = 0;
+    r->capInstances = 0;
+
+    return r;
+}
+
+MAGIC MAGICregistryInit(MAGICRegistry r, enum MAGICEngine engine) {
+    if (r == NULL)
+        return NULL;
+
+    MAGIC m = initInstance(engine, NULL, r->pool);
+    if (m == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&r->lock);
+    if (r->nbInstances == r->capInstances) {
+        size_t capacity = (r->capInstances == 0) ? 64 : 2 * r->capInstances;
+        MAGIC *grown = realloc(r->instances, capacity * sizeof(MAGIC));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&r->lock);
+            printf("MAGICregistryInit: Allocation error\n");
+            MAGICdestroy(m);
+            return NULL;
+        }
+        r->instances = grown;
+        r->capInstances = capacity;
+    }
+    m->registry = r;
+    m->registryIndex = r->nbInstances;
+    r->instances[r->nbInstances++] = m;
+    pthread_mutex_unlock(&r->lock);
+
+    return m;
+}
+
+size_t MAGICregistryTrim(MAGICRegistry r) {
+    if (r == NULL)
+        return 0;
+
+    size_t trimmed = 0;
+    pthread_mutex_lock(&r->lock);
+
+    // Second chance: an instance used since the previous trim is only marked idle
+    for (size_t i = 0; i < r->nbInstances; i++) {
+        MAGIC m = r->instances[i];
+        if (m->used) {
+            m->used = 0;
+        } else if (!compactEngine(m->engine)) {
+            trimmed += migrateInstance(m, MAGIC_ENGINE_COMPACT);
+        } else if (r->spillDirectory != NULL) {
+            trimmed += spillInstance(r, m);
+        }
+    }
+
+    pthread_mutex_unlock(&r->lock);
+
+    arenaPoolRelease(r->pool);
+    return trimmed;
+}
+
+size_t MAGICregistryBytes(MAGICRegistry r) {
+    if (r == NULL)
+        return 0;
+
+    pthread_mutex_lock(&r->lock);
+    size_t bytes = sizeof(struct magicRegistry) + r->capInstances * sizeof(MAGIC);
+    for (size_t i = 0; i < r->nbInstances; i++)
+        bytes += instanceBytes(r->instances[i]);
+    pthread_mutex_unlock(&r->lock);
+
+    return bytes + arenaPoolBytes(r->pool);
+}
+
+void MAGICregistryDestroy(MAGICRegistry r) {
+    if (r == NULL)
+        return;
+
+    // Instances unregister themselves from the end of the array
+    while (r->nbInstances > 0)
+        MAGICdestroy(r->instances[r->nbInstances - 1]);
+
+    pthread_mutex_destroy(&r->lock);
+    arenaPoolDestroy(r->pool);
+    free(r->spillDirectory);
+    free(r->instances);
+    free(r);
+}
+
+void MAGICdestroy(MAGIC m) {
+    if (m == NULL) {
+        return;
+    }
+
+    // Leave the registry: the last instance takes the place of this one
+    MAGICRegistry r = m->registry;
+    if (r != NULL) {
+        pthread_mutex_lock(&r->lock);
+        MAGIC moved = r->instances[--r->nbInstances];
+        r->instances[m->registryIndex] = moved;
+        moved->registryIndex = m->registryIndex;
+        pthread_mutex_unlock(&r->lock);
+    }
+
+    // Wait for a background compaction still reading the table
+    hybridAdopt(m, 1);
+
+    journalClose(m->journal);
+
+    // Release the published snapshots (no reader may be left)
+    epochDestroy(m->readers);
+    MAGICsnapshotRelease(m->published);
+    
+    // Destroy the tree: its nodes are released with their chunks
+    arenaDestroy(m->nodes);
+
+    // Destroy the compacted table and its pending operations
+    segTableDestroy(m->table);
+    segTableDestroy(m->saved);
+    free(m->pending);
+
+    // Destroy the flat log, the index and the rope (its nodes went with the arena)
+    opLogDestroy(m->log);
+    succinctDestroy(m->index);
+    ropeDestroy(m->rope);
+
+    // Versions held by snapshots, all released by now
+    free(m->heldVersions);
+    
+    // Free MAGIC structure
+    free(m);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Create a new Interval Tree node with a given range.
+ *
+ * @param nodes arena holding the nodes
+ * @param wide 1 for a node with 64-bit boundaries (WNode)
+ * @param low low value of the interval
+ * @param high high value of the interval
+ * @param opType operation type (1 for add, -1 for remove)
+ * @param seqNumber sequence number for ordering
+ * 
+ * @return INode* a pointer to the new created Interval Node
+ */
+static INode *createNode(Arena *nodes, int wide, int64_t low, int64_t high, OperationType opType, unsigned int seqNumber) {
+    if (low < 0 || high < 0 || low > high) {
+        printf("createNode: Invalid interval boundaries\n");
+        return NULL;
+    }
+    
+    INode *n = arenaAlloc(nodes);
+    if (n == NULL) {
+        printf("createNode: Allocation error\n");
+        return NULL;
+    }
+
+    if (wide) {
+        WIDE(n)->low = low;
+        WIDE(n)->high = high;
+        WIDE(n)->minSubtree = low;
+    } else {
+        n->low = (unsigned int)low;
+        n->high = (unsigned int)high;
+    }
+    n->seqNumber = seqNumber;
+    n->leftLink = (uintptr_t)RED;      // no children, New nodes are RED by default
+    n->rightLink = (uintptr_t)opType;
+    
+    // Initialize minSubtree with the node's own low value
+    n->minSubtree = (unsigned int)low;
+    
+    return n;
+}
+
+/**
+ * @brief Update the minSubtree value for a node based on its low value and children
+ *
+ * @param node Node to update
+ * @param wide 1 if the nodes have 64-bit boundaries (WNode)
+ */
+static void updateMinSubtree(INode *node, int wide) {
+    if (node == NULL) return;
+
+    if (wide) {
+        WNode *w = WIDE(node);
+        w->minSubtree = w->low;
+        if (LEFT(node) != NULL && WIDE(LEFT(node))->minSubtree < w->minSubtree)
+            w->minSubtree = WIDE(LEFT(node))->minSubtree;
+        if (RIGHT(node) != NULL && WIDE(RIGHT(node))->minSubtree < w->minSubtree)
+            w->minSubtree = WIDE(RIGHT(node))->minSubtree;
+        return;
+    }
+    
+    // Ensure default value
+    node->minSubtree = node->low;
+    
+    // See left child's minimum low value
+    if (LEFT(node) != NULL && LEFT(node)->minSubtree < node->minSubtree) {
+        node->minSubtree = LEFT(node)->minSubtree;
+    }
+    
+    // See right child's minimum low value
+    if (RIGHT(node) != NULL && RIGHT(node)->minSubtree < node->minSubtree) {
+        node->minSubtree = RIGHT(node)->minSubtree;
+    }
+}
+
+/**
+ * @brief Performs a left rotation at a given node
+ * The subtree keeps its nodes: only x and its right child get a new minSubtree
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param x The node to rotate around
+ * @param parent Parent of x (NULL for the root)
+ */
+static void leftRotate(MAGIC m, INode *x, INode *parent) {
+    if (m == NULL || x == NULL || RIGHT(x) == NULL) {
+        return;
+    }
+    
+    INode *y = RIGHT(x); // get right child
+    
+    // Turn y's left subtree into x's right subtree
+    SET_RIGHT(x, LEFT(y));
+    
+    // Link x's parent to y
+    if (parent == NULL) {
+        m->root = y;
+    } else if (x == LEFT(parent)) {
+        SET_LEFT(parent, y);
+    } else {
+        SET_RIGHT(parent, y);
+    }
+    
+    // x on y's left
+    SET_LEFT(y, x);
+    STATS_COUNT(m, rotations);
+    
+    // Update minSubtree values after rotation
+    updateMinSubtree(x, m->wide);
+    updateMinSubtree(y, m->wide);
+}
+
+/**
+ * @brief Performs a right rotation at a given node
+ * The subtree keeps its nodes: only y and its left child get a new minSubtree
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param y The node to rotate around
+ * @param parent Parent of y (NULL for the root)
+ */
+static void rightRotate(MAGIC m, INode *y, INode *parent) {
+    if (m == NULL || y == NULL || LEFT(y) == NULL) {
+        return;
+    }
+    
+    INode *x = LEFT(y);  // get left child
+    
+    // Turn x's right subtree into y's left subtree
+    SET_LEFT(y, RIGHT(x));
+    
+    // Link y's parent to x
+    if (parent == NULL) {
+        m->root = x;
+    } else if (y == LEFT(parent)) {
+        SET_LEFT(parent, x);
+    } else {
+        SET_RIGHT(parent, x);
+    }
+    
+    // y on x's right
+    SET_RIGHT(x, y);
+    STATS_COUNT(m, rotations);
+    
+    // Update minSubtree values after rotation
+    updateMinSubtree(y, m->wide);
+    updateMinSubtree(x, m->wide);
+}
+
+/**
+ * @brief Performs rotations and recoloring to maintain red-black properties after inserting a new node
+ * The new node ends the right spine: its parent is a right child, and it is the
+ * right child of its parent, so only the symmetric cases 1 and 3 arise
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param spine Right spine of the tree, from the root to the new node
+ * @param depth Number of nodes of the spine
+ */
+static void rbInsertFixup(MAGIC m, INode **spine, size_t depth) {
+    if (m == NULL || depth == 0) return;
+
+    // The root is black: a red parent has a grandparent
+    size_t i = depth - 1;
+    while (i >= 2 && COLOR(spine[i - 1]) == RED) {
+        INode *parent = spine[i - 1];
+        INode *grandparent = spine[i - 2];
+        INode *uncle = LEFT(grandparent);
+
+        if (uncle != NULL && COLOR(uncle) == RED) {
+            // Case 1: Uncle is RED -> Recolor
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(uncle, BLACK);
+            SET_COLOR(grandparent, RED);
+            i -= 2; // Move up to grandparent
+        } else {
+            // Case 3: Recolor and left-rotate grandparent
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(grandparent, RED);
+            leftRotate(m, grandparent, (i >= 3) ? spine[i - 3] : NULL);
+            break;
+        }
+    }
+    // Ensure root is always black
+    if (m->root != NULL) {
+        SET_COLOR(m->root, BLACK);
+    }
+}
+
+/**
+ * @brief Insert a node into the tree (ordered by sequence number)
+ * Its sequence number is the largest: it becomes the end of the right spine
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param newNode The new node
+ */
+static void rbInsert(MAGIC m, INode *newNode) {
+    if (m == NULL || newNode == NULL) return;
+
+    INode *spine[MAX_SPINE + 1];
+    size_t depth = rightSpine(m, spine);
+
+    // Insert node
+    if (depth == 0) {
+        // Tree is empty
+        m->root = newNode;
+    } else {
+        SET_RIGHT(spine[depth - 1], newNode);
+    }
+    spine[depth++] = newNode;
+    
+    // Fix Red-Black properties
+    rbInsertFixup(m, spine, depth);
+
+    // Update minSubtree on the whole insertion path, pruning relies on every ancestor
+    updateSpine(m);
+    
+    m->size++;
+    STATS_COUNT(m, inserts);
+}
+
+/**
+ * @brief Remove the last operation (rightmost node) from the tree
+ * Its node is given back to the arena
+ *
+ * @param m Pointer to the MAGIC instance
+ */
+static void rbRemoveLast(MAGIC m) {
+    INode *spine[MAX_SPINE];
+    size_t depth = rightSpine(m, spine);
+    if (depth == 0)
+        return;
+
+    // The rightmost node has at most a left child, which is then red
+    INode *z = spine[--depth];
+    INode *x = LEFT(z);
+    if (depth == 0) {
+        m->root = x;
+    } else {
+        SET_RIGHT(spine[depth - 1], x);
+    }
+
+    if (COLOR(z) == BLACK) {
+        if (x != NULL) {
+            SET_COLOR(x, BLACK);
+        } else {
+            rbRemoveFixup(m, spine, depth);
+        }
+    }
+
+    // The ancestors of the removed node are the new right spine
+    updateSpine(m);
+
+    arenaFreeLast(m->nodes, z);
+}
+
+/**
+ * @brief Restore the red-black properties after removing a black node
+ * The node missing a black is the (empty) right child of the end of the spine;
+ * moving up, it stays a right child: only the symmetric cases arise
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param spine Right spine of the tree, down to the parent of the removed node
+ * @param depth Number of nodes of the spine
+ */
+static void rbRemoveFixup(MAGIC m, INode **spine, size_t depth) {
+    INode *x = NULL;
+
+    // x is the root once the whole spine is climbed
+    while (depth > 0 && (x == NULL || COLOR(x) == BLACK)) {
+        INode *parent = spine[depth - 1];
+        INode *grandparent = (depth >= 2) ? spine[depth - 2] : NULL;
+        INode *w = LEFT(parent);
+        if (COLOR(w) == RED) {
+            // Case 1: red sibling -> rotate it above parent
+            SET_COLOR(w, BLACK);
+            SET_COLOR(parent, RED);
+            rightRotate(m, parent, grandparent);
+            grandparent = w;
+            w = LEFT(parent);
+        }
+        if ((LEFT(w) == NULL || COLOR(LEFT(w)) == BLACK) && (RIGHT(w) == NULL || COLOR(RIGHT(w)) == BLACK)) {
+            // Case 2: black nephews -> move the missing black up (parent is red after case 1)
+            SET_COLOR(w, RED);
+            x = parent;
+            depth--;
+        } else {
+            if (LEFT(w) == NULL || COLOR(LEFT(w)) == BLACK) {
+                // Case 3: only the near nephew is red -> rotate it above w
+                SET_COLOR(RIGHT(w), BLACK);
+                SET_COLOR(w, RED);
+                leftRotate(m, w, parent);
+                w = LEFT(parent);
+            }
+            // Case 4: far nephew is red -> rotate w above parent
+            SET_COLOR(w, COLOR(parent));
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(LEFT(w), BLACK);
+            rightRotate(m, parent, grandparent);
+            x = m->root;
+            break;
+        }
+    }
+
+    if (x != NULL)
+        SET_COLOR(x, BLACK);
+}
+
+/**
+ * @brief Collect the right spine of the tree (the nodes of the last operations)
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param spine Output: nodes from the root to the rightmost one (MAX_SPINE at most)
+ * @return Number of nodes of the spine
+ */
+static size_t rightSpine(MAGIC m, INode **spine) {
+    size_t depth = 0;
+    for (INode *node = m->root; node != NULL; node = RIGHT(node))
+        spine[depth++] = node;
+    return depth;
+}
+
+/**
+ * @brief Update minSubtree bottom-up on the right spine
+ * Inserting or removing the last node changes the subtrees of the spine only
+ *
+ * @param m Pointer to the MAGIC instance
+ */
+static void updateSpine(MAGIC m) {
+    INode *spine[MAX_SPINE];
+    size_t depth = rightSpine(m, spine);
+    while (depth > 0)
+        updateMinSubtree(spine[--depth], m->wide);
+}
+
+/**
+ * @brief Map a position through the operations of the tree older than a limit
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param direction Mapping direction
+ * @param pos Position to map
+ * @param limit Number of operations applied (the version)
+ * @return Mapped position or -1 if invalid
+ */
+static int64_t mapTree(MAGIC m, enum MAGICDirection direction, int64_t pos, size_t limit) {
+    if (m->root == NULL) 
+        return pos; // No operations, mapping is identity
+
+#ifdef MAGIC_STATS
+    traversalStats = &m->stats;
+#endif
+    
+    // Wide instances traverse the 64-bit boundaries
+    if (m->wide) {
+        return (direction == STREAM_IN_OUT) ? mapInOutWide(m->root, pos, limit)
+                                            : mapOutInWide(m->root, pos, limit);
+    }
+
+    // Choose mapping function based on direction
+    if (direction == STREAM_IN_OUT) {
+        return mapInOut(m->root, pos, limit);
+    } else { // STREAM_OUT_IN
+        return mapOutIn(m->root, pos, limit);
+    }
+}
+
+/**
+ * @brief Process operations in order to map position from input to output
+ * With pruning using minSubtree
+ * 
+ * @param node Current node in traversal
+ * @param pos Position to map
+ * @param limit Operations with a sequence number from limit on are ignored
+ * @return Mapped position or -1 if invalid (or no mapping)
+ */
+static int64_t mapInOut(INode *node, int64_t pos, size_t limit) {
+    if (node == NULL) {
+        return pos; // Base case: no more operations 
+    }
+    
+    // If position is already negative, return answer query to -1
+    if (pos == -1) {
+        return -1;
+    }
+
+    STATS_TRAVERSAL(nodesVisited);
+
+    // Node and right subtree come after the limit: only the left subtree applies
+    if (node->seqNumber >= limit) {
+        return mapInOut(LEFT(node), pos, limit);
+    }
+    
+    // Pruning: If position is less than minSubtree of left subtree, 
+    // we can skip the entire left subtree as no operations there will affect this position
+    int64_t leftResult;
+    if (LEFT(node) != NULL && pos < LEFT(node)->minSubtree) {
+        // Skip left subtree
+        STATS_TRAVERSAL(prunedLeft);
+        leftResult = pos;
+    } else {
+        // Process left subtree
+        leftResult = mapInOut(LEFT(node), pos, limit);
+    }
+    
+    // If position has been marked as invalid by the left subtree, propagate it in order to stop traversal
+    if (leftResult == -1) {
+        return -1;
+    }
+    
+    // Apply current operation
+    int64_t cumulativeResult = leftResult; // track cumulative shifts 
+    if (OP_TYPE(node) == ADD) { // Add operation
+        // If position is at or after insertion point, shift it
+        if (node->low <= cumulativeResult) {
+            cumulativeResult += (node->high - node->low);
+        }
+    } else { // Remove operation
+        // Check if position falls within removed region
+        if (node->low <= cumulativeResult && cumulativeResult < node->high) {
+            STATS_TRAVERSAL(earlyExits);
+            return -1; // Position was removed, invalid mapping
+        }
+        
+        // If position is after removal point, shift it back
+        else if (cumulativeResult >= node->high) {
+            cumulativeResult -= (node->high - node->low);
+        }
+    }
+    
+    // Pruning: If cumulativeResult is less than minSubtree of right subtree,
+    // we can skip the entire right subtree
+    if (RIGHT(node) != NULL && cumulativeResult < RIGHT(node)->minSubtree) {
+        // Skip right subtree
+        STATS_TRAVERSAL(prunedRight);
+        return cumulativeResult;
+    } else {
+        // Process right subtree
+        return mapInOut(RIGHT(node), cumulativeResult, limit);
+    }
+}
+
+/**
+ * @brief Process operations in reverse order to map position from output to input
+ * With pruning using minSubtree
+ * 
+ * @param node Current node in traversal
+ * @param pos Position to map
+ * @param limit Operations with a sequence number from limit on are ignored
+ * @return Mapped position or -1 if invalid
+ */
+static int64_t mapOutIn(INode *node, int64_t pos, size_t limit) {
+    if (node == NULL) {
+        return pos; // Base case: no more operations
+    }
+    
+    // If position is already negative, propagate the invalid state
+    if (pos == -1) {
+        return -1;
+    }
+
+    STATS_TRAVERSAL(nodesVisited);
+
+    // Node and right subtree come after the limit: only the left subtree applies
+    if (node->seqNumber >= limit) {
+        return mapOutIn(LEFT(node), pos, limit);
+    }
+    
+    // Pruning: Skip right subtree if position is less than the minSubtree of right
+    int64_t rightResult;
+    if (RIGHT(node) != NULL && pos < RIGHT(node)->minSubtree) {
+        // Skip right subtree
+        STATS_TRAVERSAL(prunedRight);
+        rightResult = pos;
+    } else {
+        // Process right subtree
+        rightResult = mapOutIn(RIGHT(node), pos, limit);
+    }
+    
+    // If position has been marked as invalid by the right subtree, propagate it to stop traversal
+    if (rightResult == -1) {
+        return -1;
+    }
+    
+    // Apply current operation (in reverse)
+    int64_t cumulativeResult = rightResult;
+    if (OP_TYPE(node) == ADD) { // Undo an add operation
+        // If position is within added range, it doesn't exist in input
+        if (node->low <= cumulativeResult && cumulativeResult < node->high) {
+            STATS_TRAVERSAL(earlyExits);
+            return -1;
+        }
+        
+        // If position is after the added range, shift backward
+        if (cumulativeResult >= node->high) {
+            cumulativeResult -= (node->high - node->low);
+        }
+    } else { // Undo a remove operation
+        // If position is at or after the start of removed section,
+        // shift forward by the length of the removed section
+        if (node->low <= cumulativeResult) {
+            cumulativeResult += (node->high - node->low);
+        }
+    }
+    
+    // Pruning: Skip left subtree if position is less than the minSubtree of left
+    if (LEFT(node) != NULL && cumulativeResult < LEFT(node)->minSubtree) {
+        // Skip left subtree
+        STATS_TRAVERSAL(prunedLeft);
+        return cumulativeResult;
+    } else {
+        // Process left subtree
+        return mapOutIn(LEFT(node), cumulativeResult, limit);
+    }
+}
+
+/**
+ * @brief mapInOut on the 64-bit boundaries of a wide instance
+ *
+ * @param node Current node in traversal
+ * @param pos Position to map
+ * @param limit Operations with a sequence number from limit on are ignored
+ * @return Mapped position or -1 if invalid (or no mapping)
+ */
+static int64_t mapInOutWide(INode *node, int64_t pos, size_t limit) {
+    if (node == NULL || pos == -1)
+        return pos;
+    STATS_TRAVERSAL(nodesVisited);
+    if (node->seqNumber >= limit)
+        return mapInOutWide(LEFT(node), pos, limit);
+
+    const WNode *w = WIDE(node);
+
+    // Left subtree (earlier operations), pruned when they all lie after pos
+    if (LEFT(node) != NULL && pos >= WIDE(LEFT(node))->minSubtree)
+        pos = mapInOutWide(LEFT(node), pos, limit);
+    else if (LEFT(node) != NULL)
+        STATS_TRAVERSAL(prunedLeft);
+    if (pos == -1)
+        return -1;
+
+    // Current operation
+    if (OP_TYPE(node) == ADD) {
+        if (w->low <= pos)
+            pos += w->high - w->low;
+    } else {
+        if (w->low <= pos && pos < w->high) {
+            STATS_TRAVERSAL(earlyExits);
+            return -1;
+        }
+        if (pos >= w->high)
+            pos -= w->high - w->low;
+    }
+
+    // Right subtree (later operations)
+    if (RIGHT(node) != NULL && pos >= WIDE(RIGHT(node))->minSubtree)
+        return mapInOutWide(RIGHT(node), pos, limit);
+    if (RIGHT(node) != NULL)
+        STATS_TRAVERSAL(prunedRight);
+    return pos;
+}
+
+/**
+ * @brief mapOutIn on the 64-bit boundaries of a wide instance
+ *
+ * @param node Current node in traversal
+ * @param pos Position to map
+ * @param limit Operations with a sequence number from limit on are ignored
+ * @return Mapped position or -1 if invalid
+ */
+static int64_t mapOutInWide(INode *node, int64_t pos, size_t limit) {
+    if (node == NULL || pos == -1)
+        return pos;
+    STATS_TRAVERSAL(nodesVisited);
+    if (node->seqNumber >= limit)
+        return mapOutInWide(LEFT(node), pos, limit);
+
+    const WNode *w = WIDE(node);
+
+    // Right subtree (later operations) is undone first
+    if (RIGHT(node) != NULL && pos >= WIDE(RIGHT(node))->minSubtree)
+        pos = mapOutInWide(RIGHT(node), pos, limit);
+    else if (RIGHT(node) != NULL)
+        STATS_TRAVERSAL(prunedRight);
+    if (pos == -1)
+        return -1;
+
+    // Current operation, in reverse
+    if (OP_TYPE(node) == ADD) {
+        if (w->low <= pos && pos < w->high) {
+            STATS_TRAVERSAL(earlyExits);
+            return -1;
+        }
+        if (pos >= w->high)
+            pos -= w->high - w->low;
+    } else {
+        if (w->low <= pos)
+            pos += w->high - w->low;
+    }
+
+    // Left subtree (earlier operations)
+    if (LEFT(node) != NULL && pos >= WIDE(LEFT(node))->minSubtree)
+        return mapOutInWide(LEFT(node), pos, limit);
+    if (LEFT(node) != NULL)
+        STATS_TRAVERSAL(prunedLeft);
+    return pos;
+}
+
+/**
+ * @brief Height of a subtree
+ *
+ * @param node Root of the subtree
+ * @return Number of nodes on the longest path from node to a leaf (0 if NULL)
+ */
+static size_t treeHeight(const INode *node) {
+    if (node == NULL)
+        return 0;
+
+    size_t left = treeHeight(LEFT(node)), right = treeHeight(RIGHT(node));
+    return 1 + ((left > right) ? left : right);
+}
+
+/**
+ * @brief Rebuild the tree with 64-bit boundaries, in O(size log size)
+ * Called once, by the first operation that does not fit in 32 bits
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return 1 on success, 0 on allocation error (the instance is left unchanged)
+ */
+static int widenTree(MAGIC m) {
+    Operation *ops = collectLog(m);
+    if (ops == NULL)
+        return 0;
+
+    Arena *nodes = (m->registry != NULL) ? arenaCreatePooled(sizeof(WNode), m->registry->pool)
+                                         : arenaCreate(sizeof(WNode), NULL, 0, m->hugePages);
+    if (nodes == NULL) {
+        free(ops);
+        return 0;
+    }
+
+    INode **wideNodes = malloc((m->size > 0 ? m->size : 1) * sizeof(INode *));
+    if (wideNodes == NULL) {
+        printf("widenTree: Allocation error\n");
+        arenaDestroy(nodes);
+        free(ops);
+        return 0;
+    }
+
+    // Copy the operations in chronological order, then link them balanced
+    for (size_t i = 0; i < m->size; i++) {
+        wideNodes[i] = createNode(nodes, 1, ops[i].pos, ops[i].pos + ops[i].length, ops[i].opType, i);
+        if (wideNodes[i] == NULL) {
+            arenaDestroy(nodes);
+            free(wideNodes);
+            free(ops);
+            return 0;
+        }
+    }
+
+    arenaDestroy(m->nodes);
+    m->nodes = nodes;
+    m->wide = 1;
+    m->root = linkBalanced(wideNodes, m->size, 1);
+
+    free(wideNodes);
+    free(ops);
+    return 1;
+}
+
+/**
+ * @brief Store the nodes of a subtree by sequence number
+ *
+ * @param node Root of the subtree
+ * @param nodes Output array, indexed by sequence number
+ */
+static void collectNodes(INode *node, INode **nodes) {
+    if (node == NULL)
+        return;
+
+    collectNodes(LEFT(node), nodes);
+    nodes[node->seqNumber] = node;
+    collectNodes(RIGHT(node), nodes);
+}
+
+/**
+ * @brief Link nodes sorted by sequence number into a red-black tree, in O(count)
+ *
+ * @param nodes Nodes in chronological order
+ * @param count Number of nodes
+ * @param wide 1 if the nodes have 64-bit boundaries (WNode)
+ * @return Root of the tree (NULL if count is 0)
+ */
+static INode *linkBalanced(INode **nodes, size_t count, int wide) {
+    // Height of the tree: every missing child is on one of the last two levels
+    size_t height = 0;
+    while (((size_t)1 << height) <= count)
+        height++;
+
+    INode *root = buildBalanced(nodes, count, 1, height, wide);
+    if (root != NULL)
+        SET_COLOR(root, BLACK);
+    return root;
+}
+
+/**
+ * @brief Link a subtree around its middle node, the deepest level red
+ * Every path from the root then has height - 1 black nodes, and minSubtree is
+ * computed bottom-up
+ *
+ * @param nodes Nodes of the subtree in chronological order
+ * @param count Number of nodes
+ * @param depth Depth of the root of the subtree (1 for the root of the tree)
+ * @param height Height of the tree
+ * @param wide 1 if the nodes have 64-bit boundaries (WNode)
+ * @return Root of the subtree (NULL if count is 0)
+ */
+static INode *buildBalanced(INode **nodes, size_t count, size_t depth, size_t height, int wide) {
+    if (count == 0)
+        return NULL;
+
+    size_t mid = count / 2;
+    INode *node = nodes[mid];
+    SET_COLOR(node, (depth == height) ? RED : BLACK);
+    SET_LEFT(node, buildBalanced(nodes, mid, depth + 1, height, wide));
+    SET_RIGHT(node, buildBalanced(nodes + mid + 1, count - mid - 1, depth + 1, height, wide));
+    updateMinSubtree(node, wide);
+
+    return node;
+}
+
+/**
+ * @brief Check the arguments of an operation
+ *
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @return 1 if the operation can be recorded, 0 otherwise
+ */
+static int validOperation(int64_t pos, int64_t length) {
+    return length > 0 && pos >= 0 && length <= MAX_POSITION && pos <= MAX_POSITION - length;
+}
+
+/**
+ * @brief Append a batch of operations to the tree and rebuild it balanced
+ *
+ * @param m Pointer to the MAGIC instance (interval tree engine)
+ * @param ops Operations in chronological order
+ * @param n Number of operations
+ * @return 1 if the batch was applied, 0 if nothing was done (allocation error, tree full)
+ */
+static int bulkLoad(MAGIC m, const MAGICop *ops, size_t n) {
+    if (n > MAX_TREE_SIZE - m->size)
+        return 0;
+
+    // The first operation past 32 bits widens the tree once for the whole batch
+    int wide = 0;
+    for (size_t i = 0; i < n; i++)
+        wide |= (validOperation(ops[i].pos, ops[i].length) && ops[i].pos + ops[i].length > UINT_MAX);
+    if (wide && !m->wide && !widenTree(m))
+        return 0;
+
+    INode **nodes = malloc((m->size + n) * sizeof(INode *));
+    if (nodes == NULL) {
+        printf("bulkLoad: Allocation error\n");
+        return 0;
+    }
+    collectNodes(m->root, nodes);
+
+    // New nodes follow the log; an allocation error keeps the operations before it
+    size_t count = m->size;
+    for (size_t i = 0; i < n; i++) {
+        if (!validOperation(ops[i].pos, ops[i].length))
+            continue;
+
+        OperationType opType = ops[i].remove ? REMOVE : ADD;
+        INode *node = createNode(m->nodes, m->wide, ops[i].pos, ops[i].pos + ops[i].length, opType, count);
+        if (node == NULL)
+            break;
+        nodes[count++] = node;
+    }
+
+#ifdef MAGIC_STATS
+    m->stats.inserts += count - m->size;
+#endif
+    m->root = linkBalanced(nodes, count, m->wide);
+    m->size = count;
+    m->lastOpen = 0;
+
+    free(nodes);
+    return 1;
+}
+
+/**
+ * @brief Record an operation, and publish it in concurrent mode
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType operation type
+ */
+static void recordOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType) {
+    m->used = 1;
+
+    // Merged with the previous operation, or both cancelled
+    Operation merged;
+    if (m->lastOpen && m->readers == NULL && m->journal == NULL &&
+        coalesceOperations(&m->last, pos, length, opType, &merged) && dropLastOperation(m)) {
+        m->lastOpen = 0;
+        if (merged.length == 0)
+            return;
+        pos = merged.pos;
+        length = merged.length;
+        opType = merged.opType;
+    }
+
+    // Engines without a pending buffer queue the operation for the next publication
+    int queued = (m->readers != NULL && !compactEngine(m->engine) && m->engine != MAGIC_ENGINE_HYBRID);
+    if (queued && !pendingAppend(m, pos, length, opType))
+        return;
+
+    if (!applyOperation(m, pos, length, opType)) {
+        if (queued)
+            m->nbPending--;
+        return;
+    }
+
+    // The rope and the hybrid delta cannot drop their last operation
+    m->last.pos = pos;
+    m->last.length = length;
+    m->last.opType = opType;
+    m->lastOpen = m->coalesce && (m->engine == MAGIC_ENGINE_RBTREE || m->engine == MAGIC_ENGINE_FLAT ||
+                                  compactEngine(m->engine));
+
+    if (m->journal != NULL)
+        journalOperation(m, pos, length, opType);
+
+    if (m->readers != NULL && m->publishEvery > 0 && ++m->sincePublish >= m->publishEvery)
+        publishSnapshot(m);
+}
+
+/**
+ * @brief Apply an operation to the structures of the engine
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType operation type
+ * @return 1 on success, 0 on allocation error
+ */
+static int applyOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType) {
+    int wide = (pos + length > UINT_MAX);
+
+    if (compactEngine(m->engine)) {
+        if (!pendingAppend(m, pos, length, opType))
+            return 0;
+        m->size++;
+        m->wide |= wide;
+        return 1;
+    }
+
+    if (m->engine == MAGIC_ENGINE_FLAT) {
+        if (!opLogAppend(m->log, pos, length, opType))
+            return 0;
+        m->size++;
+        m->wide |= wide;
+        return 1;
+    }
+
+    if (m->engine == MAGIC_ENGINE_ROPE) {
+        int recorded = (opType == ADD) ? ropeAdd(m->rope, pos, length) : ropeRemove(m->rope, pos, length);
+        if (!recorded)
+            return 0;
+        m->size++;
+        m->wide |= wide;
+        return 1;
+    }
+
+    if (m->engine == MAGIC_ENGINE_HYBRID)
+        hybridAdopt(m, 0);
+
+    if (m->size >= MAX_TREE_SIZE) {
+        printf("applyOperation: Too many operations (at most 2^32 - 1 in an interval tree)\n");
+        return 0;
+    }
+
+    // the first operation past 32 bits widens the nodes of the tree
+    if (wide && !m->wide && !widenTree(m))
+        return 0;
+
+    // keep the delta in sync with the log
+    if (m->engine == MAGIC_ENGINE_HYBRID && !pendingAppend(m, pos, length, opType))
+        return 0;
+
+    // create a new operation node
+    INode *newNode = createNode(m->nodes, m->wide, pos, pos + length, opType, m->size);
+    if (newNode == NULL) {
+        if (m->engine == MAGIC_ENGINE_HYBRID)
+            m->nbPending--;
+        return 0;
+    }
+
+    rbInsert(m, newNode);
+
+    if (m->engine == MAGIC_ENGINE_HYBRID) {
+        size_t deltaBytes = m->capPending * sizeof(Operation);
+        if (m->nbPending >= m->compaction.maxDelta ||
+            (m->compaction.maxDeltaBytes > 0 && deltaBytes >= m->compaction.maxDeltaBytes)) {
+            hybridCompact(m);
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Merge an operation with the one recorded just before it
+ * Consecutive adds extending the added bytes, consecutive removes of adjacent
+ * bytes, and removes covering added bytes (or covered by them) are merged
+ *
+ * @param last Previous operation
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType operation type
+ * @param merged Output: single operation equivalent to both (length 0 if they cancel)
+ * @return 1 if the operations were merged, 0 otherwise
+ */
+static int coalesceOperations(const Operation *last, int64_t pos, int64_t length, OperationType opType, Operation *merged) {
+    int64_t lastHigh = last->pos + last->length;
+
+    if (last->opType == ADD && opType == ADD && last->pos <= pos && pos <= lastHigh) {
+        // Bytes added inside or right after the added bytes
+        merged->pos = last->pos;
+        merged->length = last->length + length;
+        merged->opType = ADD;
+    } else if (last->opType == REMOVE && opType == REMOVE && pos <= last->pos && last->pos <= pos + length) {
+        // Removed bytes adjacent to the removed ones, on either side
+        merged->pos = pos;
+        merged->length = last->length + length;
+        merged->opType = REMOVE;
+    } else if (last->opType == ADD && opType == REMOVE && last->pos <= pos && pos + length <= lastHigh) {
+        // Part of the added bytes removed again
+        merged->pos = last->pos;
+        merged->length = last->length - length;
+        merged->opType = ADD;
+    } else if (last->opType == ADD && opType == REMOVE && pos <= last->pos && lastHigh <= pos + length) {
+        // The added bytes are removed with bytes of the input around them
+        merged->pos = pos;
+        merged->length = length - last->length;
+        merged->opType = REMOVE;
+    } else {
+        return 0;
+    }
+
+    return merged->pos + merged->length <= MAX_POSITION;
+}
+
+/**
+ * @brief Drop the last operation recorded by the engine
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return 1 if it was dropped, 0 if the engine cannot drop it
+ */
+static int dropLastOperation(MAGIC m) {
+    if (m->size == 0)
+        return 0;
+
+    if (compactEngine(m->engine)) {
+        // Already folded into the table
+        if (m->nbPending == 0)
+            return 0;
+        m->nbPending--;
+    } else if (m->engine == MAGIC_ENGINE_FLAT) {
+        opLogTruncate(m->log, m->size - 1);
+    } else if (m->engine == MAGIC_ENGINE_RBTREE) {
+        rbRemoveLast(m);
+    } else {
+        return 0;
+    }
+
+    m->size--;
+    return 1;
+}
+
+/**
+ * @brief Publish the current version to the readers (writer only)
+ * The compact and hybrid engines publish a snapshot sharing their table. Other
+ * engines compose the previously published table with the operations queued since
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return 1 on success, 0 on allocation error (the previous snapshot stays published)
+ */
+static int publishSnapshot(MAGIC m) {
+    MAGICSnapshot s;
+
+    if (compactEngine(m->engine) || m->engine == MAGIC_ENGINE_HYBRID) {
+        s = MAGICsnapshot(m);
+        if (s == NULL)
+            return 0;
+    } else {
+        s = malloc(sizeof(struct magicSnapshot));
+        if (s == NULL) {
+            printf("publishSnapshot: Allocation error\n");
+            return 0;
+        }
+        s->m = m;
+        s->version = m->size;
+        s->delta = NULL;
+        s->nbDelta = 0;
+
+        if (m->published == NULL) {
+            // First publication: fold the whole instance
+            int owned;
+            s->table = fullTable(m, &owned);
+            if (s->table != NULL && !owned)
+                segTableRetain(s->table);
+        } else if (m->nbPending == 0) {
+            s->table = segTableRetain(m->published->table);
+        } else {
+            SegTable *delta = segTableFromOps(m->pending, m->nbPending);
+            s->table = (delta == NULL) ? NULL : segTableCompose(m->published->table, delta);
+            segTableDestroy(delta);
+        }
+
+        if (s->table == NULL) {
+            free(s);
+            return 0;
+        }
+        m->nbPending = 0;
+    }
+
+    MAGICSnapshot old = __atomic_exchange_n(&m->published, s, __ATOMIC_SEQ_CST);
+    m->sincePublish = 0;
+
+    if (old != NULL)
+        epochRetire(m->readers, old, releaseSnapshot);
+    return 1;
+}
+
+/**
+ * @brief Append an operation to the journal, checkpointing when it is long enough
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType operation type
+ */
+static void journalOperation(MAGIC m, int64_t pos, int64_t length, OperationType opType) {
+    // The operations missed are recorded by the next checkpoint (MAGICjournalSync)
+    if (m->journalBehind)
+        return;
+
+    // The operation is already applied: a journal that failed to record it is behind
+    // the instance, until a checkpoint succeeds
+    Operation op = {pos, length, opType};
+    if (!journalAppend(m->journal, &op)) {
+        m->journalBehind = 1;
+        MAGICcheckpoint(m);
+        return;
+    }
+
+    if (m->durability.checkpointEvery > 0 && journalLength(m->journal) >= m->durability.checkpointEvery)
+        MAGICcheckpoint(m);
+}
+
+/**
+ * @brief Checkpoint the instance, then journal its operations in a new journal
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param path Path of the journal
+ * @param config Durability policy (NULL for the defaults)
+ * @return 1 on success, 0 on error (m->journal is then NULL)
+ */
+static int startJournal(MAGIC m, const char *path, const MAGICjournal *config) {
+    m->durability.syncEvery = (config != NULL) ? config->syncEvery : 0;
+    m->durability.checkpointEvery = (config != NULL) ? config->checkpointEvery : 0;
+    m->journal = NULL;
+
+    char *ckpt = checkpointPath(path);
+    if (ckpt == NULL)
+        return 0;
+    int saved = MAGICsave(m, ckpt);
+    free(ckpt);
+    if (!saved)
+        return 0;
+
+    m->journal = journalCreate(path, m->size, m->durability.syncEvery);
+    m->journalBehind = 0;
+    return m->journal != NULL;
+}
+
+/**
+ * @brief Path of the checkpoint of a journal (path.ckpt)
+ *
+ * @param path Path of the journal
+ * @return Path to free, NULL on allocation error
+ */
+static char *checkpointPath(const char *path) {
+    char *ckpt = malloc(strlen(path) + 6);
+    if (ckpt == NULL) {
+        printf("checkpointPath: Allocation error\n");
+        return NULL;
+    }
+
+    strcpy(ckpt, path);
+    strcat(ckpt, ".ckpt");
+    return ckpt;
+}
+
+/**
+ * @brief Record a snapshot holding the log at a version (no rollback before it)
+ *
+ * @param m Pointer to the MAGIC instance (log engine)
+ * @param version Version of the snapshot
+ * @return 1 on success, 0 on allocation error
+ */
+static int holdVersion(MAGIC m, size_t version) {
+    if (m->nbHeld == m->capHeld) {
+        size_t capacity = (m->capHeld == 0) ? 4 : 2 * m->capHeld;
+        size_t *grown = realloc(m->heldVersions, capacity * sizeof(size_t));
+        if (grown == NULL) {
+            printf("holdVersion: Allocation error\n");
+            return 0;
+        }
+        m->heldVersions = grown;
+        m->capHeld = capacity;
+    }
+
+    m->heldVersions[m->nbHeld++] = version;
+    if (version > m->held)
+        m->held = version;
+    return 1;
+}
+
+/**
+ * @brief Forget a released snapshot of the log, and recompute the last held version
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param version Version of the snapshot
+ */
+static void unholdVersion(MAGIC m, size_t version) {
+    for (size_t i = 0; i < m->nbHeld; i++) {
+        if (m->heldVersions[i] == version) {
+            m->heldVersions[i] = m->heldVersions[--m->nbHeld];
+            break;
+        }
+    }
+
+    m->held = 0;
+    for (size_t i = 0; i < m->nbHeld; i++) {
+        if (m->heldVersions[i] > m->held)
+            m->held = m->heldVersions[i];
+    }
+}
+
+/**
+ * @brief Release a snapshot retired from publication
+ *
+ * @param snapshot Snapshot
+ */
+static void releaseSnapshot(void *snapshot) {
+    MAGICsnapshotRelease(snapshot);
+}
+
+/**
+ * @brief Append an operation to the pending buffer (compact engine, hybrid delta)
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param pos Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType operation type
+ * @return 1 on success, 0 on allocation error
+ */
+static int pendingAppend(MAGIC m, int64_t pos, int64_t length, OperationType opType) {
+    if (m->nbPending == m->capPending) {
+        size_t capacity = (m->capPending == 0) ? 64 : 2 * m->capPending;
+        Operation *pending = realloc(m->pending, capacity * sizeof(Operation));
+        if (pending == NULL) {
+            printf("pendingAppend: Allocation error\n");
+            return 0;
+        }
+        m->pending = pending;
+        m->capPending = capacity;
+    }
+
+    m->pending[m->nbPending].pos = pos;
+    m->pending[m->nbPending].length = length;
+    m->pending[m->nbPending].opType = opType;
+    m->nbPending++;
+
+    return 1;
+}
+
+/**
+ * @brief Fold the pending operations into the table (compact engine, hybrid delta)
+ * The pending operations are folded together first, so that the (large) table
+ * is traversed only once per fold. A background compaction reads the table: its
+ * result is adopted first
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return 1 on success, 0 on allocation error (the instance is left unchanged)
+ */
+static int compactFold(MAGIC m) {
+    hybridAdopt(m, 1);
+    if (m->nbPending == 0)
+        return 1;
+
+    SegTable *delta = segTableFromOps(m->pending, m->nbPending);
+    if (delta == NULL)
+        return 0;
+
+    SegTable *table = segTableCompose(m->table, delta);
+    segTableDestroy(delta);
+    if (table == NULL)
+        return 0;
+
+    segTableDestroy(m->table);
+    m->table = table;
+    m->nbPending = 0;
+
+    // The index described the previous table
+    succinctDestroy(m->index);
+    m->index = NULL;
+    m->indexFailed = 0;
+
+    return 1;
+}
+
+/**
+ * @brief Apply delta operations in chronological order to map from input to output
+ *
+ * @param ops Delta operations
+ * @param n Number of operations
+ * @param pos Position to map
+ * @return Mapped position or -1 if removed
+ */
+static int64_t mapDeltaInOut(const Operation *ops, size_t n, int64_t pos) {
+    for (size_t i = 0; i < n; i++) {
+        if (ops[i].opType == ADD) {
+            if (ops[i].pos <= pos)
+                pos += ops[i].length;
+        } else {
+            if (pos >= ops[i].pos + ops[i].length)
+                pos -= ops[i].length;
+            else if (pos >= ops[i].pos)
+                return -1;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @brief Undo delta operations in reverse order to map from output to input
+ *
+ * @param ops Delta operations
+ * @param n Number of operations
+ * @param pos Position to map
+ * @return Mapped position or -1 if added
+ */
+static int64_t mapDeltaOutIn(const Operation *ops, size_t n, int64_t pos) {
+    for (size_t i = n; i > 0; i--) {
+        const Operation *op = &ops[i - 1];
+        if (op->opType == ADD) {
+            if (pos >= op->pos + op->length)
+                pos -= op->length;
+            else if (pos >= op->pos)
+                return -1;
+        } else {
+            if (op->pos <= pos)
+                pos += op->length;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @brief Fold the delta of the hybrid engine, in place or on a worker thread
+ *
+ * @param m Pointer to the MAGIC instance
+ */
+static void hybridCompact(MAGIC m) {
+    if (!m->compaction.background) {
+        compactFold(m);
+        return;
+    }
+
+    if (m->job != NULL)
+        return; // one compaction at a time, the delta keeps growing meanwhile
+
+    Compaction *job = malloc(sizeof(Compaction));
+    if (job == NULL) {
+        printf("hybridCompact: Allocation error\n");
+        return;
+    }
+
+    // The worker folds a private copy: writers keep appending to the delta
+    job->ops = malloc(m->nbPending * sizeof(Operation));
+    if (job->ops == NULL) {
+        printf("hybridCompact: Allocation error\n");
+        free(job);
+        return;
+    }
+    memcpy(job->ops, m->pending, m->nbPending * sizeof(Operation));
+    job->nbOps = m->nbPending;
+    job->base = m->table;
+    job->result = NULL;
+    job->done = 0;
+    pthread_mutex_init(&job->lock, NULL);
+
+    if (pthread_create(&job->thread, NULL, compactionWorker, job) != 0) {
+        // No thread available: fold in place
+        pthread_mutex_destroy(&job->lock);
+        free(job->ops);
+        free(job);
+        compactFold(m);
+        return;
+    }
+
+    m->job = job;
+}
+
+/**
+ * @brief Adopt the result of a background compaction once it is done
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param wait non-zero to wait for a running compaction
+ */
+static void hybridAdopt(MAGIC m, int wait) {
+    Compaction *job = m->job;
+    if (job == NULL)
+        return;
+
+    if (!wait) {
+        pthread_mutex_lock(&job->lock);
+        int done = job->done;
+        pthread_mutex_unlock(&job->lock);
+        if (!done)
+            return;
+    }
+
+    pthread_join(job->thread, NULL);
+
+    if (job->result != NULL) {
+        // The folded operations leave the delta and enter the base table
+        segTableDestroy(m->table);
+        m->table = job->result;
+        m->nbPending -= job->nbOps;
+        memmove(m->pending, m->pending + job->nbOps, m->nbPending * sizeof(Operation));
+    }
+
+    pthread_mutex_destroy(&job->lock);
+    free(job->ops);
+    free(job);
+    m->job = NULL;
+}
+
+/**
+ * @brief Worker thread of a background compaction
+ *
+ * @param arg Compaction job
+ * @return NULL
+ */
+static void *compactionWorker(void *arg) {
+    Compaction *job = arg;
+
+    SegTable *delta = segTableFromOps(job->ops, job->nbOps);
+    SegTable *result = NULL;
+    if (delta != NULL)
+        result = segTableCompose(job->base, delta);
+    segTableDestroy(delta);
+
+    pthread_mutex_lock(&job->lock);
+    job->result = result;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+/**
+ * @brief Copy the operations of a subtree in chronological (in-order) order
+ *
+ * @param node Root of the subtree
+ * @param wide 1 if the nodes have 64-bit boundaries (WNode)
+ * @param ops Output array, indexed by sequence number
+ */
+static void collectOperations(const INode *node, int wide, Operation *ops) {
+    if (node == NULL)
+        return;
+
+    collectOperations(LEFT(node), wide, ops);
+
+    if (wide) {
+        ops[node->seqNumber].pos = WIDE(node)->low;
+        ops[node->seqNumber].length = WIDE(node)->high - WIDE(node)->low;
+    } else {
+        ops[node->seqNumber].pos = node->low;
+        ops[node->seqNumber].length = node->high - node->low;
+    }
+    ops[node->seqNumber].opType = OP_TYPE(node);
+
+    collectOperations(RIGHT(node), wide, ops);
+}
+
+/**
+ * @brief Copy the log of the engines that keep every operation (interval tree, flat)
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return Array of m->size operations in chronological order (to free), NULL on error
+ */
+static Operation *collectLog(MAGIC m) {
+    Operation *ops = malloc((m->size > 0 ? m->size : 1) * sizeof(Operation));
+    if (ops == NULL) {
+        printf("collectLog: Allocation error\n");
+        return NULL;
+    }
+
+    if (m->engine == MAGIC_ENGINE_FLAT) {
+        opLogCollect(m->log, ops);
+    } else {
+        collectOperations(m->root, m->wide, ops);
+    }
+
+    return ops;
+}
+
+/**
+ * @brief Segment table equivalent to all the operations of the instance
+ * The hybrid delta is left out: the caller applies it
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param owned set to 1 if the caller must destroy the returned table
+ * @return Table, NULL on allocation error
+ */
+static SegTable *currentTable(MAGIC m, int *owned) {
+    *owned = 0;
+    m->used = 1;
+
+    if (compactEngine(m->engine)) {
+        if (m->nbPending > 0 && !compactFold(m))
+            return NULL;
+        return m->table;
+    }
+
+    if (m->engine == MAGIC_ENGINE_HYBRID) {
+        hybridAdopt(m, 0);
+        return m->table;
+    }
+
+    if (m->engine == MAGIC_ENGINE_ROPE) {
+        *owned = 1;
+        return ropeToTable(m->rope);
+    }
+
+    // Interval tree and flat log: fold the whole log
+    Operation *ops = collectLog(m);
+    if (ops == NULL)
+        return NULL;
+
+    SegTable *t = segTableFromOps(ops, m->size);
+    free(ops);
+
+    *owned = 1;
+    return t;
+}
+
+/**
+ * @brief Segment table equivalent to all the operations, hybrid delta included
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param owned set to 1 if the caller must destroy the returned table
+ * @return Table, NULL on allocation error
+ */
+static SegTable *fullTable(MAGIC m, int *owned) {
+    SegTable *t = currentTable(m, owned);
+    if (t == NULL || m->engine != MAGIC_ENGINE_HYBRID || m->nbPending == 0)
+        return t;
+
+    // Fold the delta in a private table: the compaction policy decides when to adopt it
+    SegTable *delta = segTableFromOps(m->pending, m->nbPending);
+    SegTable *full = (delta == NULL) ? NULL : segTableCompose(t, delta);
+    segTableDestroy(delta);
+
+    *owned = 1;
+    return full;
+}
+
+/**
+ * @brief Create an instance
+ *
+ * @param engine Data structure backing the instance
+ * @param memory Memory of the nodes (NULL for the default)
+ * @param pool Pool of the node chunks (NULL for chunks of the instance)
+ * @return Pointer to the instance, NULL on allocation error
+ */
+static MAGIC initInstance(enum MAGICEngine engine, const MAGICmemory *memory, ArenaPool *pool) {
+    MAGIC m = malloc(sizeof(struct magic));
+    if (m == NULL) {
+        printf("MAGICinit: Allocation error\n");
+        return NULL;
+    }
+
+    m->engine = engine;
+    m->root = NULL;
+    m->size = 0;
+    m->table = NULL;
+    m->pending = NULL;
+    m->nbPending = 0;
+    m->capPending = 0;
+    m->compaction.maxDelta = DEFAULT_MAX_DELTA;
+    m->compaction.maxDeltaBytes = 0;
+    m->compaction.background = 0;
+    m->job = NULL;
+    m->nodes = NULL;
+    m->hugePages = (memory != NULL) ? memory->hugePages : 0;
+    m->wide = 0;
+    m->log = NULL;
+    m->index = NULL;
+    m->indexFailed = 0;
+    m->bound = DEFAULT_SUCCINCT_BOUND;
+    m->rope = NULL;
+    m->readers = NULL;
+    m->published = NULL;
+    m->publishEvery = 0;
+    m->sincePublish = 0;
+    m->journal = NULL;
+    m->durability.syncEvery = 0;
+    m->durability.checkpointEvery = 0;
+    m->journalBehind = 0;
+    m->coalesce = 0;
+    m->lastOpen = 0;
+    m->held = 0;
+    m->heldVersions = NULL;
+    m->nbHeld = 0;
+    m->capHeld = 0;
+    m->saved = NULL;
+    m->savedVersion = 0;
+    m->registry = NULL;
+    m->registryIndex = 0;
+    m->used = 0;
+    m->adaptive = 0;
+    m->window = DEFAULT_ADAPT_WINDOW;
+    m->calls = 0;
+    m->updates = 0;
+    m->maps = 0;
+    m->folds = 0;
+    m->afterUpdate = 0;
+    m->regret = 0;
+    MAGICstatsReset(m);
+
+    if (engine == MAGIC_ENGINE_FLAT) {
+        m->log = opLogCreate();
+        if (m->log == NULL) {
+            free(m);
+            return NULL;
+        }
+        return m;
+    }
+
+    if (!compactEngine(engine)) {
+        size_t nodeSize = (engine == MAGIC_ENGINE_ROPE) ? ropeNodeSize() : sizeof(INode);
+        if (pool != NULL) {
+            m->nodes = arenaCreatePooled(nodeSize, pool);
+        } else if (memory != NULL) {
+            m->nodes = arenaCreate(nodeSize, memory->memory, memory->memorySize, memory->hugePages);
+        } else {
+            m->nodes = arenaCreate(nodeSize, NULL, 0, 0);
+        }
+        if (m->nodes == NULL) {
+            free(m);
+            return NULL;
+        }
+    }
+
+    if (engine == MAGIC_ENGINE_ROPE) {
+        m->rope = ropeCreate(m->nodes);
+        if (m->rope == NULL) {
+            arenaDestroy(m->nodes);
+            free(m);
+            return NULL;
+        }
+    }
+
+    if (compactEngine(engine) || engine == MAGIC_ENGINE_HYBRID) {
+        m->table = segTableCreate();
+        if (m->table == NULL) {
+            arenaDestroy(m->nodes);
+            free(m);
+            return NULL;
+        }
+    }
+
+    return m;
+}
+
+/**
+ * @brief Create a compact instance answering from a given table
+ *
+ * @param t Table of the instance (released on error)
+ * @param version Number of operations the table stands for
+ * @return Pointer to the instance, NULL on allocation error
+ */
+static MAGIC adoptTable(SegTable *t, size_t version) {
+    MAGIC m = MAGICinitEngine(MAGIC_ENGINE_COMPACT);
+    if (m == NULL) {
+        segTableDestroy(t);
+        return NULL;
+    }
+
+    // The last segment starts furthest on both streams
+    segTableDestroy(m->table);
+    m->table = t;
+    m->size = version;
+    m->wide = (t->inStart[t->size - 1] > UINT_MAX || t->outStart[t->size - 1] > UINT_MAX);
+
+    return m;
+}
+
+/**
+ * @brief Memory held by an instance
+ * Mapped tables belong to the page cache, not to the instance
+ *
+ * @param m Pointer to the MAGIC instance
+ * @return Number of bytes
+ */
+static size_t instanceBytes(MAGIC m) {
+    size_t bytes = sizeof(struct magic) + arenaBytes(m->nodes) + opLogBytes(m->log)
+                 + m->capPending * sizeof(Operation) + succinctBytes(m->index);
+    if (m->table != NULL && m->table->mapping == NULL)
+        bytes += sizeof(SegTable) + m->table->capacity * 3 * sizeof(int64_t);
+    return bytes;
 }
 
 /**
- * @brief Recursively destroy a tree
+ * @brief Move an instance to the compact or rope engine, releasing its structures
+ * Log engines lose their history: the instance maps versions 0 and current only
  *
- * @param root Root node of tree/subtree
+ * @param m Pointer to the MAGIC instance
+ * @param engine MAGIC_ENGINE_COMPACT or MAGIC_ENGINE_ROPE (not the engine of m)
+ * @return 1 if the instance was migrated, 0 if it is kept as it is
  */
-static void destroyTree(INode *root) {
-    if (root == NULL) {
-        return;
+static int migrateInstance(MAGIC m, enum MAGICEngine engine) {
+    // Readers, the journal and live lazy snapshots need the log
+    if (m->readers != NULL || m->journal != NULL || m->nbHeld > 0)
+        return 0;
+
+    // Folding the log is not a use of the instance
+    int used = m->used;
+    hybridAdopt(m, 1);
+
+    int owned;
+    SegTable *t = fullTable(m, &owned);
+    m->used = used;
+    if (t == NULL)
+        return 0;
+    if (!owned)
+        segTableRetain(t);
+
+    // The pieces of the rope are rebuilt from the table in linear time
+    Arena *nodes = NULL;
+    Rope *rope = NULL;
+    if (engine == MAGIC_ENGINE_ROPE) {
+        if (m->registry != NULL) {
+            nodes = arenaCreatePooled(ropeNodeSize(), m->registry->pool);
+        } else {
+            nodes = arenaCreate(ropeNodeSize(), NULL, 0, m->hugePages);
+        }
+        rope = (nodes == NULL) ? NULL : ropeFromTable(nodes, t);
+        segTableDestroy(t);
+        t = NULL;
+        if (rope == NULL) {
+            arenaDestroy(nodes);
+            return 0;
+        }
     }
-    
-    // Destroy left and right subtrees
-    destroyTree(root->left);
-    destroyTree(root->right);
-    
-    // Free the node
-    free(root);
+
+    // The nodes go back to the pool of the registry
+    arenaDestroy(m->nodes);
+    opLogDestroy(m->log);
+    ropeDestroy(m->rope);
+    segTableDestroy(m->table);
+    segTableDestroy(m->saved);
+    succinctDestroy(m->index);
+    free(m->pending);
+    m->nodes = nodes;
+    m->root = NULL;
+    m->log = NULL;
+    m->rope = rope;
+    m->table = t;
+    m->saved = NULL;
+    m->index = NULL;
+    m->indexFailed = 0;
+    m->pending = NULL;
+    m->nbPending = 0;
+    m->capPending = 0;
+
+    m->engine = engine;
+    m->lastOpen = 0;
+    return 1;
 }
 
 /**
- * @brief Update the minSubtree value for a node based on its low value and children
+ * @brief Save the table of an idle compact instance and map it back from the file
+ * The file is removed at once: the mapping keeps its pages
  *
- * @param node Node to update
+ * @param r Registry of the instance
+ * @param m Pointer to the MAGIC instance (compact)
+ * @return 1 if the instance was spilled, 0 if it is kept as it is
  */
-static void updateMinSubtree(INode *node) {
-    if (node == NULL) return;
-    
-    // Ensure default value
-    node->minSubtree = node->low;
-    
-    // See left child's minimum low value
-    if (node->left != NULL && node->left->minSubtree < node->minSubtree) {
-        node->minSubtree = node->left->minSubtree;
+static int spillInstance(MAGICRegistry r, MAGIC m) {
+    if (m->readers != NULL || m->journal != NULL || (m->nbPending > 0 && !compactFold(m)))
+        return 0;
+    if (m->table->mapping != NULL)
+        return 0;  // already spilled
+
+    char *path = malloc(strlen(r->spillDirectory) + 64);
+    if (path == NULL) {
+        printf("spillInstance: Allocation error\n");
+        return 0;
     }
-    
-    // See right child's minimum low value
-    if (node->right != NULL && node->right->minSubtree < node->minSubtree) {
-        node->minSubtree = node->right->minSubtree;
+    sprintf(path, "%s/magic-%p-%zu.img", r->spillDirectory, (void *)r, r->spills++);
+
+    // The image is removed as soon as it is mapped: no need to sync it
+    size_t version;
+    SegTable *t = segTableSave(m->table, m->size, path, 0) ? segTableOpenMapped(path, &version) : NULL;
+    remove(path);
+    free(path);
+    if (t == NULL)
+        return 0;
+    if (t->mapping == NULL) {
+        segTableDestroy(t);  // read back in memory: nothing to gain
+        return 0;
     }
+
+    // The index and the savepoint table are rebuilt or dropped
+    segTableDestroy(m->table);
+    segTableDestroy(m->saved);
+    succinctDestroy(m->index);
+    m->table = t;
+    m->saved = NULL;
+    m->index = NULL;
+    m->indexFailed = 0;
+    m->used = 0;
+    return 1;
 }
 
 /**
- * @brief Performs a left rotation at a given node
+ * @brief Count a call of an adaptive instance, and estimate its workload every window
  *
  * @param m Pointer to the MAGIC instance
- * @param x The node to rotate around
+ * @param update 1 for an operation, 0 for a mapping
  */
-static void leftRotate(MAGIC m, INode *x) {
-    if (m == NULL || x == NULL || x->right == NULL) {
-        return;
-    }
-    
-    INode *y = x->right; // get right child
-    
-    // Turn y's left subtree into x's right subtree
-    x->right = y->left;
-    if (y->left != NULL) {
-        y->left->parent = x;
-    }
-    
-    // Link x's parent to y
-    y->parent = x->parent;
-    if (x->parent == NULL) {
-        m->root = y;
-    } else if (x == x->parent->left) {
-        x->parent->left = y;
+static void observeCall(MAGIC m, int update) {
+    if (update) {
+        m->updates++;
     } else {
-        x->parent->right = y;
+        m->maps++;
+        m->folds += m->afterUpdate;
     }
-    
-    // x on y's left
-    y->left = x;
-    x->parent = y;
-    
-    // Update minSubtree values after rotation
-    updateMinSubtree(x);
-    updateMinSubtree(y);
-    
-    // Update parent minSubtree 
-    if (y->parent != NULL) {
-        updateMinSubtree(y->parent);
+    m->afterUpdate = update;
+
+    if (++m->calls >= m->window)
+        adaptEngine(m);
+}
+
+/**
+ * @brief Estimated cost of the workload of the current window on an engine
+ * Calibrated on the engines: a compact operation is 1, a binary search step 1,
+ * a fold 3 per segment, and the rope about 6 per level on both calls
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param engine Engine
+ * @param n Number of segments (or operations for a log)
+ * @return Cost, in units of a compact operation
+ */
+static uint64_t workloadCost(MAGIC m, enum MAGICEngine engine, size_t n) {
+    uint64_t updates = m->updates, maps = m->maps, levels = ceilLog2(n) + 1;
+
+    if (compactEngine(engine))
+        return updates + maps * levels + 3 * m->folds * (uint64_t)n;
+
+    if (engine == MAGIC_ENGINE_ROPE)
+        return 6 * (updates + maps) * levels;
+
+    if (engine == MAGIC_ENGINE_FLAT)
+        return updates + maps * (uint64_t)n;
+
+    if (engine == MAGIC_ENGINE_HYBRID) {
+        uint64_t delta = m->compaction.maxDelta;
+        return updates * levels + 3 * updates * (uint64_t)n / delta + maps * (levels + delta / 2);
     }
+
+    return updates * levels + maps * (uint64_t)n;
 }
 
 /**
- * @brief Performs a right rotation at a given node
+ * @brief Migrate an adaptive instance to the cheapest engine for its workload
+ * The saving of the cheapest engine is accumulated while it stays below half of
+ * the current cost; the instance migrates once it pays for the migration
  *
  * @param m Pointer to the MAGIC instance
- * @param y The node to rotate around
  */
-static void rightRotate(MAGIC m, INode *y) {
-    if (m == NULL || y == NULL || y->left == NULL) {
-        return;
+static void adaptEngine(MAGIC m) {
+    size_t n = m->size;
+    if (compactEngine(m->engine)) {
+        n = m->table->size + m->nbPending;
+    } else if (m->engine == MAGIC_ENGINE_ROPE) {
+        n = ropePieces(m->rope);
     }
-    
-    INode *x = y->left;  // get left child
-    
-    // Turn x's right subtree into y's left subtree
-    y->left = x->right;
-    if (x->right != NULL) {
-        x->right->parent = y;
+
+    // Candidates: the compact engine and the rope, whichever is not the current one
+    enum MAGICEngine target = MAGIC_ENGINE_COMPACT;
+    if (compactEngine(m->engine) || (m->engine != MAGIC_ENGINE_ROPE &&
+        workloadCost(m, MAGIC_ENGINE_ROPE, n) < workloadCost(m, MAGIC_ENGINE_COMPACT, n))) {
+        target = MAGIC_ENGINE_ROPE;
     }
-    
-    // Link y's parent to x
-    x->parent = y->parent;
-    if (y->parent == NULL) {
-        m->root = x;
-    } else if (y == y->parent->left) {
-        y->parent->left = x;
+
+    uint64_t current = workloadCost(m, m->engine, n);
+    uint64_t cost = workloadCost(m, target, n);
+    if (2 * cost < current) {
+        m->regret += current - cost;
     } else {
-        y->parent->right = x;
-    }
-    
-    // y on x's right
-    x->right = y;
-    y->parent = x;
-    
-    // Update minSubtree values after rotation
-    updateMinSubtree(y);
-    updateMinSubtree(x);
-    
-    // Update parent minSubtree
-    if (x->parent != NULL) {
-        updateMinSubtree(x->parent);
+        m->regret = 0;
     }
+
+    if (m->regret > MIGRATION_COST * ((uint64_t)n + 1) && migrateInstance(m, target))
+        m->regret = 0;
+
+    m->calls = 0;
+    m->updates = 0;
+    m->maps = 0;
+    m->folds = 0;
 }
 
 /**
- * @brief Performs rotations and recoloring to maintain red-black properties after inserting a new node
+ * @brief Map a batch of positions sorted in non-decreasing order
  *
  * @param m Pointer to the MAGIC instance
- * @param newNode The newly inserted node
+ * @param direction Mapping direction
+ * @param in Sorted positions
+ * @param out Mapped positions (may be in)
+ * @param n Number of positions
  */
-static void rbInsertFixup(MAGIC m, INode *newNode) {
-    if (m == NULL || newNode == NULL) return;
-
-    while (newNode != m->root && newNode->parent != NULL && newNode->parent->color == RED) {
-        if (newNode->parent == newNode->parent->parent->left) {
-            // Case: Parent is a left child of grandparent
-            INode *uncle = newNode->parent->parent->right;
-
-            if (uncle != NULL && uncle->color == RED) {
-                // Case 1: Uncle is RED -> Recolor
-                newNode->parent->color = BLACK;
-                uncle->color = BLACK;
-                newNode->parent->parent->color = RED;
-                newNode = newNode->parent->parent; // Move up to grandparent
+static void mapSortedBatch(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n) {
+    // Short batch on a log: the SIMD kernel over every operation costs less than folding
+    // the log (O(size log size)). The kernel works on 32 bits: only while no position
+    // can be shifted past INT32_MAX (the sorted batch ends with its largest position)
+    if ((m->engine == MAGIC_ENGINE_RBTREE || m->engine == MAGIC_ENGINE_FLAT) && !m->wide &&
+        n <= batchKernelLanes() * ceilLog2(m->size)) {
+        Operation *ops = collectLog(m);
+        if (ops != NULL && !batchKernelFits(ops, m->size, in[n - 1])) {
+            free(ops);
+            ops = NULL;
+        } else if (ops != NULL) {
+            for (size_t i = 0; i < n; i++)
+                out[i] = (in[i] < 0) ? -1 : in[i];
+            if (direction == STREAM_IN_OUT) {
+                batchApplyInOut(ops, m->size, out, n);
             } else {
-                // Case 2: Uncle is BLACK (or NULL)
-                if (newNode == newNode->parent->right) {
-                    // Case 2a: newNode is a right child -> Left-rotate parent
-                    newNode = newNode->parent;
-                    leftRotate(m, newNode);
-                }
-                // Case 3: Recolor and right-rotate grandparent
-                newNode->parent->color = BLACK;
-                newNode->parent->parent->color = RED;
-                rightRotate(m, newNode->parent->parent);
+                batchApplyOutIn(ops, m->size, out, n);
             }
+            free(ops);
+            return;
+        }
+    }
+
+    // Short batch on the rope: descents cost less than flattening the tree (O(size)).
+    // Close positions walk down the same nodes, still cached from the previous descent;
+    // the descents of sparse ones miss the cache at every level, and are interleaved
+    if (m->engine == MAGIC_ENGINE_ROPE && n * ceilLog2(m->size) <= m->size) {
+        if (n * ROPE_SPARSE_BATCH <= ropePieces(m->rope)) {
+            ropeMapBatch(m->rope, direction, in, out, n);
+            return;
+        }
+        for (size_t i = 0; i < n; i++) {
+            int64_t mapped = ropeMap(m->rope, direction, in[i]);
+            out[i] = (mapped > INT_MAX) ? -1 : (int)mapped;
+        }
+        return;
+    }
+
+    int owned;
+    SegTable *t = currentTable(m, &owned);
+    if (t == NULL) {
+        for (size_t i = 0; i < n; i++)
+            out[i] = -1;
+        return;
+    }
+
+    const Operation *delta = NULL;
+    size_t nbDelta = 0;
+    int fits = 1;
+    if (m->engine == MAGIC_ENGINE_HYBRID && m->nbPending > 0) {
+        // Short delta: apply it to the positions with the SIMD kernel. Otherwise fold it
+        // in a private table, a single sweep then costs less than applying every
+        // operation to every position
+        fits = !m->wide && deltaFitsKernel(m, t, direction, in[n - 1]);
+        if (fits && n * m->nbPending <= t->size * batchKernelLanes()) {
+            delta = m->pending;
+            nbDelta = m->nbPending;
         } else {
-            // Symmetric case: Parent is a right child of grandparent
-            INode *uncle = newNode->parent->parent->left;
-
-            if (uncle != NULL && uncle->color == RED) {
-                // Case 1: Uncle is RED -> Recolor
-                newNode->parent->color = BLACK;
-                uncle->color = BLACK;
-                newNode->parent->parent->color = RED;
-                newNode = newNode->parent->parent; // Move up to grandparent
+            SegTable *deltaTable = segTableFromOps(m->pending, m->nbPending);
+            SegTable *full = (deltaTable == NULL) ? NULL : segTableCompose(t, deltaTable);
+            segTableDestroy(deltaTable);
+            if (full != NULL) {
+                t = full;
+                owned = 1;
             } else {
-                // Case 2: Uncle is BLACK (or NULL)
-                if (newNode == newNode->parent->left) {
-                    // Case 2a: newNode is a left child -> Right-rotate parent
-                    newNode = newNode->parent;
-                    rightRotate(m, newNode);
-                }
-                // Case 3: Recolor and left-rotate grandparent
-                newNode->parent->color = BLACK;
-                newNode->parent->parent->color = RED;
-                leftRotate(m, newNode->parent->parent);
+                delta = m->pending;
+                nbDelta = m->nbPending;
             }
         }
     }
-    // Ensure root is always black
-    if (m->root != NULL) {
-        m->root->color = BLACK;
+
+    // The mapping is monotone: positions stay sorted through the table and the delta
+    if (delta != NULL && !fits) {
+        // Allocation error and positions out of the 32-bit kernel range: map query by query
+        for (size_t i = 0; i < n; i++)
+            out[i] = MAGICmap(m, direction, in[i]);
+    } else if (direction == STREAM_IN_OUT) {
+        segTableMapSorted(t, STREAM_IN_OUT, in, out, n);
+        batchApplyInOut(delta, nbDelta, out, n);
+    } else {
+        if (out != in)
+            memcpy(out, in, n * sizeof(int));
+        batchApplyOutIn(delta, nbDelta, out, n);
+        segTableMapSorted(t, STREAM_OUT_IN, out, out, n);
     }
+
+    if (owned)
+        segTableDestroy(t);
 }
 
 /**
- * @brief Insert a node into the tree (ordered by sequence number)
+ * @brief Checks whether the pending delta of a hybrid instance fits the 32-bit kernels
+ * From input to output the delta applies to the table image of the positions,
+ * which must also stay within INT_MAX (segTableMapSorted caps it)
  *
  * @param m Pointer to the MAGIC instance
- * @param newNode The new node
+ * @param t Table of the folded operations
+ * @param direction Mapping direction
+ * @param maxPos Largest position of the batch
+ *
+ * @return 1 if the kernels map the batch exactly, 0 otherwise
  */
-static void rbInsert(MAGIC m, INode *newNode) {
-    if (m == NULL || newNode == NULL) return;
-
-    INode *y = NULL;
-    INode *x = m->root;
+static int deltaFitsKernel(MAGIC m, const SegTable *t, enum MAGICDirection direction, int maxPos) {
+    int64_t reach = maxPos;
 
-    // Find the insertion point based on sequence number for chronological ordering
-    while (x != NULL) {
-        y = x;
-        
-        // Traverse based on sequence number
-        if (newNode->seqNumber < x->seqNumber) {
-            x = x->left;
-        } else {
-            x = x->right;
-        }
+    if (direction == STREAM_IN_OUT) {
+        // The table is monotone: its image of positions up to maxPos stays below the
+        // image of maxPos through the segment starting at or before it
+        size_t i = segTableSeek(t, STREAM_IN_OUT, maxPos, 0);
+        reach = (i == t->size) ? 0 : t->outStart[i] + (maxPos - t->inStart[i]);
+        if (reach > INT_MAX)
+            return 0;
     }
 
-    // Set parent
-    newNode->parent = y;
+    return batchKernelFits(m->pending, m->nbPending, reach);
+}
 
-    // Insert node
-    if (y == NULL) {
-        // Tree is empty
-        m->root = newNode;
-    } else if (newNode->seqNumber < y->seqNumber) {
-        y->left = newNode;
-    } else {
-        y->right = newNode;
-    }
-    
-    // Update minSubtree for the parent
-    if (y != NULL) {
-        updateMinSubtree(y);
-    }
-    
-    // Fix Red-Black properties
-    rbInsertFixup(m, newNode);
-    
-    m->size++;
+/**
+ * @brief Number of bits needed to write n - 1 (ceil(log2(n)), 0 for n <= 1)
+ *
+ * @param n Value
+ * @return ceil(log2(n))
+ */
+static size_t ceilLog2(size_t n) {
+    size_t bits = 0;
+    while (bits < sizeof(size_t) * 8 && ((size_t)1 << bits) < n)
+        bits++;
+    return bits;
 }
 
 /**
- * @brief Process operations in order to map position from input to output
- * With pruning using minSubtree
- * 
- * @param node Current node in traversal
- * @param pos Position to map
- * @return Mapped position or -1 if invalid (or no mapping)
+ * @brief Map a batch of positions on several workers
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param pool Workers kept between batches (NULL to start threads for this batch)
+ * @param nbThreads Number of workers (those of the pool if there is one)
+ * @param direction Mapping direction
+ * @param in Positions to map
+ * @param out Mapped positions
+ * @param n Number of positions
  */
-static int mapInOut(INode *node, int pos) {
-    if (node == NULL) {
-        return pos; // Base case: no more operations 
+static void mapParallel(MAGIC m, Pool *pool, unsigned int nbThreads, enum MAGICDirection direction,
+                        const int *in, int *out, size_t n) {
+    if (in == NULL || out == NULL || n == 0)
+        return;
+
+    // A couple of chunks per thread at least, or threads cost more than they save
+    if (m == NULL || nbThreads <= 1 || n < 2 * PARALLEL_CHUNK) {
+        MAGICmapBatch(m, direction, in, out, n);
+        return;
     }
-    
-    // If position is already negative, return answer query to -1
-    if (pos == -1) {
-        return -1;
+
+    // Every engine is read through its table: workers share it without locks
+    int owned;
+    SegTable *t = fullTable(m, &owned);
+    ParallelBatch job = {t, direction, in, out, n, NULL, NULL};
+    job.sorted = calloc(nbThreads, sizeof(int *));
+    job.order = calloc(nbThreads, sizeof(size_t *));
+    if (t == NULL || job.sorted == NULL || job.order == NULL) {
+        free(job.sorted);
+        free(job.order);
+        if (owned && t != NULL)
+            segTableDestroy(t);
+        MAGICmapBatch(m, direction, in, out, n);
+        return;
     }
-    
-    // Pruning: If position is less than minSubtree of left subtree, 
-    // we can skip the entire left subtree as no operations there will affect this position
-    int leftResult;
-    if (node->left != NULL && pos < node->left->minSubtree) {
-        // Skip left subtree
-        leftResult = pos;
+
+    // Threads of the pool, or started for this batch
+    size_t nbChunks = (n + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK;
+    if (pool != NULL) {
+        poolExecute(pool, nbChunks, mapParallelChunk, &job);
     } else {
-        // Process left subtree
-        leftResult = mapInOut(node->left, pos);
-    }
-    
-    // If position has been marked as invalid by the left subtree, propagate it in order to stop traversal
-    if (leftResult == -1) {
-        return -1;
-    }
-    
-    // Apply current operation
-    int cumulativeResult = leftResult; // track cumulative shifts 
-    if (node->opType == ADD) { // Add operation
-        // If position is at or after insertion point, shift it
-        if (node->low <= cumulativeResult) {
-            cumulativeResult += (node->high - node->low);
-        }
-    } else { // Remove operation
-        // Check if position falls within removed region
-        if (node->low <= cumulativeResult && cumulativeResult < node->high) {
-            return -1; // Position was removed, invalid mapping
-        }
-        
-        // If position is after removal point, shift it back
-        else if (cumulativeResult >= node->high) {
-            cumulativeResult -= (node->high - node->low);
-        }
+        poolRun(nbChunks, nbThreads, mapParallelChunk, &job);
     }
-    
-    // Pruning: If cumulativeResult is less than minSubtree of right subtree,
-    // we can skip the entire right subtree
-    if (node->right != NULL && cumulativeResult < node->right->minSubtree) {
-        // Skip right subtree
-        return cumulativeResult;
-    } else {
-        // Process right subtree
-        return mapInOut(node->right, cumulativeResult);
+
+    for (unsigned int w = 0; w < nbThreads; w++) {
+        free(job.sorted[w]);
+        free(job.order[w]);
     }
+    free(job.sorted);
+    free(job.order);
+    if (owned)
+        segTableDestroy(t);
 }
 
 /**
- * @brief Process operations in reverse order to map position from output to input
- * With pruning using minSubtree
- * 
- * @param node Current node in traversal
- * @param pos Position to map
- * @return Mapped position or -1 if invalid
+ * @brief Map one chunk of a parallel batch (run by any worker)
+ * A sorted chunk is swept directly, otherwise it is sorted in the buffers of the
+ * worker first, or mapped query by query if they cannot be allocated
+ *
+ * @param context Parallel batch
+ * @param chunk Index of the chunk
+ * @param worker Index of the worker
  */
-static int mapOutIn(INode *node, int pos) {
-    if (node == NULL) {
-        return pos; // Base case: no more operations
-    }
-    
-    // If position is already negative, propagate the invalid state
-    if (pos == -1) {
-        return -1;
+static void mapParallelChunk(void *context, size_t chunk, unsigned int worker) {
+    ParallelBatch *job = context;
+    size_t start = chunk * PARALLEL_CHUNK;
+    size_t n = (job->n - start < PARALLEL_CHUNK) ? job->n - start : PARALLEL_CHUNK;
+    const int *in = job->in + start;
+    int *out = job->out + start;
+
+    if (batchIsSorted(in, n)) {
+        segTableMapSorted(job->table, job->direction, in, out, n);
+        return;
     }
-    
-    // Pruning: Skip right subtree if position is less than the minSubtree of right
-    int rightResult;
-    if (node->right != NULL && pos < node->right->minSubtree) {
-        // Skip right subtree
-        rightResult = pos;
-    } else {
-        // Process right subtree
-        rightResult = mapOutIn(node->right, pos);
+
+    // Only this worker uses its buffers
+    if (job->sorted[worker] == NULL) {
+        job->sorted[worker] = malloc(PARALLEL_CHUNK * sizeof(int));
+        job->order[worker] = malloc(PARALLEL_CHUNK * sizeof(size_t));
     }
-    
-    // If position has been marked as invalid by the right subtree, propagate it to stop traversal
-    if (rightResult == -1) {
-        return -1;
+    int *sorted = job->sorted[worker];
+    size_t *order = job->order[worker];
+
+    if (sorted == NULL || order == NULL || !batchSort(in, n, sorted, order)) {
+        for (size_t i = 0; i < n; i++) {
+            int64_t mapped = (in[i] < 0) ? -1 : segTableMap(job->table, job->direction, in[i]);
+            out[i] = (mapped > INT_MAX) ? -1 : (int)mapped;
+        }
+        return;
     }
-    
-    // Apply current operation (in reverse)
-    int cumulativeResult = rightResult;
-    if (node->opType == ADD) { // Undo an add operation
-        // If position is within added range, it doesn't exist in input
-        if (node->low <= cumulativeResult && cumulativeResult < node->high) {
+
+    segTableMapSorted(job->table, job->direction, sorted, sorted, n);
+    for (size_t i = 0; i < n; i++)
+        out[order[i]] = sorted[i];
+}
+
+/**
+ * @brief Map a position through the structures of the engine
+ *
+ * @param m Pointer to the MAGIC instance
+ * @param direction Mapping direction
+ * @param pos Position to map (non-negative)
+ * @return Mapped position or -1 if there is none
+ */
+static int64_t mapPosition(MAGIC m, enum MAGICDirection direction, int64_t pos) {
+    m->used = 1;
+
+    if (compactEngine(m->engine)) {
+        // Fold the pending operations before searching the table
+        if (m->nbPending > 0 && !compactFold(m))
             return -1;
+
+        // The index of a new table is built by the first query (table searched if it cannot be)
+        if (m->engine == MAGIC_ENGINE_SUCCINCT && m->index == NULL && !m->indexFailed) {
+            m->index = succinctFromTable(m->table, m->bound);
+            m->indexFailed = (m->index == NULL);
         }
-        
-        // If position is after the added range, shift backward
-        if (cumulativeResult >= node->high) {
-            cumulativeResult -= (node->high - node->low);
-        }
-    } else { // Undo a remove operation
-        // If position is at or after the start of removed section,
-        // shift forward by the length of the removed section
-        if (node->low <= cumulativeResult) {
-            cumulativeResult += (node->high - node->low);
+        if (m->index != NULL)
+            return succinctMap(m->index, m->table, direction, pos);
+        return segTableMap(m->table, direction, pos);
+    }
+
+    if (m->engine == MAGIC_ENGINE_FLAT)
+        return opLogMap(m->log, direction, pos);
+
+    if (m->engine == MAGIC_ENGINE_ROPE)
+        return ropeMap(m->rope, direction, pos);
+
+    if (m->engine == MAGIC_ENGINE_HYBRID) {
+        hybridAdopt(m, 0);
+
+        // Base table then delta, or delta (in reverse) then base table
+        if (direction == STREAM_IN_OUT) {
+            int64_t mid = segTableMap(m->table, STREAM_IN_OUT, pos);
+            return (mid < 0) ? -1 : mapDeltaInOut(m->pending, m->nbPending, mid);
+        } else {
+            int64_t mid = mapDeltaOutIn(m->pending, m->nbPending, pos);
+            return (mid < 0) ? -1 : segTableMap(m->table, STREAM_OUT_IN, mid);
         }
     }
     
-    // Pruning: Skip left subtree if position is less than the minSubtree of left
-    if (node->left != NULL && cumulativeResult < node->left->minSubtree) {
-        // Skip left subtree
-        return cumulativeResult;
-    } else {
-        // Process left subtree
-        return mapOutIn(node->left, cumulativeResult);
+    return mapTree(m, direction, pos, m->size);
+}
+
+#ifdef MAGIC_STATS
+/**
+ * @brief Monotonic clock, in nanoseconds
+ *
+ * @return Current time
+ */
+static uint64_t clockNanoseconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * @brief Count a call in a latency histogram (bucket i holds [2^i, 2^(i+1)) ns)
+ *
+ * @param histogram Histogram of MAGIC_STATS_BUCKETS buckets
+ * @param nanoseconds Latency of the call
+ */
+static void recordLatency(uint64_t *histogram, uint64_t nanoseconds) {
+    size_t bucket = 0;
+    while (nanoseconds > 1 && bucket < MAGIC_STATS_BUCKETS - 1) {
+        nanoseconds >>= 1;
+        bucket++;
     }
+    histogram[bucket]++;
+}
+#endif
+
+/**
+ * @brief Engines recording in a pending buffer folded into a segment table
+ *
+ * @param engine Engine
+ * @return 1 for the compact and succinct engines, 0 otherwise
+ */
+static int compactEngine(enum MAGICEngine engine) {
+    return engine == MAGIC_ENGINE_COMPACT || engine == MAGIC_ENGINE_SUCCINCT;
 }
@@ -15,6 +15,9 @@
 #ifndef MAGIC_H
 #define MAGIC_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * @enum MAGICDirection
  * @brief Enum to define the mapping direction of the byte stream.
@@ -22,12 +25,164 @@
 // typedef enum {STREAM_IN_OUT = 0, STREAM_OUT_IN = 1} MAGICDirection;
 enum MAGICDirection { STREAM_IN_OUT=0, STREAM_OUT_IN=1 };
 
+/**
+ * @enum MAGICEngine
+ * @brief Enum to select the data structure backing a MAGIC instance.
+ *
+ * MAGIC_ENGINE_RBTREE keeps the chronological log of operations in an interval tree.
+ * MAGIC_ENGINE_COMPACT folds the operations into a sorted table of surviving segments,
+ * so that MAGICmap is a binary search in both directions.
+ * MAGIC_ENGINE_HYBRID keeps the interval tree log, plus a compacted table of the
+ * operations up to an epoch and a short delta of the most recent operations.
+ * MAGIC_ENGINE_FLAT appends the operations to contiguous arrays in O(1) and maps
+ * with a linear scan that skips whole blocks of operations.
+ * MAGIC_ENGINE_ROPE keeps the output stream as pieces in a balanced tree keyed by
+ * output position: operations and MAGICmap are O(log n) in both directions.
+ * MAGIC_ENGINE_SUCCINCT records as the compact engine, and indexes the surviving
+ * bytes of a bounded stream with rank/select bitvectors: MAGICmap is O(1) in both
+ * directions, for about 1.25 bits of memory per byte of each stream, input and output
+ * (see MAGICinitBounded).
+ *
+ * The interval tree of MAGIC_ENGINE_RBTREE and MAGIC_ENGINE_HYBRID holds at most
+ * 2^32 - 1 operations (128 GiB of nodes): past that, operations are refused with an
+ * error message and the instance keeps its last version. The flat and rope engines
+ * log longer histories.
+ */
+enum MAGICEngine { MAGIC_ENGINE_RBTREE=0, MAGIC_ENGINE_COMPACT=1, MAGIC_ENGINE_HYBRID=2,
+                   MAGIC_ENGINE_FLAT=3, MAGIC_ENGINE_ROPE=4, MAGIC_ENGINE_SUCCINCT=5 };
+
+/**
+ * @struct MAGICcompaction
+ * @brief Compaction policy of the hybrid engine.
+ *
+ * The delta is folded into the compacted table as soon as one of the limits is reached.
+ */
+typedef struct {
+    size_t maxDelta;        // number of operations in the delta (0 for the default)
+    size_t maxDeltaBytes;   // memory used by the delta, in bytes (0 for no limit)
+    int background;         // non-zero to fold on a worker thread
+} MAGICcompaction;
+
+/**
+ * @struct MAGICmemory
+ * @brief Memory used for the operation nodes of a MAGIC instance.
+ *
+ * Nodes are carved out of chunks owned by the instance. The caller may supply the
+ * first block of memory (it must outlive the instance and is never freed by it).
+ */
+typedef struct {
+    void *memory;        // caller-supplied memory for the nodes (NULL for none)
+    size_t memorySize;   // size of memory, in bytes
+    int hugePages;       // non-zero to back the chunks with huge pages when available
+} MAGICmemory;
+
+/**
+ * @struct MAGICpolicy
+ * @brief Engine selection of a MAGIC instance.
+ *
+ * An adaptive instance counts its MAGICadd/MAGICremove and MAGICmap calls, estimates
+ * every window calls what the mix would cost on each engine, and migrates online to
+ * the compact or the rope engine once the cost saved pays for the migration. Leaving
+ * a log engine (interval tree, hybrid or flat) drops its history.
+ */
+typedef struct {
+    enum MAGICEngine engine;  // engine of the new instance
+    int adaptive;             // non-zero to migrate as the workload changes
+    size_t window;            // calls between two estimations (0 for the default)
+} MAGICpolicy;
+
+/**
+ * @struct MAGICjournal
+ * @brief Durability policy of a journaled MAGIC instance.
+ *
+ * Records are buffered; syncEvery trades the operations lost in a crash for the
+ * number of syncs (group commit). Checkpoints bound the journal replayed at recovery.
+ */
+typedef struct {
+    size_t syncEvery;        // operations between two syncs to the disk (0 for MAGICjournalSync only)
+    size_t checkpointEvery;  // operations between two checkpoints (0 for MAGICcheckpoint only)
+} MAGICjournal;
+
+/**
+ * @struct MAGICop
+ * @brief One operation of a batch applied by MAGICapplyBatch.
+ */
+typedef struct {
+    int64_t pos;         // position of the operation
+    int64_t length;      // number of bytes added or removed
+    int remove;          // 0 for MAGICadd, non-zero for MAGICremove
+} MAGICop;
+
+/**
+ * @struct MAGICrun
+ * @brief Run of consecutive bytes of a range that survive a mapping.
+ */
+typedef struct {
+    int64_t pos;         // first byte of the run in the source stream
+    int64_t mapped;      // first byte of the run in the target stream
+    int64_t length;      // number of bytes of the run
+} MAGICrun;
+
+/* Number of buckets of a latency histogram */
+#define MAGIC_STATS_BUCKETS 32
+
+/**
+ * @struct MAGICstatistics
+ * @brief Counters of a MAGIC instance, filled by MAGICstats.
+ *
+ * The counters are only maintained by builds compiled with MAGIC_STATS (enabled is
+ * then 1); otherwise they stay 0. The traversal counters are those of the interval
+ * tree (rbtree engine, and the log of the hybrid engine). Bucket i of a latency
+ * histogram counts the calls that took between 2^i and 2^(i+1) - 1 nanoseconds.
+ */
+typedef struct {
+    int enabled;             // 1 if the counters are maintained by this build
+
+    uint64_t maps;           // calls to MAGICmap and MAGICmap64
+    uint64_t nodesVisited;   // tree nodes traversed by the mappings
+    uint64_t prunedLeft;     // left subtrees skipped thanks to minSubtree
+    uint64_t prunedRight;    // right subtrees skipped thanks to minSubtree
+    uint64_t earlyExits;     // traversals stopped by a position without counterpart
+    uint64_t inserts;        // nodes inserted in the tree
+    uint64_t rotations;      // rotations rebalancing the tree after the inserts
+
+    uint64_t mapLatency[MAGIC_STATS_BUCKETS];     // latency of MAGICmap and MAGICmap64
+    uint64_t updateLatency[MAGIC_STATS_BUCKETS];  // latency of MAGICadd and MAGICremove
+
+    size_t height;           // height of the tree (0 for the engines without one)
+    size_t bytesAllocated;   // memory held by the instance, in bytes (always filled)
+} MAGICstatistics;
+
 /**
  * @struct magic
  * @brief Opaque data structure representing the MAGIC ADT.
  */
 typedef struct magic *MAGIC;
 
+/**
+ * @struct magicSnapshot
+ * @brief Opaque handle keeping a version of a MAGIC instance readable.
+ */
+typedef struct magicSnapshot *MAGICSnapshot;
+
+/**
+ * @struct magicCursor
+ * @brief Opaque handle mapping a non-decreasing sequence of positions.
+ */
+typedef struct magicCursor *MAGICCursor;
+
+/**
+ * @struct magicRegistry
+ * @brief Opaque handle on a set of MAGIC instances sharing one node pool.
+ */
+typedef struct magicRegistry *MAGICRegistry;
+
+/**
+ * @struct magicWorkers
+ * @brief Opaque handle on threads mapping batches, kept between batches.
+ */
+typedef struct magicWorkers *MAGICWorkers;
+
 /**
  * @brief Initializes the data structure used for MAGIC
  * 
@@ -37,6 +192,121 @@ typedef struct magic *MAGIC;
  */
 MAGIC MAGICinit();
 
+/**
+ * @brief Initializes a MAGIC instance backed by a given engine
+ * 
+ * MAGICinit() is equivalent to MAGICinitEngine(MAGIC_ENGINE_RBTREE).
+ * 
+ * @param engine Data structure used to store the operations
+ * 
+ * @return Pointer to the newly created instance of MAGIC ADT
+ */
+MAGIC MAGICinitEngine(enum MAGICEngine engine);
+
+/**
+ * @brief Initializes a MAGIC instance with control over the memory of its nodes
+ * 
+ * @param engine Data structure used to store the operations
+ * @param memory Memory options (NULL for the defaults of MAGICinitEngine)
+ * 
+ * @return Pointer to the newly created instance of MAGIC ADT
+ */
+MAGIC MAGICinitWithMemory(enum MAGICEngine engine, const MAGICmemory *memory);
+
+/**
+ * @brief Initializes a succinct engine instance for streams of a bounded size
+ * 
+ * The bitvectors cover the first streamLength bytes of each stream (MAGICinitEngine
+ * covers 128 MiB): positions past it, up to the last edit, are mapped by a binary
+ * search instead. The index is rebuilt in O(streamLength / 64) by the first
+ * MAGICmap after new operations, so the engine suits rewrites followed by queries.
+ * If it cannot be built, the table is searched until the next operations.
+ * 
+ * @param streamLength Number of bytes of each stream indexed
+ * 
+ * @return Pointer to the newly created instance of MAGIC ADT
+ */
+MAGIC MAGICinitBounded(int64_t streamLength);
+
+/**
+ * @brief Initializes a MAGIC instance following an engine selection policy
+ * 
+ * An adaptive instance starts on policy->engine and moves between the compact
+ * engine (cheap operations, a fold before the first MAGICmap after them) and the
+ * rope engine (O(log n) operations and mappings) as the workload changes. It stays
+ * where it is while concurrent or journaled, and once a snapshot was taken of its log.
+ * 
+ * @param policy Engine selection (NULL for the defaults of MAGICinit)
+ * 
+ * @return Pointer to the newly created instance of MAGIC ADT
+ */
+MAGIC MAGICinitWithPolicy(const MAGICpolicy *policy);
+
+/**
+ * @brief Engine currently backing an instance
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return Engine of the instance (changes over time for an adaptive instance)
+ */
+enum MAGICEngine MAGICengine(MAGIC m);
+
+/**
+ * @brief Saves the current mapping to a file, for MAGICopenMapped
+ * 
+ * The file holds the compacted mapping (one entry per surviving segment, not the
+ * operations) in a flat layout. It is replaced atomically: processes having it
+ * open keep the previous version.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param path Path of the file
+ * 
+ * @return 1 on success, 0 on error
+ */
+int MAGICsave(MAGIC m, const char *path);
+
+/**
+ * @brief Opens a mapping saved by MAGICsave, mapped read-only in memory
+ * 
+ * Nothing is replayed or parsed: the instance (compact engine) searches the file
+ * image directly, loading pages on demand, and processes opening the same file
+ * share its pages. Further operations are folded into a private copy. Files are
+ * only portable between machines of the same byte order.
+ * 
+ * @param path Path of the file
+ * 
+ * @return Pointer to the instance, NULL if the file cannot be opened or is not valid
+ */
+MAGIC MAGICopenMapped(const char *path);
+
+/**
+ * @brief Fuses two mappings applied one after the other
+ * 
+ * The input stream of b must be the output stream of a: the result maps the input
+ * stream of a to the output stream of b in one lookup. It is built on the compacted
+ * forms of a and b in time linear in their number of segments, and runs the compact
+ * engine; a and b are left unchanged.
+ * 
+ * @param a First mapping applied
+ * @param b Second mapping applied
+ * 
+ * @return Pointer to the new instance, NULL on error
+ */
+MAGIC MAGICcompose(MAGIC a, MAGIC b);
+
+/**
+ * @brief Inverts a mapping
+ * 
+ * MAGICmap on the result with STREAM_IN_OUT is MAGICmap on m with STREAM_OUT_IN,
+ * and conversely. Built in time linear in the number of segments of m, the result
+ * runs the compact engine; m is left unchanged.
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return Pointer to the new instance, NULL on error
+ */
+MAGIC MAGICinvert(MAGIC m);
+
 /**
  * @brief Removes bytes from the input stream.
  * 
@@ -70,14 +340,505 @@ void MAGICadd(MAGIC m, int pos, int length);
  * @param direction Mapping direction
  * @param pos Position to map
  * 
- * @return Mapped byte position in the given direction
+ * @return Mapped byte position in the given direction (-1 if it does not fit in an int)
  */
 int MAGICmap(MAGIC m, enum MAGICDirection direction, int pos);
 
+/**
+ * @brief Removes bytes from the input stream, with 64-bit positions
+ * 
+ * Instances start with 32-bit storage; the first operation ending past 4 GiB
+ * widens them once, so small streams do not pay for wider nodes.
+ * Positions and lengths must stay below 2^60.
+ * 
+ * @param m Pointer to the MAGIC instance
+ * @param pos Start of the range to remove
+ * @param length Number of bytes to remove
+ */
+void MAGICremove64(MAGIC m, int64_t pos, int64_t length);
+
+/**
+ * @brief Adds bytes to the input stream, with 64-bit positions
+ * 
+ * See MAGICremove64.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param pos Start at which the bytes are added
+ * @param length Number of bytes to add
+ */
+void MAGICadd64(MAGIC m, int64_t pos, int64_t length);
+
+/**
+ * @brief Applies an array of operations, as the same MAGICadd64 and MAGICremove64 calls
+ * 
+ * The interval tree is rebuilt balanced from its nodes and the new ones in
+ * O(size + n), without a rebalancing insertion per operation, when the batch is at
+ * least as long as the log (and the instance is not concurrent, journaled or
+ * coalescing). Other cases, and other engines, record the operations one by one.
+ * Invalid operations are skipped, as by MAGICadd64 and MAGICremove64.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param ops Operations in chronological order
+ * @param n Number of operations
+ */
+void MAGICapplyBatch(MAGIC m, const MAGICop *ops, size_t n);
+
+/**
+ * @brief Maps a 64-bit byte position between input and output streams
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction
+ * @param pos Position to map
+ * 
+ * @return Mapped byte position in the given direction, -1 if there is none
+ */
+int64_t MAGICmap64(MAGIC m, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Maps an array of byte positions between input and output streams
+ * 
+ * Equivalent to calling MAGICmap on every position, but the operations are swept
+ * once for the whole batch. Unsorted positions are sorted internally; results are
+ * written in the order of the queries.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction
+ * @param in Positions to map
+ * @param out Mapped positions (-1 when there is no mapping)
+ * @param n Number of positions
+ */
+void MAGICmapBatch(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n);
+
+/**
+ * @brief Maps an array of byte positions on several threads
+ * 
+ * Same results as MAGICmapBatch. The queries are cut in chunks mapped through the
+ * table of the current version by nbThreads workers (the calling thread and
+ * nbThreads - 1 threads started for the call and joined before it returns); a
+ * worker done with its chunks steals from the others, so clustered queries keep
+ * every worker busy. Meant for very large batches: small ones, or nbThreads <= 1,
+ * run MAGICmapBatch. See MAGICworkersCreate to keep the threads between batches.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction
+ * @param in Positions to map
+ * @param out Mapped positions (-1 when there is no mapping)
+ * @param n Number of positions
+ * @param nbThreads Number of threads mapping the batch
+ */
+void MAGICmapBatchParallel(MAGIC m, enum MAGICDirection direction, const int *in, int *out, size_t n,
+                           unsigned int nbThreads);
+
+/**
+ * @brief Creates workers for MAGICmapBatchWorkers
+ * 
+ * The nbThreads - 1 threads are started once and sleep between batches, so a batch
+ * no longer pays for creating and joining them. Workers map one batch at a time,
+ * for any instance; they must be destroyed by MAGICworkersDestroy.
+ * 
+ * @param nbThreads Number of workers, the thread calling MAGICmapBatchWorkers included
+ * 
+ * @return Workers, NULL on allocation error
+ */
+MAGICWorkers MAGICworkersCreate(unsigned int nbThreads);
+
+/**
+ * @brief Maps an array of byte positions on the threads of workers
+ * 
+ * Same as MAGICmapBatchParallel with as many threads as the workers. Calls on the
+ * same workers must not overlap.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param w Workers (NULL maps on the calling thread)
+ * @param direction Mapping direction
+ * @param in Positions to map
+ * @param out Mapped positions (-1 when there is no mapping)
+ * @param n Number of positions
+ */
+void MAGICmapBatchWorkers(MAGIC m, MAGICWorkers w, enum MAGICDirection direction, const int *in, int *out,
+                          size_t n);
+
+/**
+ * @brief Stops the threads of workers and frees them
+ * 
+ * @param w Workers to destroy
+ */
+void MAGICworkersDestroy(MAGICWorkers w);
+
+/**
+ * @brief Maps a range of byte positions to the runs it becomes
+ * 
+ * Bytes without counterpart (removed, or added when mapping back) are dropped, so
+ * the range splits into runs, in increasing order on both streams. Runs contiguous
+ * on both streams are merged. Costs O(log size + runs) on the compact, hybrid and
+ * rope engines (the hybrid delta is folded first); the interval tree and flat
+ * engines fold their log first.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction
+ * @param pos First position of the range
+ * @param length Number of bytes of the range
+ * @param runs Output array of runs (may be NULL if maxRuns is 0)
+ * @param maxRuns Capacity of runs
+ * 
+ * @return Number of runs, possibly more than maxRuns (only the first maxRuns are
+ *         written), 0 on allocation error
+ */
+size_t MAGICmapRange(MAGIC m, enum MAGICDirection direction, int64_t pos, int64_t length,
+                     MAGICrun *runs, size_t maxRuns);
+
+/**
+ * @brief Number of operations recorded so far (the current version)
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return Version of the instance
+ */
+size_t MAGICversion(MAGIC m);
+
+/* Returned by MAGICmapAt for a version the engine no longer has (see MAGICversionAvailable) */
+#define MAGIC_VERSION_UNAVAILABLE (-2)
+
+/**
+ * @brief Maps a byte position against the state after the first operations only
+ * 
+ * The interval tree, hybrid and flat engines keep their whole log and map any
+ * version. The compact and rope engines keep no history: see MAGICversionAvailable
+ * for the versions they still map, take snapshots to keep a version instead.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param version Number of operations applied (clamped to the current version)
+ * @param direction Mapping direction
+ * @param pos Position to map
+ * 
+ * @return Mapped byte position in the given direction, -1 if there is none,
+ *         MAGIC_VERSION_UNAVAILABLE if the version cannot be mapped
+ */
+int64_t MAGICmapAt(MAGIC m, size_t version, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Tells whether MAGICmapAt can map a version
+ * 
+ * Versions 0 and current are always available, and every version of the interval
+ * tree, hybrid and flat engines. The compact engines keep the operations recorded
+ * since their last fold (the next mapping folds them) and the version of their last
+ * savepoint. The rope engine keeps no other version.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param version Number of operations applied
+ * 
+ * @return 1 if the version can be mapped, 0 otherwise
+ */
+int MAGICversionAvailable(MAGIC m, size_t version);
+
+/**
+ * @brief Keeps the current version readable while new operations keep arriving
+ * 
+ * The compact and hybrid engines share their (immutable) segment table with the
+ * snapshot, the rope engine copies its pieces in O(size), and the log engines fold
+ * the version on the first mapping. Mapping a snapshot then costs O(log size).
+ * Snapshots must be released before their instance is destroyed.
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return Snapshot of the current version, NULL on allocation error
+ */
+MAGICSnapshot MAGICsnapshot(MAGIC m);
+
+/**
+ * @brief Version kept by a snapshot
+ * 
+ * @param s Snapshot
+ * 
+ * @return Number of operations applied in the snapshot
+ */
+size_t MAGICsnapshotVersion(MAGICSnapshot s);
+
+/**
+ * @brief Maps a byte position against the version of a snapshot
+ * 
+ * @param s Snapshot
+ * @param direction Mapping direction
+ * @param pos Position to map
+ * 
+ * @return Mapped byte position in the given direction, -1 if there is none
+ */
+int64_t MAGICsnapshotMap(MAGICSnapshot s, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Releases a snapshot
+ * 
+ * @param s Snapshot to release
+ */
+void MAGICsnapshotRelease(MAGICSnapshot s);
+
+/**
+ * @brief Marks the current version as a point to roll back to
+ * 
+ * The last operation is no longer merged with the next one (see MAGICsetCoalescing).
+ * The compact engines fold their pending operations and keep the table of the
+ * version, until the next savepoint.
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return Savepoint (the current version)
+ */
+size_t MAGICsavepoint(MAGIC m);
+
+/**
+ * @brief Discards every operation recorded after a savepoint
+ * 
+ * The interval tree removes its last nodes and gives them back to the arena, the
+ * flat log is truncated, in O(discarded operations) (times log size for the tree).
+ * The compact engines drop pending operations, or restore the table kept by the
+ * last savepoint in O(1). The hybrid engine rolls back within its delta only.
+ * Nothing is done for the rope engine, a concurrent or journaled instance, a
+ * savepoint before a live snapshot of the interval tree or flat log, or a savepoint
+ * the engine no longer has.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param savepoint Version returned by MAGICsavepoint (at most the current version)
+ * 
+ * @return 1 if the instance is back at the savepoint, 0 if nothing was done
+ */
+int MAGICrollback(MAGIC m, size_t savepoint);
+
+/**
+ * @brief Creates a cursor scanning a stream front to back
+ * 
+ * The cursor maps the current version through the compacted segments, resuming
+ * from the segment of the previous position: a non-decreasing sequence of positions
+ * is mapped in amortized O(1) each (O(log distance) for a jump). A smaller position
+ * is still mapped, with a search from the first segment. The cursor keeps the
+ * version it was created at; it must be released before its instance is destroyed.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction of the cursor
+ * 
+ * @return Cursor, NULL on allocation error
+ */
+MAGICCursor MAGICcursor(MAGIC m, enum MAGICDirection direction);
+
+/**
+ * @brief Maps the next position of a scan
+ * 
+ * @param c Cursor
+ * @param pos Position to map, normally not smaller than the previous one
+ * 
+ * @return Mapped byte position in the direction of the cursor, -1 if there is none
+ */
+int64_t MAGICcursorMap(MAGICCursor c, int64_t pos);
+
+/**
+ * @brief Releases a cursor
+ * 
+ * @param c Cursor to release
+ */
+void MAGICcursorRelease(MAGICCursor c);
+
+/**
+ * @brief Enables the single-writer / multi-reader mode
+ * 
+ * The writer (the thread calling MAGICadd, MAGICremove and every other function)
+ * publishes immutable snapshots; any number of reader threads map against the
+ * last published one with MAGICmapPublished, without locks. Call before starting
+ * the readers; calling again only changes publishEvery.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param publishEvery Operations between automatic publications (0 to publish
+ *                     only with MAGICpublish)
+ * 
+ * @return 1 on success, 0 on allocation error
+ */
+int MAGICsetConcurrent(MAGIC m, size_t publishEvery);
+
+/**
+ * @brief Publishes the current version to the readers (writer only)
+ * 
+ * Costs O(size) at most, the snapshots it replaces are released once no reader
+ * may still hold them.
+ * 
+ * @param m Pointer to MAGIC instance
+ */
+void MAGICpublish(MAGIC m);
+
+/**
+ * @brief Maps a byte position against the last published version (any thread)
+ * 
+ * Lock-free and O(log size). Without concurrent mode, equivalent to MAGICmap64.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param direction Mapping direction
+ * @param pos Position to map
+ * 
+ * @return Mapped byte position in the given direction, -1 if there is none
+ */
+int64_t MAGICmapPublished(MAGIC m, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Starts journaling the operations of an instance
+ * 
+ * The current mapping is checkpointed to path.ckpt (see MAGICsave), then every
+ * following MAGICadd and MAGICremove is appended to the journal at path.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param path Path of the journal
+ * @param config Durability policy (NULL to sync only on MAGICjournalSync and
+ *               checkpoint only on MAGICcheckpoint)
+ * 
+ * @return 1 on success, 0 on error (the instance is then not journaled)
+ */
+int MAGICjournalOpen(MAGIC m, const char *path, const MAGICjournal *config);
+
+/**
+ * @brief Writes the journaled operations to the disk and waits for it
+ * 
+ * When a record or a checkpoint failed (a full disk, for instance), the journal
+ * misses operations and records no more: each call then retries a checkpoint,
+ * which journals the instance again once it succeeds.
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return 1 on success, 0 on error or if the instance is not journaled
+ */
+int MAGICjournalSync(MAGIC m);
+
+/**
+ * @brief Checkpoints the current mapping and starts an empty journal
+ * 
+ * Costs O(size) (the mapping is saved compacted), so that a recovery only replays
+ * the operations journaled since. The checkpoint is on the disk before the
+ * journal is reset.
+ * 
+ * @param m Pointer to MAGIC instance
+ * 
+ * @return 1 on success, 0 on error or if the instance is not journaled
+ */
+int MAGICcheckpoint(MAGIC m);
+
+/**
+ * @brief Recovers a journaled instance after a crash or a restart
+ * 
+ * Opens the last checkpoint (mapped, see MAGICopenMapped), replays the operations
+ * journaled after it, and journals the recovered instance again. The recovered
+ * instance runs the compact engine; its version is the one of the lost instance
+ * but older versions are not kept.
+ * 
+ * @param path Path of the journal
+ * @param config Durability policy of the recovered instance (NULL as in MAGICjournalOpen)
+ * 
+ * @return Pointer to the instance, NULL if no checkpoint can be opened
+ */
+MAGIC MAGICrecover(const char *path, const MAGICjournal *config);
+
+/**
+ * @brief Configures when the hybrid engine compacts its delta
+ * 
+ * While a background compaction runs, writers keep appending to the delta and
+ * queries go through the previous table; the result is adopted by the next call.
+ * Has no effect on other engines.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param config Compaction policy
+ */
+void MAGICsetCompaction(MAGIC m, const MAGICcompaction *config);
+
+/**
+ * @brief Merges each operation with the previous one when they combine into one
+ * 
+ * Adds extending the bytes just added, removes adjacent to the bytes just removed,
+ * and removes of bytes just added are merged into the previous operation, or cancel
+ * it, so the operations kept follow the net change (interval tree, flat and compact
+ * engines; the rope already does). MAGICversion then counts the operations kept, and
+ * the version between two merged operations is not kept. Versions held by a
+ * snapshot are never changed. Operations are not merged in concurrent or journaled mode.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param enabled Non-zero to merge the operations, 0 to record each one
+ */
+void MAGICsetCoalescing(MAGIC m, int enabled);
+
+/**
+ * @brief Reads the counters of an instance
+ * 
+ * height and bytesAllocated are computed on the call, in O(size) for the height.
+ * The other counters cost nothing unless the library is compiled with MAGIC_STATS.
+ * 
+ * @param m Pointer to MAGIC instance
+ * @param out Output: counters since the creation of the instance or the last MAGICstatsReset
+ */
+void MAGICstats(MAGIC m, MAGICstatistics *out);
+
+/**
+ * @brief Resets the counters and latency histograms of an instance
+ * 
+ * @param m Pointer to MAGIC instance
+ */
+void MAGICstatsReset(MAGIC m);
+
+/**
+ * @brief Creates a registry of instances sharing one pool of node chunks
+ * 
+ * Instances of a registry carve their nodes out of small chunks of a shared pool,
+ * and give them back when they are compacted or destroyed. MAGICregistryTrim
+ * compacts idle instances and, given a directory, spills compacted ones to files.
+ * 
+ * @param spillDirectory Directory of the spill files (NULL to keep every instance in memory)
+ * 
+ * @return Pointer to the registry, NULL on allocation error
+ */
+MAGICRegistry MAGICregistryCreate(const char *spillDirectory);
+
+/**
+ * @brief Initializes an instance of a registry
+ * 
+ * @param r Registry
+ * @param engine Data structure backing the instance
+ * 
+ * @return Pointer to the new instance (destroyed with MAGICdestroy), NULL on error
+ */
+MAGIC MAGICregistryInit(MAGICRegistry r, enum MAGICEngine engine);
+
+/**
+ * @brief Compacts or spills the instances not used since the previous trim
+ * 
+ * An instance is used by its operations and mappings. An idle instance keeping a
+ * log (interval tree, hybrid, flat or rope engine) becomes a compact instance: its
+ * nodes go back to the pool, and it maps versions 0 and current only. A compact
+ * instance still idle at the next trim is saved to a file of the spill directory
+ * and mapped back in memory, leaving its pages to the page cache (the file is
+ * removed at once). Concurrent and journaled instances, and logs holding snapshots,
+ * are kept as they are. Chunks left in the pool are given back to the system.
+ * No registered instance may be used during the trim.
+ * 
+ * @param r Registry
+ * 
+ * @return Number of instances compacted or spilled
+ */
+size_t MAGICregistryTrim(MAGICRegistry r);
+
+/**
+ * @brief Memory held by the instances of a registry and its pool
+ * 
+ * @param r Registry
+ * 
+ * @return Number of bytes (the bytesAllocated of every instance, and the idle chunks)
+ */
+size_t MAGICregistryBytes(MAGICRegistry r);
+
+/**
+ * @brief Destroys a registry and the instances still registered
+ * 
+ * @param r Registry to destroy
+ */
+void MAGICregistryDestroy(MAGICRegistry r);
+
 /**
  * @brief Destroys the MAGIC instance
  * 
  * This function destroys and disposes of a given MAGIC instance
+ * In concurrent mode, every reader must be done first. A journal is written
+ * to the disk (not synced) and closed.
  * 
  * @param m Pointer to MAGIC instance 
  */
@@ -0,0 +1,30 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file operation.h
+ * @brief Internal representation of a bytestream operation
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * Shared by the different storage engines of the MAGIC ADT
+ *
+ */
+
+#ifndef OPERATION_H
+#define OPERATION_H
+
+#include <stdint.h>
+
+/* Enum for operation type */
+typedef enum {REMOVE=0, ADD=1} OperationType;
+
+/* One MAGICadd/MAGICremove call, as recorded by the engines */
+typedef struct {
+    int64_t pos;           // position of the operation in the current stream
+    int64_t length;        // number of bytes added or removed
+    OperationType opType;  // ADD or REMOVE
+} Operation;
+
+#endif
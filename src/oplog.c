@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "oplog.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file oplog.c
+ * \brief Implementation of the flat operation log
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * A block is skipped when the position lies before all its operations, and
+ * crossed with a single shift when the position lies after all of them even
+ * once the block's removals (additions when undoing) have moved it back.
+ * Other blocks are scanned operation by operation.
+ *
+ * Widening replaces the 32-bit position and length arrays by 64-bit ones; block
+ * summaries are 64-bit from the start (one entry per block only).
+ *
+ */
+
+/* Prototypes of static functions */
+static int opLogReserve(OpLog *log, size_t capacity);
+static int growArray(void **array, size_t bytes);
+static int opLogWiden(OpLog *log);
+static int64_t opLow(const OpLog *log, size_t i);
+static int64_t opLength(const OpLog *log, size_t i);
+static int64_t mapBlockInOut(const OpLog *log, size_t start, size_t end, int64_t pos);
+static int64_t mapBlockOutIn(const OpLog *log, size_t start, size_t end, int64_t pos);
+static int blockSummarized(const OpLog *log, size_t b, size_t end);
+static int64_t stepInOut(int64_t low, int64_t length, unsigned char opType, int64_t pos);
+static int64_t stepOutIn(int64_t low, int64_t length, unsigned char opType, int64_t pos);
+
+/* Implementation of API */
+
+OpLog *opLogCreate(void) {
+    OpLog *log = calloc(1, sizeof(OpLog));
+    if (log == NULL) {
+        printf("opLogCreate: Allocation error\n");
+        return NULL;
+    }
+
+    return log;
+}
+
+int opLogAppend(OpLog *log, int64_t low, int64_t length, OperationType opType) {
+    if (!log->wide && low + length > UINT_MAX && !opLogWiden(log))
+        return 0;
+
+    if (log->size == log->capacity) {
+        size_t capacity = (log->capacity == 0) ? LOG_BLOCK : 2 * log->capacity;
+        if (!opLogReserve(log, capacity))
+            return 0;
+    }
+
+    size_t i = log->size;
+    size_t b = i / LOG_BLOCK;
+    int64_t high = low + length;
+
+    if (log->wide) {
+        log->wideLow[i] = low;
+        log->wideLength[i] = length;
+    } else {
+        log->low[i] = (unsigned int)low;
+        log->length[i] = (unsigned int)length;
+    }
+    log->opType[i] = (unsigned char)opType;
+
+    // First operation of a block initializes its summary
+    if (i % LOG_BLOCK == 0) {
+        log->blockMin[b] = low;
+        log->blockMax[b] = high;
+        log->blockAdded[b] = 0;
+        log->blockRemoved[b] = 0;
+    }
+
+    if (low < log->blockMin[b])
+        log->blockMin[b] = low;
+    if (high > log->blockMax[b])
+        log->blockMax[b] = high;
+    if (opType == ADD) {
+        log->blockAdded[b] += length;
+    } else {
+        log->blockRemoved[b] += length;
+    }
+
+    log->size++;
+    return 1;
+}
+
+void opLogTruncate(OpLog *log, size_t size) {
+    if (log == NULL || size >= log->size)
+        return;
+
+    log->size = size;
+
+    // Summary of the last block, from the operations it keeps
+    size_t b = size / LOG_BLOCK;
+    if (size % LOG_BLOCK == 0)
+        return;
+
+    log->blockMin[b] = INT64_MAX;
+    log->blockMax[b] = 0;
+    log->blockAdded[b] = 0;
+    log->blockRemoved[b] = 0;
+    for (size_t i = b * LOG_BLOCK; i < size; i++) {
+        int64_t low = opLow(log, i), length = opLength(log, i);
+        if (low < log->blockMin[b])
+            log->blockMin[b] = low;
+        if (low + length > log->blockMax[b])
+            log->blockMax[b] = low + length;
+        if (log->opType[i] == ADD) {
+            log->blockAdded[b] += length;
+        } else {
+            log->blockRemoved[b] += length;
+        }
+    }
+}
+
+int64_t opLogMap(const OpLog *log, enum MAGICDirection direction, int64_t pos) {
+    return (log == NULL) ? -1 : opLogMapAt(log, log->size, direction, pos);
+}
+
+int64_t opLogMapAt(const OpLog *log, size_t count, enum MAGICDirection direction, int64_t pos) {
+    if (log == NULL || pos < 0)
+        return -1;
+
+    if (count > log->size)
+        count = log->size;
+    size_t nbBlocks = (count + LOG_BLOCK - 1) / LOG_BLOCK;
+
+    if (direction == STREAM_IN_OUT) {
+        for (size_t b = 0; b < nbBlocks && pos >= 0; b++) {
+            size_t end = (b + 1) * LOG_BLOCK;
+            if (end > count)
+                end = count;
+
+            // The summary of a block cut by count also covers later operations
+            if (blockSummarized(log, b, end)) {
+                if (pos < log->blockMin[b])
+                    continue; // every operation of the block lies after pos
+
+                if (pos >= log->blockMax[b] + log->blockRemoved[b]) {
+                    // pos stays after every operation of the block
+                    pos += log->blockAdded[b] - log->blockRemoved[b];
+                    continue;
+                }
+            }
+
+            pos = mapBlockInOut(log, b * LOG_BLOCK, end, pos);
+        }
+    } else {
+        for (size_t b = nbBlocks; b > 0 && pos >= 0; b--) {
+            size_t end = b * LOG_BLOCK;
+            if (end > count)
+                end = count;
+
+            if (blockSummarized(log, b - 1, end)) {
+                if (pos < log->blockMin[b - 1])
+                    continue;
+
+                if (pos >= log->blockMax[b - 1] + log->blockAdded[b - 1]) {
+                    pos += log->blockRemoved[b - 1] - log->blockAdded[b - 1];
+                    continue;
+                }
+            }
+
+            pos = mapBlockOutIn(log, (b - 1) * LOG_BLOCK, end, pos);
+        }
+    }
+
+    return pos;
+}
+
+void opLogCollect(const OpLog *log, Operation *ops) {
+    for (size_t i = 0; i < log->size; i++) {
+        ops[i].pos = opLow(log, i);
+        ops[i].length = opLength(log, i);
+        ops[i].opType = (OperationType)log->opType[i];
+    }
+}
+
+size_t opLogBytes(const OpLog *log) {
+    if (log == NULL)
+        return 0;
+
+    size_t width = log->wide ? sizeof(int64_t) : sizeof(unsigned int);
+    size_t nbBlocks = log->capacity / LOG_BLOCK;
+    return sizeof(OpLog) + log->capacity * (2 * width + sizeof(unsigned char))
+                         + nbBlocks * 4 * sizeof(int64_t);
+}
+
+void opLogDestroy(OpLog *log) {
+    if (log == NULL)
+        return;
+
+    free(log->low);
+    free(log->length);
+    free(log->wideLow);
+    free(log->wideLength);
+    free(log->opType);
+    free(log->blockMin);
+    free(log->blockMax);
+    free(log->blockAdded);
+    free(log->blockRemoved);
+    free(log);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Grow the arrays of the log (capacity is a multiple of LOG_BLOCK)
+ *
+ * @param log Log
+ * @param capacity New number of operations
+ *
+ * @return 1 on success, 0 on allocation error (the log is left unchanged)
+ */
+static int opLogReserve(OpLog *log, size_t capacity) {
+    size_t nbBlocks = capacity / LOG_BLOCK;
+
+    // Position and length arrays of the current width
+    void **low = log->wide ? (void **)&log->wideLow : (void **)&log->low;
+    void **length = log->wide ? (void **)&log->wideLength : (void **)&log->length;
+    size_t width = log->wide ? sizeof(int64_t) : sizeof(unsigned int);
+
+    // Arrays grown before a failure stay valid: only capacity says what is usable
+    if (!growArray(low, capacity * width) ||
+        !growArray(length, capacity * width) ||
+        !growArray((void **)&log->opType, capacity * sizeof(unsigned char)) ||
+        !growArray((void **)&log->blockMin, nbBlocks * sizeof(int64_t)) ||
+        !growArray((void **)&log->blockMax, nbBlocks * sizeof(int64_t)) ||
+        !growArray((void **)&log->blockAdded, nbBlocks * sizeof(int64_t)) ||
+        !growArray((void **)&log->blockRemoved, nbBlocks * sizeof(int64_t))) {
+        printf("opLogReserve: Allocation error\n");
+        return 0;
+    }
+
+    log->capacity = capacity;
+    return 1;
+}
+
+/**
+ * @brief Reallocate an array, keeping it untouched on failure
+ *
+ * @param array Pointer to the array
+ * @param bytes New size in bytes
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+static int growArray(void **array, size_t bytes) {
+    void *p = realloc(*array, bytes);
+    if (p == NULL)
+        return 0;
+
+    *array = p;
+    return 1;
+}
+
+/**
+ * @brief Move the positions and lengths to 64-bit arrays
+ *
+ * @param log Log
+ *
+ * @return 1 on success, 0 on allocation error (the log is left unchanged)
+ */
+static int opLogWiden(OpLog *log) {
+    size_t capacity = (log->capacity > 0) ? log->capacity : 1;
+    int64_t *low = malloc(capacity * sizeof(int64_t));
+    int64_t *length = malloc(capacity * sizeof(int64_t));
+    if (low == NULL || length == NULL) {
+        printf("opLogWiden: Allocation error\n");
+        free(low);
+        free(length);
+        return 0;
+    }
+
+    for (size_t i = 0; i < log->size; i++) {
+        low[i] = log->low[i];
+        length[i] = log->length[i];
+    }
+
+    free(log->low);
+    free(log->length);
+    log->low = NULL;
+    log->length = NULL;
+    log->wideLow = low;
+    log->wideLength = length;
+    log->wide = 1;
+
+    return 1;
+}
+
+/**
+ * @brief Position of an operation, whatever the width of the log
+ *
+ * @param log Log
+ * @param i Index of the operation
+ *
+ * @return int64_t position
+ */
+static int64_t opLow(const OpLog *log, size_t i) {
+    return log->wide ? log->wideLow[i] : log->low[i];
+}
+
+/**
+ * @brief Length of an operation, whatever the width of the log
+ *
+ * @param log Log
+ * @param i Index of the operation
+ *
+ * @return int64_t length
+ */
+static int64_t opLength(const OpLog *log, size_t i) {
+    return log->wide ? log->wideLength[i] : log->length[i];
+}
+
+/**
+ * @brief Whether the summary of a block describes exactly its operations before end
+ *
+ * @param log Log
+ * @param b Block
+ * @param end Past the last operation considered in the block
+ *
+ * @return 1 if the summary applies, 0 if the block must be scanned
+ */
+static int blockSummarized(const OpLog *log, size_t b, size_t end) {
+    size_t blockEnd = (b + 1) * LOG_BLOCK;
+    return end == ((blockEnd < log->size) ? blockEnd : log->size);
+}
+
+/**
+ * @brief Apply the operations [start, end) in chronological order
+ * The width test is hoisted out of the loops
+ *
+ * @param log Log
+ * @param start First operation
+ * @param end Past the last operation
+ * @param pos Position to map
+ *
+ * @return int64_t mapped position, -1 if removed
+ */
+static int64_t mapBlockInOut(const OpLog *log, size_t start, size_t end, int64_t pos) {
+    if (log->wide) {
+        for (size_t i = start; i < end && pos >= 0; i++)
+            pos = stepInOut(log->wideLow[i], log->wideLength[i], log->opType[i], pos);
+    } else {
+        for (size_t i = start; i < end && pos >= 0; i++)
+            pos = stepInOut(log->low[i], log->length[i], log->opType[i], pos);
+    }
+    return pos;
+}
+
+/**
+ * @brief Undo the operations [start, end) in reverse order
+ *
+ * @param log Log
+ * @param start First operation
+ * @param end Past the last operation
+ * @param pos Position to map
+ *
+ * @return int64_t mapped position, -1 if added
+ */
+static int64_t mapBlockOutIn(const OpLog *log, size_t start, size_t end, int64_t pos) {
+    if (log->wide) {
+        for (size_t i = end; i > start && pos >= 0; i--)
+            pos = stepOutIn(log->wideLow[i - 1], log->wideLength[i - 1], log->opType[i - 1], pos);
+    } else {
+        for (size_t i = end; i > start && pos >= 0; i--)
+            pos = stepOutIn(log->low[i - 1], log->length[i - 1], log->opType[i - 1], pos);
+    }
+    return pos;
+}
+
+/**
+ * @brief Apply one operation to a position
+ *
+ * @param low Position of the operation
+ * @param length Length of the operation
+ * @param opType Type of the operation (OperationType)
+ * @param pos Position to map
+ *
+ * @return int64_t mapped position, -1 if removed
+ */
+static int64_t stepInOut(int64_t low, int64_t length, unsigned char opType, int64_t pos) {
+    if (opType == ADD) {
+        if (low <= pos)
+            pos += length;
+    } else {
+        if (pos >= low + length)
+            pos -= length;
+        else if (pos >= low)
+            return -1;
+    }
+    return pos;
+}
+
+/**
+ * @brief Undo one operation on a position
+ *
+ * @param low Position of the operation
+ * @param length Length of the operation
+ * @param opType Type of the operation (OperationType)
+ * @param pos Position to map
+ *
+ * @return int64_t mapped position, -1 if added
+ */
+static int64_t stepOutIn(int64_t low, int64_t length, unsigned char opType, int64_t pos) {
+    if (opType == ADD) {
+        if (pos >= low + length)
+            pos -= length;
+        else if (pos >= low)
+            return -1;
+    } else {
+        if (low <= pos)
+            pos += length;
+    }
+    return pos;
+}
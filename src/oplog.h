@@ -0,0 +1,123 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file oplog.h
+ * @brief Interface of the flat operation log
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * Operations are appended to contiguous arrays (structure of arrays) in
+ * chronological order. Every block of LOG_BLOCK operations keeps a summary
+ * (minimum low, maximum high, bytes added and removed) so that MAGICmap skips or
+ * shifts over whole blocks during its linear scan.
+ *
+ * Positions and lengths are stored on 32 bits until an operation needs more; the
+ * log is then widened to 64-bit arrays once.
+ *
+ */
+
+#ifndef OPLOG_H
+#define OPLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "magic.h"
+#include "operation.h"
+
+/* Number of operations summarized by a block */
+#define LOG_BLOCK 64
+
+typedef struct opLog {
+    unsigned int *low;       // position of each operation (narrow log)
+    unsigned int *length;    // length of each operation (narrow log)
+    int64_t *wideLow;        // position of each operation (wide log)
+    int64_t *wideLength;     // length of each operation (wide log)
+    unsigned char *opType;   // type of each operation (OperationType)
+    size_t size;             // number of operations
+    size_t capacity;         // allocated number of operations
+    int wide;                // 1 once an operation did not fit in 32 bits
+
+    int64_t *blockMin;       // minimum low of each block
+    int64_t *blockMax;       // maximum high (low + length) of each block
+    int64_t *blockAdded;     // bytes added by each block
+    int64_t *blockRemoved;   // bytes removed by each block
+} OpLog;
+
+/**
+ * @brief Creates an empty log
+ *
+ * @return Pointer to the new log, NULL on allocation error
+ */
+OpLog *opLogCreate(void);
+
+/**
+ * @brief Appends an operation in amortized O(1)
+ * The first operation past 32 bits widens the log, in O(size)
+ *
+ * @param log Log
+ * @param low Position of the operation
+ * @param length Number of bytes added or removed
+ * @param opType Operation type
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+int opLogAppend(OpLog *log, int64_t low, int64_t length, OperationType opType);
+
+/**
+ * @brief Drops the operations from a given index on, in O(LOG_BLOCK)
+ *
+ * @param log Log
+ * @param size Number of operations kept
+ */
+void opLogTruncate(OpLog *log, size_t size);
+
+/**
+ * @brief Maps a position through the operations of the log
+ *
+ * @param log Log
+ * @param direction Mapping direction
+ * @param pos Position to map
+ *
+ * @return Mapped position, -1 if the position has no counterpart
+ */
+int64_t opLogMap(const OpLog *log, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Maps a position through the first operations of the log only
+ *
+ * @param log Log
+ * @param count Number of operations applied (the version)
+ * @param direction Mapping direction
+ * @param pos Position to map
+ *
+ * @return Mapped position, -1 if the position has no counterpart
+ */
+int64_t opLogMapAt(const OpLog *log, size_t count, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Copies the operations of the log, in chronological order
+ *
+ * @param log Log
+ * @param ops Output array of log->size operations
+ */
+void opLogCollect(const OpLog *log, Operation *ops);
+
+/**
+ * @brief Number of bytes allocated by a log
+ *
+ * @param log Log (may be NULL)
+ *
+ * @return Number of bytes
+ */
+size_t opLogBytes(const OpLog *log);
+
+/**
+ * @brief Destroys a log
+ *
+ * @param log Log to destroy
+ */
+void opLogDestroy(OpLog *log);
+
+#endif
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "pool.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file pool.c
+ * \brief Implementation of the work-stealing scheduler
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * The chunks left to a worker are a range [next, end) packed in a single 64-bit
+ * word, so that the owner taking the next chunk and a thief taking the end of the
+ * range are both a compare-and-swap. A thief takes the first chunk it steals and
+ * makes the rest its own range.
+ *
+ * The threads of a pool sleep between jobs; a job is posted under the pool lock
+ * with a new generation number, and the caller waits for the threads still busy.
+ *
+ */
+
+/* Size of a cache line */
+#define CACHE_LINE 64
+
+/* Chunks left to a worker, alone on its cache line */
+typedef struct {
+    uint64_t range;     // next chunk (low 32 bits) and end of the range (high 32 bits)
+    char pad[CACHE_LINE - sizeof(uint64_t)];
+} WorkQueue;
+
+/* State shared by the workers of a job */
+typedef struct {
+    WorkQueue *queues;
+    unsigned int nbWorkers;
+    PoolTask task;
+    void *context;
+} Job;
+
+/* Worker of a pool */
+typedef struct {
+    Pool *pool;
+    unsigned int id;
+    int started;        // thread running the worker was created
+} Worker;
+
+struct pool {
+    Job job;                   // current job (queues of every worker)
+    Worker *workers;
+    pthread_t *threads;
+    unsigned int nbWorkers;
+    pthread_mutex_t lock;
+    pthread_cond_t posted;     // a job was posted, or the pool is stopping
+    pthread_cond_t finished;   // the last busy thread is done with the job
+    unsigned long generation;  // number of jobs posted
+    unsigned int busy;         // threads still running the current job
+    int stopping;
+};
+
+/* Prototypes of static functions */
+static uint64_t packRange(uint32_t next, uint32_t end);
+static int takeChunk(WorkQueue *q, uint32_t *chunk);
+static int stealChunk(Job *job, unsigned int thief, uint32_t *chunk);
+static void runWorker(Worker *worker);
+static void *waitJobs(void *arg);
+
+/* Implementation of API */
+
+Pool *poolCreate(unsigned int nbWorkers) {
+    if (nbWorkers < 1)
+        nbWorkers = 1;
+
+    Pool *p = malloc(sizeof(Pool));
+    if (p == NULL) {
+        printf("poolCreate: Allocation error\n");
+        return NULL;
+    }
+
+    p->job.queues = malloc(nbWorkers * sizeof(WorkQueue));
+    p->workers = malloc(nbWorkers * sizeof(Worker));
+    p->threads = malloc(nbWorkers * sizeof(pthread_t));
+    if (p->job.queues == NULL || p->workers == NULL || p->threads == NULL) {
+        printf("poolCreate: Allocation error\n");
+        free(p->job.queues);
+        free(p->workers);
+        free(p->threads);
+        free(p);
+        return NULL;
+    }
+
+    p->job.nbWorkers = nbWorkers;
+    p->nbWorkers = nbWorkers;
+    p->generation = 0;
+    p->busy = 0;
+    p->stopping = 0;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->posted, NULL);
+    pthread_cond_init(&p->finished, NULL);
+
+    // The chunks of workers failing to start are stolen by the others
+    for (unsigned int w = 0; w < nbWorkers; w++) {
+        p->workers[w].pool = p;
+        p->workers[w].id = w;
+        p->workers[w].started = (w > 0 && pthread_create(&p->threads[w], NULL, waitJobs, &p->workers[w]) == 0);
+    }
+
+    return p;
+}
+
+unsigned int poolWorkers(const Pool *p) {
+    return (p == NULL) ? 1 : p->nbWorkers;
+}
+
+void poolExecute(Pool *p, size_t nbChunks, PoolTask task, void *context) {
+    // Single worker, or too many chunks for a range: run the chunks in order
+    if (p == NULL || p->nbWorkers <= 1 || nbChunks < 2 || nbChunks > UINT32_MAX) {
+        for (size_t c = 0; c < nbChunks; c++)
+            task(context, c, 0);
+        return;
+    }
+
+    // Even shares of consecutive chunks, the first workers taking the remainder
+    unsigned int nbWorkers = (p->nbWorkers > nbChunks) ? (unsigned int)nbChunks : p->nbWorkers;
+    size_t share = nbChunks / nbWorkers, extra = nbChunks % nbWorkers, start = 0;
+    for (unsigned int w = 0; w < p->nbWorkers; w++) {
+        size_t end = (w < nbWorkers) ? start + share + (w < extra) : start;
+        p->job.queues[w].range = packRange((uint32_t)start, (uint32_t)end);
+        start = end;
+    }
+    p->job.task = task;
+    p->job.context = context;
+
+    // Wake the threads, run with them, then wait for the last one
+    pthread_mutex_lock(&p->lock);
+    p->busy = 0;
+    for (unsigned int w = 1; w < p->nbWorkers; w++)
+        p->busy += (unsigned int)p->workers[w].started;
+    p->generation++;
+    pthread_cond_broadcast(&p->posted);
+    pthread_mutex_unlock(&p->lock);
+
+    runWorker(&p->workers[0]);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy > 0)
+        pthread_cond_wait(&p->finished, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void poolDestroy(Pool *p) {
+    if (p == NULL)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->stopping = 1;
+    pthread_cond_broadcast(&p->posted);
+    pthread_mutex_unlock(&p->lock);
+
+    for (unsigned int w = 1; w < p->nbWorkers; w++) {
+        if (p->workers[w].started)
+            pthread_join(p->threads[w], NULL);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->posted);
+    pthread_cond_destroy(&p->finished);
+    free(p->job.queues);
+    free(p->workers);
+    free(p->threads);
+    free(p);
+}
+
+void poolRun(size_t nbChunks, unsigned int nbWorkers, PoolTask task, void *context) {
+    if (nbWorkers > nbChunks)
+        nbWorkers = (unsigned int)nbChunks;
+
+    // Single worker (or allocation error): run the chunks in order
+    Pool *p = (nbWorkers > 1 && nbChunks <= UINT32_MAX) ? poolCreate(nbWorkers) : NULL;
+    poolExecute(p, nbChunks, task, context);
+    poolDestroy(p);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Pack a range of chunks in a queue word
+ *
+ * @param next First chunk left
+ * @param end End of the range
+ * @return uint64_t packed range
+ */
+static uint64_t packRange(uint32_t next, uint32_t end) {
+    return ((uint64_t)end << 32) | next;
+}
+
+/**
+ * @brief Take the next chunk of a worker's own range
+ *
+ * @param q Queue of the worker
+ * @param chunk Output: chunk taken
+ * @return 1 if a chunk was taken, 0 if the range is empty
+ */
+static int takeChunk(WorkQueue *q, uint32_t *chunk) {
+    uint64_t range = __atomic_load_n(&q->range, __ATOMIC_SEQ_CST);
+
+    for (;;) {
+        uint32_t next = (uint32_t)range, end = (uint32_t)(range >> 32);
+        if (next >= end)
+            return 0;
+
+        // On failure, range is reloaded: a thief shortened it
+        if (__atomic_compare_exchange_n(&q->range, &range, packRange(next + 1, end), 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            *chunk = next;
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Steal the second half of the chunks left to another worker
+ * The thief keeps the first stolen chunk and makes the rest its own range
+ *
+ * @param job Job
+ * @param thief Index of the stealing worker (its range is empty)
+ * @param chunk Output: chunk to run
+ * @return 1 if a chunk was stolen, 0 if every range is empty
+ */
+static int stealChunk(Job *job, unsigned int thief, uint32_t *chunk) {
+    for (unsigned int i = 1; i < job->nbWorkers; i++) {
+        WorkQueue *victim = &job->queues[(thief + i) % job->nbWorkers];
+        uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_SEQ_CST);
+
+        for (;;) {
+            uint32_t next = (uint32_t)range, end = (uint32_t)(range >> 32);
+            if (next >= end)
+                break;
+
+            uint32_t split = next + (end - next) / 2;
+            if (__atomic_compare_exchange_n(&victim->range, &range, packRange(next, split), 0,
+                                            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                // An empty range is never changed by thieves: a plain store is enough
+                __atomic_store_n(&job->queues[thief].range, packRange(split + 1, end), __ATOMIC_SEQ_CST);
+                *chunk = split;
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Run chunks until every range of the job is empty
+ *
+ * @param worker Worker
+ */
+static void runWorker(Worker *worker) {
+    Job *job = &worker->pool->job;
+    WorkQueue *own = &job->queues[worker->id];
+    uint32_t chunk;
+
+    while (takeChunk(own, &chunk) || stealChunk(job, worker->id, &chunk))
+        job->task(job->context, chunk, worker->id);
+}
+
+/**
+ * @brief Thread of a pool: run every job posted until the pool is stopping
+ *
+ * @param arg Worker of the thread
+ * @return NULL
+ */
+static void *waitJobs(void *arg) {
+    Worker *worker = arg;
+    Pool *p = worker->pool;
+    unsigned long done = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->generation == done && !p->stopping)
+            pthread_cond_wait(&p->posted, &p->lock);
+        if (p->stopping)
+            break;
+
+        done = p->generation;
+        pthread_mutex_unlock(&p->lock);
+        runWorker(worker);
+        pthread_mutex_lock(&p->lock);
+
+        if (--p->busy == 0)
+            pthread_cond_signal(&p->finished);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
@@ -0,0 +1,93 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file pool.h
+ * @brief Interface of the work-stealing scheduler running chunks of a job on threads
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * A job is cut in chunks numbered 0 to nbChunks - 1. Each worker starts with an
+ * equal share of consecutive chunks and runs them in order; a worker running out
+ * of chunks steals the second half of the chunks left to another one, so uneven
+ * chunks (clustered queries) do not leave workers idle.
+ *
+ * A pool keeps its threads between jobs, waiting on a condition variable: a job
+ * then costs a broadcast instead of creating and joining threads. poolRun starts
+ * threads for one job only.
+ *
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Task running one chunk of a job
+ *
+ * @param context Context given to poolRun
+ * @param chunk Index of the chunk
+ * @param worker Index of the worker running it (0 to nbWorkers - 1), to pick
+ *               per-worker scratch memory
+ */
+typedef void (*PoolTask)(void *context, size_t chunk, unsigned int worker);
+
+/* Workers kept between jobs */
+typedef struct pool Pool;
+
+/**
+ * @brief Creates a pool of nbWorkers workers: the caller of poolExecute and
+ * nbWorkers - 1 threads, started now and waiting for jobs
+ *
+ * @param nbWorkers Number of workers (at least 1)
+ *
+ * @return Pointer to the new pool, NULL on allocation error
+ */
+Pool *poolCreate(unsigned int nbWorkers);
+
+/**
+ * @brief Number of workers of a pool
+ *
+ * @param p Pool
+ *
+ * @return Number of workers, the calling thread included
+ */
+unsigned int poolWorkers(const Pool *p);
+
+/**
+ * @brief Runs every chunk of a job once on the workers of a pool
+ *
+ * The calling thread is worker 0. One job runs at a time: calls on the same pool
+ * must not overlap.
+ *
+ * @param p Pool
+ * @param nbChunks Number of chunks (at most UINT32_MAX)
+ * @param task Task run on every chunk
+ * @param context Context given to the task
+ */
+void poolExecute(Pool *p, size_t nbChunks, PoolTask task, void *context);
+
+/**
+ * @brief Stops the threads of a pool and destroys it
+ *
+ * @param p Pool to destroy (may be NULL)
+ */
+void poolDestroy(Pool *p);
+
+/**
+ * @brief Runs every chunk of a job once, on nbWorkers workers
+ *
+ * The calling thread is worker 0, the others are started for this job only and
+ * joined before returning (see poolCreate to keep them). If threads or memory are
+ * lacking, fewer workers (down to the calling thread alone) run the job.
+ *
+ * @param nbChunks Number of chunks (at most UINT32_MAX)
+ * @param nbWorkers Number of workers
+ * @param task Task run on every chunk
+ * @param context Context given to the task
+ */
+void poolRun(size_t nbChunks, unsigned int nbWorkers, PoolTask task, void *context);
+
+#endif
@@ -0,0 +1,608 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "rope.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file rope.c
+ * \brief Implementation of the position-keyed tree (rope)
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * The tree is a treap: nodes are ordered by output position and heap-ordered on
+ * random priorities, so split and merge run in O(log n) expected time whatever
+ * the sequence of operations. An operation splits the tree at its boundaries,
+ * then merges the parts back around the added piece (or without the removed ones).
+ * Nodes of removed pieces are recycled through a free list.
+ *
+ */
+
+/* Length of the piece standing for the (unbounded) end of the input stream */
+#define ROPE_TAIL (INT64_MAX / 4)
+
+/* First input position of a subtree without input piece */
+#define NO_INPUT INT64_MAX
+
+/* Input position of a piece of added bytes */
+#define ADDED_PIECE (-1)
+
+/* Descents of a batch in flight at once */
+#define BATCH_LANES 16
+
+/* Opaque Structure for Rope Node */
+typedef struct RNode_t RNode;
+
+struct RNode_t {
+    int64_t inStart;    // input position of the piece, ADDED_PIECE for added bytes
+    int64_t length;     // length of the piece
+    int64_t outSum;     // output length of the subtree
+    int64_t minIn;      // first input position in the subtree (NO_INPUT if none)
+    uint32_t priority;  // heap priority (random)
+    RNode *left, *right;
+};
+
+struct rope {
+    RNode *root;
+    Arena *nodes;       // memory of the nodes
+    RNode *freeList;    // recycled nodes, chained through left
+    size_t nbFree;      // number of recycled nodes
+    size_t nbNodes;     // number of nodes taken from the arena
+    uint32_t seed;      // state of the priority generator
+};
+
+/* One descent of a batch: the node of the next step and what is left to find under it */
+typedef struct {
+    size_t query;           // index of the position in the batch
+    const RNode *node;      // node of the next step (its children are prefetched)
+    int64_t pos;            // position, relative to the subtree for STREAM_OUT_IN
+    int64_t offset;         // output position of the subtree (STREAM_IN_OUT)
+} Descent;
+
+/* Prototypes of static functions */
+static int ropeReserve(Rope *r, size_t count);
+static RNode *takeNode(Rope *r, int64_t inStart, int64_t length);
+static void recycle(Rope *r, RNode *node);
+static uint32_t nextPriority(Rope *r);
+static int64_t outSum(const RNode *node);
+static int64_t minIn(const RNode *node);
+static void update(RNode *node);
+static RNode *merge(RNode *a, RNode *b);
+static void split(Rope *r, RNode *node, int64_t k, RNode **left, RNode **right);
+static void startDescent(Descent *d, const RNode *root, int64_t pos);
+static int descentStep(Descent *d, enum MAGICDirection direction, int64_t *mapped);
+static int pushPieces(const RNode *node, SegTable *t, int64_t *offset);
+static void rangeOutIn(const RNode *node, int64_t offset, int64_t pos, int64_t end, RunList *list);
+static int rangeInOut(const RNode *node, int64_t offset, int64_t pos, int64_t end, RunList *list);
+
+/* Implementation of API */
+
+size_t ropeNodeSize(void) {
+    return sizeof(RNode);
+}
+
+Rope *ropeCreate(Arena *nodes) {
+    Rope *r = malloc(sizeof(Rope));
+    if (r == NULL) {
+        printf("ropeCreate: Allocation error\n");
+        return NULL;
+    }
+
+    r->nodes = nodes;
+    r->freeList = NULL;
+    r->nbFree = 0;
+    r->nbNodes = 0;
+    r->seed = 2463534242u;
+    r->root = NULL;
+
+    // The whole input stream, unmodified
+    if (!ropeReserve(r, 1)) {
+        free(r);
+        return NULL;
+    }
+    r->root = takeNode(r, 0, ROPE_TAIL);
+
+    return r;
+}
+
+Rope *ropeFromTable(Arena *nodes, const SegTable *t) {
+    Rope *r = ropeCreate(nodes);
+    if (r == NULL)
+        return NULL;
+
+    // One input piece per segment, each after at most one piece of added bytes
+    RNode **spine = malloc(2 * t->size * sizeof(RNode *));
+    if (spine == NULL || !ropeReserve(r, 2 * t->size)) {
+        printf("ropeFromTable: Allocation error\n");
+        free(spine);
+        ropeDestroy(r);
+        return NULL;
+    }
+    recycle(r, r->root);
+
+    // Cartesian tree of the pieces in output order: its right spine is on a stack
+    RNode *root = NULL;
+    size_t depth = 0;
+    int64_t offset = 0;
+    for (size_t i = 0; i < 2 * t->size; i++) {
+        size_t segment = i / 2;
+        int64_t inStart = ADDED_PIECE;
+        int64_t length = t->outStart[segment] - offset;
+        if (i % 2 == 1) {
+            inStart = t->inStart[segment];
+            length = (segment == t->size - 1) ? ROPE_TAIL : t->length[segment];
+        }
+        if (length == 0)
+            continue;
+        offset += length;
+
+        // Nodes of lower priority go below the new one, their subtrees complete
+        RNode *node = takeNode(r, inStart, length);
+        RNode *last = NULL;
+        while (depth > 0 && spine[depth - 1]->priority < node->priority) {
+            last = spine[--depth];
+            update(last);
+        }
+        node->left = last;
+        if (depth > 0) {
+            spine[depth - 1]->right = node;
+        } else {
+            root = node;
+        }
+        spine[depth++] = node;
+    }
+
+    r->root = root;
+    while (depth > 0)
+        update(spine[--depth]);
+
+    free(spine);
+    return r;
+}
+
+int ropeAdd(Rope *r, int64_t pos, int64_t length) {
+    // One node for the added piece, one if pos splits a piece
+    if (!ropeReserve(r, 2))
+        return 0;
+
+    RNode *left, *right;
+    split(r, r->root, pos, &left, &right);
+    r->root = merge(merge(left, takeNode(r, ADDED_PIECE, length)), right);
+
+    return 1;
+}
+
+int ropeRemove(Rope *r, int64_t pos, int64_t length) {
+    // One node for each boundary falling inside a piece
+    if (!ropeReserve(r, 2))
+        return 0;
+
+    RNode *left, *middle, *right;
+    split(r, r->root, pos, &left, &right);
+    split(r, right, length, &middle, &right);
+    recycle(r, middle);
+    r->root = merge(left, right);
+
+    return 1;
+}
+
+int64_t ropeMap(const Rope *r, enum MAGICDirection direction, int64_t pos) {
+    if (r == NULL || pos < 0)
+        return -1;
+
+    Descent d;
+    int64_t mapped;
+    startDescent(&d, r->root, pos);
+    while (!descentStep(&d, direction, &mapped))
+        ;
+    return mapped;
+}
+
+void ropeMapBatch(const Rope *r, enum MAGICDirection direction, const int *in, int *out, size_t n) {
+    Descent lanes[BATCH_LANES];
+    size_t active = 0, next = 0;
+
+    for (;;) {
+        // Idle lanes start the next positions at the root
+        while (active < BATCH_LANES && next < n) {
+            if (in[next] < 0) {
+                out[next++] = -1;
+                continue;
+            }
+            lanes[active].query = next;
+            startDescent(&lanes[active++], r->root, in[next++]);
+        }
+        if (active == 0)
+            return;
+
+        // One level of every descent; a finished one gives its lane to the last
+        for (size_t i = 0; i < active; ) {
+            int64_t mapped;
+            if (!descentStep(&lanes[i], direction, &mapped)) {
+                i++;
+                continue;
+            }
+            out[lanes[i].query] = (mapped > INT_MAX) ? -1 : (int)mapped;
+            lanes[i] = lanes[--active];
+        }
+    }
+}
+
+void ropeMapRange(const Rope *r, enum MAGICDirection direction, int64_t pos, int64_t length, RunList *list) {
+    if (direction == STREAM_OUT_IN) {
+        rangeOutIn(r->root, 0, pos, pos + length, list);
+    } else {
+        rangeInOut(r->root, 0, pos, pos + length, list);
+    }
+}
+
+SegTable *ropeToTable(const Rope *r) {
+    SegTable *t = segTableAlloc(64);
+    if (t == NULL)
+        return NULL;
+
+    int64_t offset = 0;
+    if (!pushPieces(r->root, t, &offset)) {
+        segTableDestroy(t);
+        return NULL;
+    }
+
+    // The last input piece is the end of the stream
+    t->length[t->size - 1] = SEG_INFINITE;
+    return t;
+}
+
+size_t ropePieces(const Rope *r) {
+    return (r == NULL) ? 0 : r->nbNodes - r->nbFree;
+}
+
+void ropeDestroy(Rope *r) {
+    free(r);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Make sure the free list holds enough nodes for an operation
+ *
+ * @param r Rope
+ * @param count Number of nodes needed
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+static int ropeReserve(Rope *r, size_t count) {
+    while (r->nbFree < count) {
+        RNode *node = arenaAlloc(r->nodes);
+        if (node == NULL) {
+            printf("ropeReserve: Allocation error\n");
+            return 0;
+        }
+        node->left = r->freeList;
+        r->freeList = node;
+        r->nbFree++;
+        r->nbNodes++;
+    }
+    return 1;
+}
+
+/**
+ * @brief Take a node from the free list (reserved beforehand)
+ *
+ * @param r Rope
+ * @param inStart input position of the piece, ADDED_PIECE for added bytes
+ * @param length length of the piece
+ *
+ * @return RNode* the initialized single node
+ */
+static RNode *takeNode(Rope *r, int64_t inStart, int64_t length) {
+    RNode *node = r->freeList;
+    r->freeList = node->left;
+    r->nbFree--;
+
+    node->inStart = inStart;
+    node->length = length;
+    node->priority = nextPriority(r);
+    node->left = NULL;
+    node->right = NULL;
+    update(node);
+
+    return node;
+}
+
+/**
+ * @brief Give the nodes of a subtree back to the free list
+ *
+ * @param r Rope
+ * @param node Root of the subtree
+ */
+static void recycle(Rope *r, RNode *node) {
+    if (node == NULL)
+        return;
+
+    recycle(r, node->left);
+    recycle(r, node->right);
+
+    node->left = r->freeList;
+    r->freeList = node;
+    r->nbFree++;
+}
+
+/**
+ * @brief Next random priority (xorshift32)
+ *
+ * @param r Rope
+ *
+ * @return uint32_t priority
+ */
+static uint32_t nextPriority(Rope *r) {
+    uint32_t x = r->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    r->seed = x;
+    return x;
+}
+
+/**
+ * @brief Start a descent at the root, prefetching its children
+ *
+ * @param d Descent
+ * @param root Root of the rope
+ * @param pos Position to map (non-negative)
+ */
+static void startDescent(Descent *d, const RNode *root, int64_t pos) {
+    d->node = root;
+    d->pos = pos;
+    d->offset = 0;
+    __builtin_prefetch(root->left);
+    __builtin_prefetch(root->right);
+}
+
+/**
+ * @brief Descend one level: decide from the node and the summary of a child
+ * The children of the next node are prefetched for the next step
+ *
+ * @param d Descent
+ * @param direction Mapping direction
+ * @param mapped Output: mapped position, -1 if none (once the descent is over)
+ *
+ * @return 1 once the descent is over, 0 otherwise
+ */
+static int descentStep(Descent *d, enum MAGICDirection direction, int64_t *mapped) {
+    const RNode *node = d->node;
+
+    if (direction == STREAM_OUT_IN) {
+        // Descend on output lengths to the piece holding pos
+        int64_t leftSum = outSum(node->left);
+        if (d->pos < leftSum) {
+            node = node->left;
+        } else if (d->pos < leftSum + node->length) {
+            *mapped = (node->inStart == ADDED_PIECE) ? -1 : node->inStart + (d->pos - leftSum);
+            return 1;
+        } else {
+            d->pos -= leftSum + node->length;
+            node = node->right;
+        }
+    } else {
+        // Input pieces are sorted on inStart: descend to the last one starting at or before pos
+        if (minIn(node->right) <= d->pos) {
+            d->offset += outSum(node->left) + node->length;
+            node = node->right;
+        } else if (node->inStart != ADDED_PIECE && node->inStart <= d->pos) {
+            // Past the end of the piece, pos was removed
+            int64_t delta = d->pos - node->inStart;
+            *mapped = (delta >= node->length) ? -1 : d->offset + outSum(node->left) + delta;
+            return 1;
+        } else {
+            node = node->left;
+        }
+    }
+
+    if (node == NULL) {
+        *mapped = -1;
+        return 1;
+    }
+    d->node = node;
+    __builtin_prefetch(node->left);
+    __builtin_prefetch(node->right);
+    return 0;
+}
+
+/**
+ * @brief Output length of a subtree
+ *
+ * @param node Root of the subtree
+ *
+ * @return int64_t length (0 for an empty subtree)
+ */
+static int64_t outSum(const RNode *node) {
+    return (node == NULL) ? 0 : node->outSum;
+}
+
+/**
+ * @brief First input position of a subtree
+ *
+ * @param node Root of the subtree
+ *
+ * @return int64_t position, NO_INPUT if the subtree holds no input piece
+ */
+static int64_t minIn(const RNode *node) {
+    return (node == NULL) ? NO_INPUT : node->minIn;
+}
+
+/**
+ * @brief Recompute the subtree summaries of a node from its children
+ *
+ * @param node Node to update
+ */
+static void update(RNode *node) {
+    node->outSum = outSum(node->left) + node->length + outSum(node->right);
+
+    // In-order, the first input piece is in the left subtree, else the node, else the right
+    if (node->left != NULL && node->left->minIn != NO_INPUT) {
+        node->minIn = node->left->minIn;
+    } else if (node->inStart != ADDED_PIECE) {
+        node->minIn = node->inStart;
+    } else {
+        node->minIn = minIn(node->right);
+    }
+}
+
+/**
+ * @brief Concatenate two trees (all of a before all of b)
+ *
+ * @param a First tree
+ * @param b Second tree
+ *
+ * @return RNode* root of the merged tree
+ */
+static RNode *merge(RNode *a, RNode *b) {
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+
+    if (a->priority > b->priority) {
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    }
+
+    b->left = merge(a, b->left);
+    update(b);
+    return b;
+}
+
+/**
+ * @brief Split a tree after its first k output bytes, cutting a piece if needed
+ *
+ * @param r Rope (provides the node of a cut piece, reserved beforehand)
+ * @param node Root of the tree to split
+ * @param k Number of output bytes going to the left tree
+ * @param left Output: first k bytes
+ * @param right Output: remaining bytes
+ */
+static void split(Rope *r, RNode *node, int64_t k, RNode **left, RNode **right) {
+    if (node == NULL) {
+        *left = NULL;
+        *right = NULL;
+        return;
+    }
+
+    int64_t leftSum = outSum(node->left);
+
+    if (k <= leftSum) {
+        split(r, node->left, k, left, &node->left);
+        update(node);
+        *right = node;
+    } else if (k >= leftSum + node->length) {
+        split(r, node->right, k - leftSum - node->length, &node->right, right);
+        update(node);
+        *left = node;
+    } else {
+        // k falls inside the piece: its end becomes a new node, first of the right tree
+        int64_t cut = k - leftSum;
+        int64_t inStart = (node->inStart == ADDED_PIECE) ? ADDED_PIECE : node->inStart + cut;
+        RNode *tail = takeNode(r, inStart, node->length - cut);
+
+        *right = merge(tail, node->right);
+        node->length = cut;
+        node->right = NULL;
+        update(node);
+        *left = node;
+    }
+}
+
+/**
+ * @brief Push the input pieces of a subtree as segments, in output order
+ *
+ * @param node Root of the subtree
+ * @param t Table
+ * @param offset Output position of the subtree, advanced past it
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+static int pushPieces(const RNode *node, SegTable *t, int64_t *offset) {
+    if (node == NULL)
+        return 1;
+
+    if (!pushPieces(node->left, t, offset))
+        return 0;
+
+    if (node->inStart != ADDED_PIECE && !segTablePush(t, node->inStart, *offset, node->length))
+        return 0;
+    *offset += node->length;
+
+    return pushPieces(node->right, t, offset);
+}
+
+/**
+ * @brief Emit the input runs of the pieces overlapping an output range, in order
+ *
+ * @param node Root of the subtree
+ * @param offset Output position of the subtree
+ * @param pos First output position of the range
+ * @param end Past the last output position of the range
+ * @param list Runs found
+ */
+static void rangeOutIn(const RNode *node, int64_t offset, int64_t pos, int64_t end, RunList *list) {
+    if (node == NULL || offset >= end || offset + node->outSum <= pos)
+        return; // subtree outside the range
+
+    rangeOutIn(node->left, offset, pos, end, list);
+
+    int64_t start = offset + outSum(node->left);
+    if (node->inStart != ADDED_PIECE) {
+        int64_t low = (start > pos) ? start : pos;
+        int64_t high = (start + node->length < end) ? start + node->length : end;
+        if (low < high)
+            runListPush(list, low, node->inStart + (low - start), high - low);
+    }
+
+    rangeOutIn(node->right, start + node->length, pos, end, list);
+}
+
+/**
+ * @brief Emit the output runs of the input pieces overlapping an input range, in order
+ * Input pieces are sorted on inStart: a piece starting at or before pos ends
+ * every piece before it, and the walk stops at the first piece past the range
+ *
+ * @param node Root of the subtree
+ * @param offset Output position of the subtree
+ * @param pos First input position of the range
+ * @param end Past the last input position of the range
+ * @param list Runs found
+ *
+ * @return 0 once a piece past the range is reached, 1 otherwise
+ */
+static int rangeInOut(const RNode *node, int64_t offset, int64_t pos, int64_t end, RunList *list) {
+    if (node == NULL || node->minIn == NO_INPUT)
+        return 1; // only added bytes
+    if (node->minIn >= end)
+        return 0;
+
+    int64_t start = offset + outSum(node->left);
+
+    // The node and its left subtree end before pos when the right subtree starts before it
+    if (minIn(node->right) > pos) {
+        int ownStartBefore = (node->inStart != ADDED_PIECE && node->inStart <= pos);
+        if (!ownStartBefore && !rangeInOut(node->left, offset, pos, end, list))
+            return 0;
+
+        if (node->inStart != ADDED_PIECE) {
+            if (node->inStart >= end)
+                return 0;
+
+            int64_t low = (node->inStart > pos) ? node->inStart : pos;
+            int64_t high = (node->inStart + node->length < end) ? node->inStart + node->length : end;
+            if (low < high)
+                runListPush(list, low, start + (low - node->inStart), high - low);
+        }
+    }
+
+    return rangeInOut(node->right, start + node->length, pos, end, list);
+}
@@ -0,0 +1,140 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file rope.h
+ * @brief Interface of the position-keyed tree (rope) describing the output stream
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * The output stream is a sequence of pieces, either a run of input bytes or a run
+ * of added bytes, stored in a balanced tree keyed by output position. Every node
+ * keeps the output length and the first input position of its subtree, so both
+ * mapping directions are a single root-to-leaf descent, and operations split and
+ * join pieces in O(log n).
+ *
+ */
+
+#ifndef ROPE_H
+#define ROPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "magic.h"
+#include "arena.h"
+#include "segtable.h"
+
+typedef struct rope Rope;
+
+/**
+ * @brief Size of a node, for the arena holding them
+ *
+ * @return Size in bytes
+ */
+size_t ropeNodeSize(void);
+
+/**
+ * @brief Creates the rope of an unmodified stream
+ *
+ * @param nodes Arena of ropeNodeSize() objects holding the nodes (owned by the caller)
+ *
+ * @return Pointer to the new rope, NULL on allocation error
+ */
+Rope *ropeCreate(Arena *nodes);
+
+/**
+ * @brief Creates the rope of the stream a segment table describes, in O(n)
+ *
+ * @param nodes Arena of ropeNodeSize() objects holding the nodes (owned by the caller)
+ * @param t Segment table
+ *
+ * @return Pointer to the new rope, NULL on allocation error
+ */
+Rope *ropeFromTable(Arena *nodes, const SegTable *t);
+
+/**
+ * @brief Adds bytes to the output stream
+ *
+ * @param r Rope
+ * @param pos Position of the first added byte
+ * @param length Number of bytes added
+ *
+ * @return 1 on success, 0 on allocation error (the rope is left unchanged)
+ */
+int ropeAdd(Rope *r, int64_t pos, int64_t length);
+
+/**
+ * @brief Removes bytes from the output stream
+ *
+ * @param r Rope
+ * @param pos Position of the first removed byte
+ * @param length Number of bytes removed
+ *
+ * @return 1 on success, 0 on allocation error (the rope is left unchanged)
+ */
+int ropeRemove(Rope *r, int64_t pos, int64_t length);
+
+/**
+ * @brief Maps a position with a single descent
+ *
+ * @param r Rope
+ * @param direction Mapping direction
+ * @param pos Position to map
+ *
+ * @return Mapped position, -1 if the position has no counterpart
+ */
+int64_t ropeMap(const Rope *r, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Maps a batch of positions, descending for several of them at a time
+ *
+ * A step of a descent reads a node whose children were prefetched by the previous
+ * step, while the steps of the other descents run: their cache misses overlap.
+ * Positions are mapped in any order, sorted or not.
+ *
+ * @param r Rope
+ * @param direction Mapping direction
+ * @param in Positions to map (negative ones map to -1)
+ * @param out Mapped positions, -1 if none or past INT_MAX (may be in)
+ * @param n Number of positions
+ */
+void ropeMapBatch(const Rope *r, enum MAGICDirection direction, const int *in, int *out, size_t n);
+
+/**
+ * @brief Maps a range, run by run, visiting only the pieces it covers
+ *
+ * @param r Rope
+ * @param direction Mapping direction
+ * @param pos First position of the range
+ * @param length Length of the range
+ * @param list Runs the range becomes, appended in order
+ */
+void ropeMapRange(const Rope *r, enum MAGICDirection direction, int64_t pos, int64_t length, RunList *list);
+
+/**
+ * @brief Builds the segment table of the rope with an in-order walk, in O(n)
+ *
+ * @param r Rope
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *ropeToTable(const Rope *r);
+
+/**
+ * @brief Number of pieces of the output stream
+ *
+ * @param r Rope
+ *
+ * @return Number of pieces (nodes in the tree)
+ */
+size_t ropePieces(const Rope *r);
+
+/**
+ * @brief Destroys a rope (its nodes are released with their arena)
+ *
+ * @param r Rope to destroy
+ */
+void ropeDestroy(Rope *r);
+
+#endif
@@ -0,0 +1,668 @@
+#define _DEFAULT_SOURCE  // mmap, fstat, fsync
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "segtable.h"
+
+/* Images are mapped where mmap exists, read in memory elsewhere */
+#if defined(__unix__) || defined(__APPLE__)
+#define SEG_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file segtable.c
+ * \brief Implementation of the compacted segment table
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ * Operations are folded by composition: a single operation is a table of at most
+ * two segments, and two tables are composed with a linear merge on the intermediate
+ * stream. A sequence of n operations is folded by divide and conquer in O(n log n).
+ *
+ * A file image is an ImageHeader followed by the inStart, outStart and length
+ * arrays, in the byte order of the machine (8-byte aligned, no pointer)
+ *
+ */
+
+/* Identification of a file image */
+#define IMAGE_MAGIC "MAGICSEG"
+#define IMAGE_FORMAT 1
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+/* Header of a file image */
+typedef struct {
+    char magic[8];          // IMAGE_MAGIC
+    uint32_t format;        // IMAGE_FORMAT
+    uint32_t byteOrder;     // IMAGE_BYTE_ORDER as written by the machine saving the image
+    uint64_t size;          // number of segments
+    uint64_t version;       // number of operations folded in the table
+} ImageHeader;
+
+/* Prototypes of static functions */
+static void segTableAppend(SegTable *t, int64_t inStart, int64_t outStart, int64_t length);
+static int64_t segEnd(int64_t start, int64_t length);
+static SegTable *segTableFromOp(const Operation *op);
+static SegTable *buildRange(const Operation *ops, size_t n);
+static int checkHeader(const ImageHeader *header, const char *path);
+static int writeImage(const SegTable *t, size_t version, FILE *file);
+static int syncFile(FILE *file);
+
+/* Implementation of API */
+
+SegTable *segTableCreate(void) {
+    SegTable *t = segTableAlloc(1);
+    if (t == NULL)
+        return NULL;
+
+    segTableAppend(t, 0, 0, SEG_INFINITE);
+    return t;
+}
+
+SegTable *segTableAlloc(size_t capacity) {
+    SegTable *t = malloc(sizeof(SegTable));
+    if (t == NULL) {
+        printf("segTableAlloc: Allocation error\n");
+        return NULL;
+    }
+
+    if (capacity == 0)
+        capacity = 1;
+
+    t->refs = 1;
+    t->mapping = NULL;
+    t->mappingBytes = 0;
+    t->inStart = malloc(capacity * sizeof(int64_t));
+    t->outStart = malloc(capacity * sizeof(int64_t));
+    t->length = malloc(capacity * sizeof(int64_t));
+    if (t->inStart == NULL || t->outStart == NULL || t->length == NULL) {
+        printf("segTableAlloc: Allocation error\n");
+        segTableDestroy(t);
+        return NULL;
+    }
+
+    t->size = 0;
+    t->capacity = capacity;
+
+    return t;
+}
+
+int segTablePush(SegTable *t, int64_t inStart, int64_t outStart, int64_t length) {
+    if (t->size == t->capacity) {
+        size_t capacity = 2 * t->capacity;
+        int64_t *in = realloc(t->inStart, capacity * sizeof(int64_t));
+        if (in != NULL)
+            t->inStart = in;
+        int64_t *out = realloc(t->outStart, capacity * sizeof(int64_t));
+        if (out != NULL)
+            t->outStart = out;
+        int64_t *len = realloc(t->length, capacity * sizeof(int64_t));
+        if (len != NULL)
+            t->length = len;
+
+        if (in == NULL || out == NULL || len == NULL) {
+            printf("segTablePush: Allocation error\n");
+            return 0;
+        }
+        t->capacity = capacity;
+    }
+
+    segTableAppend(t, inStart, outStart, length);
+    return 1;
+}
+
+SegTable *segTableFromOps(const Operation *ops, size_t n) {
+    if (n == 0 || ops == NULL)
+        return segTableCreate();
+
+    return buildRange(ops, n);
+}
+
+SegTable *segTableCompose(const SegTable *a, const SegTable *b) {
+    if (a == NULL || b == NULL)
+        return NULL;
+
+    SegTable *t = segTableAlloc(a->size + b->size);
+    if (t == NULL)
+        return NULL;
+
+    // Both tables are sorted on the intermediate stream (outStart of a, inStart of b):
+    // walk them together and emit every overlap
+    size_t i = 0, j = 0;
+    while (i < a->size && j < b->size) {
+        int64_t aLow = a->outStart[i];
+        int64_t aHigh = segEnd(aLow, a->length[i]);
+        int64_t bLow = b->inStart[j];
+        int64_t bHigh = segEnd(bLow, b->length[j]);
+
+        int64_t low = aLow > bLow ? aLow : bLow;
+        int64_t high = aHigh < bHigh ? aHigh : bHigh;
+
+        if (low < high) {
+            int64_t length = (high == SEG_INFINITE) ? SEG_INFINITE : high - low;
+            segTableAppend(t, a->inStart[i] + (low - aLow), b->outStart[j] + (low - bLow), length);
+        }
+
+        // Advance the segment(s) ending first
+        if (aHigh < bHigh) {
+            i++;
+        } else if (bHigh < aHigh) {
+            j++;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    return t;
+}
+
+SegTable *segTableInvert(const SegTable *t) {
+    if (t == NULL)
+        return NULL;
+
+    SegTable *inverse = segTableAlloc(t->size);
+    if (inverse == NULL)
+        return NULL;
+
+    memcpy(inverse->inStart, t->outStart, t->size * sizeof(int64_t));
+    memcpy(inverse->outStart, t->inStart, t->size * sizeof(int64_t));
+    memcpy(inverse->length, t->length, t->size * sizeof(int64_t));
+    inverse->size = t->size;
+
+    return inverse;
+}
+
+int64_t segTableMap(const SegTable *t, enum MAGICDirection direction, int64_t pos) {
+    if (t == NULL || pos < 0)
+        return -1;
+
+    const int64_t *from = (direction == STREAM_IN_OUT) ? t->inStart : t->outStart;
+    const int64_t *to = (direction == STREAM_IN_OUT) ? t->outStart : t->inStart;
+
+    // Binary search for the last segment starting at or before pos
+    size_t low = 0, high = t->size;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (from[mid] <= pos) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == 0)
+        return -1; // pos lies before the first surviving segment
+
+    size_t i = low - 1;
+    if (pos - from[i] >= t->length[i])
+        return -1; // pos falls in a hole (removed or added bytes)
+
+    return to[i] + (pos - from[i]);
+}
+
+size_t segTableSeek(const SegTable *t, enum MAGICDirection direction, int64_t pos, size_t hint) {
+    const int64_t *from = (direction == STREAM_IN_OUT) ? t->inStart : t->outStart;
+
+    if (hint >= t->size || from[hint] > pos) {
+        if (from[0] > pos)
+            return t->size; // pos lies before the first segment
+        hint = 0;
+    }
+
+    // Gallop: double the step until overshooting pos
+    size_t low = hint, step = 1;
+    while (low + step < t->size && from[low + step] <= pos) {
+        low += step;
+        step *= 2;
+    }
+
+    // Binary search in (low, low + step]
+    size_t high = (low + step < t->size) ? low + step : t->size;
+    while (high - low > 1) {
+        size_t mid = low + (high - low) / 2;
+        if (from[mid] <= pos) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+void segTableMapSorted(const SegTable *t, enum MAGICDirection direction, const int *in, int *out, size_t n) {
+    const int64_t *from = (direction == STREAM_IN_OUT) ? t->inStart : t->outStart;
+    const int64_t *to = (direction == STREAM_IN_OUT) ? t->outStart : t->inStart;
+    size_t i = 0; // segment reached by the sweep
+
+    for (size_t q = 0; q < n; q++) {
+        int64_t pos = in[q];
+        if (pos < 0) {
+            out[q] = -1;
+            continue;
+        }
+
+        size_t found = segTableSeek(t, direction, pos, i);
+        if (found == t->size) {
+            out[q] = -1; // before the first segment
+            continue;
+        }
+
+        i = found;
+        int64_t mapped = to[i] + (pos - from[i]);
+        if (pos - from[i] >= t->length[i] || mapped > INT_MAX) {
+            out[q] = -1; // pos falls in a hole, or past the int range
+        } else {
+            out[q] = (int)mapped;
+        }
+    }
+}
+
+void segTableMapRange(const SegTable *t, enum MAGICDirection direction, int64_t pos, int64_t length, RunList *list) {
+    const int64_t *from = (direction == STREAM_IN_OUT) ? t->inStart : t->outStart;
+    const int64_t *to = (direction == STREAM_IN_OUT) ? t->outStart : t->inStart;
+    int64_t end = pos + length;
+
+    size_t i = segTableSeek(t, direction, pos, 0);
+    if (i == t->size)
+        i = 0; // the range starts before the first segment
+
+    // Segments are sorted on both streams: the overlapping ones are consecutive
+    for (; i < t->size && from[i] < end; i++) {
+        int64_t low = (from[i] > pos) ? from[i] : pos;
+        int64_t high = segEnd(from[i], t->length[i]);
+        if (high > end)
+            high = end;
+
+        if (low < high)
+            runListPush(list, low, to[i] + (low - from[i]), high - low);
+    }
+}
+
+void runListPush(RunList *list, int64_t pos, int64_t mapped, int64_t length) {
+    MAGICrun *last = &list->last;
+
+    if (list->count > 0 && last->pos + last->length == pos && last->mapped + last->length == mapped) {
+        last->length += length;
+        if (list->count <= list->maxRuns)
+            list->runs[list->count - 1].length = last->length;
+        return;
+    }
+
+    last->pos = pos;
+    last->mapped = mapped;
+    last->length = length;
+    if (list->count < list->maxRuns)
+        list->runs[list->count] = *last;
+    list->count++;
+}
+
+int segTableSave(const SegTable *t, size_t version, const char *path, int durable) {
+    if (t == NULL || path == NULL)
+        return 0;
+
+    char *tmp = malloc(strlen(path) + 5);
+    if (tmp == NULL) {
+        printf("segTableSave: Allocation error\n");
+        return 0;
+    }
+    strcpy(tmp, path);
+    strcat(tmp, ".tmp");
+
+    FILE *file = fopen(tmp, "wb");
+    if (file == NULL) {
+        printf("segTableSave: Cannot create %s\n", tmp);
+        free(tmp);
+        return 0;
+    }
+
+    // The image reaches the disk before it replaces the old one, and the rename
+    // before the caller relies on it (a checkpoint resets its journal next)
+    int written = writeImage(t, version, file) && (!durable || syncFile(file));
+    if (fclose(file) != 0)
+        written = 0;
+
+    if (!written || rename(tmp, path) != 0) {
+        printf("segTableSave: Cannot write %s\n", path);
+        remove(tmp);
+        free(tmp);
+        return 0;
+    }
+    free(tmp);
+
+    if (durable && !segTableSyncDirectory(path)) {
+        printf("segTableSave: Cannot sync the directory of %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+int segTableSyncDirectory(const char *path) {
+#ifdef SEG_MMAP
+    const char *slash = strrchr(path, '/');
+    size_t length = (slash == NULL) ? 1 : (size_t)(slash - path) + 1;
+    char *directory = malloc(length + 1);
+    if (directory == NULL) {
+        printf("segTableSyncDirectory: Allocation error\n");
+        return 0;
+    }
+    if (slash == NULL) {
+        strcpy(directory, ".");
+    } else {
+        memcpy(directory, path, length);
+        directory[length] = '\0';
+    }
+
+    int fd = open(directory, O_RDONLY);
+    free(directory);
+    if (fd < 0)
+        return 0;
+    int synced = (fsync(fd) == 0);
+    close(fd);
+    return synced;
+#else
+    (void)path;
+    return 1;
+#endif
+}
+
+SegTable *segTableOpenMapped(const char *path, size_t *version) {
+    if (path == NULL)
+        return NULL;
+
+#ifdef SEG_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("segTableOpenMapped: Cannot open %s\n", path);
+        return NULL;
+    }
+
+    struct stat st;
+    ImageHeader header;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader) ||
+        read(fd, &header, sizeof(ImageHeader)) != sizeof(ImageHeader) || !checkHeader(&header, path)) {
+        close(fd);
+        return NULL;
+    }
+
+    // The arrays must fill the rest of the file exactly
+    size_t bytes = (size_t)st.st_size;
+    if (header.size > (bytes - sizeof(ImageHeader)) / (3 * sizeof(int64_t)) ||
+        sizeof(ImageHeader) + header.size * 3 * sizeof(int64_t) != bytes) {
+        printf("segTableOpenMapped: Truncated image %s\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // Shared and read-only: every process uses the same page cache copy
+    void *image = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        printf("segTableOpenMapped: Cannot map %s\n", path);
+        return NULL;
+    }
+
+    SegTable *t = malloc(sizeof(SegTable));
+    if (t == NULL) {
+        printf("segTableOpenMapped: Allocation error\n");
+        munmap(image, bytes);
+        return NULL;
+    }
+
+    t->inStart = (int64_t *)((char *)image + sizeof(ImageHeader));
+    t->outStart = t->inStart + header.size;
+    t->length = t->outStart + header.size;
+    t->size = header.size;
+    t->capacity = header.size;
+    t->refs = 1;
+    t->mapping = image;
+    t->mappingBytes = bytes;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("segTableOpenMapped: Cannot open %s\n", path);
+        return NULL;
+    }
+
+    ImageHeader header;
+    if (fread(&header, sizeof(ImageHeader), 1, file) != 1 || !checkHeader(&header, path)) {
+        fclose(file);
+        return NULL;
+    }
+
+    // The arrays must fill the rest of the file exactly (before allocating them)
+    long end = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+    size_t bytes = (end < 0) ? 0 : (size_t)end;
+    if (bytes < sizeof(ImageHeader) ||
+        header.size > (bytes - sizeof(ImageHeader)) / (3 * sizeof(int64_t)) ||
+        sizeof(ImageHeader) + header.size * 3 * sizeof(int64_t) != bytes ||
+        fseek(file, (long)sizeof(ImageHeader), SEEK_SET) != 0) {
+        printf("segTableOpenMapped: Truncated image %s\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    SegTable *t = segTableAlloc(header.size);
+    if (t == NULL) {
+        fclose(file);
+        return NULL;
+    }
+
+    t->size = header.size;
+    if (fread(t->inStart, sizeof(int64_t), t->size, file) != t->size ||
+        fread(t->outStart, sizeof(int64_t), t->size, file) != t->size ||
+        fread(t->length, sizeof(int64_t), t->size, file) != t->size) {
+        printf("segTableOpenMapped: Truncated image %s\n", path);
+        segTableDestroy(t);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+#endif
+
+    // Searches rely on the unbounded last segment
+    if (t->length[t->size - 1] != SEG_INFINITE) {
+        printf("segTableOpenMapped: Corrupted image %s\n", path);
+        segTableDestroy(t);
+        return NULL;
+    }
+
+    if (version != NULL)
+        *version = (size_t)header.version;
+    return t;
+}
+
+SegTable *segTableRetain(SegTable *t) {
+    if (t != NULL)
+        t->refs++;
+    return t;
+}
+
+void segTableDestroy(SegTable *t) {
+    if (t == NULL || --t->refs > 0)
+        return;
+
+#ifdef SEG_MMAP
+    if (t->mapping != NULL) {
+        munmap(t->mapping, t->mappingBytes);
+        free(t);
+        return;
+    }
+#endif
+
+    free(t->inStart);
+    free(t->outStart);
+    free(t->length);
+    free(t);
+}
+
+
+/* Static Functions Implementation */
+
+/**
+ * @brief Append a segment, merging it with the previous one when both are contiguous
+ * The caller guarantees the capacity
+ *
+ * @param t Table
+ * @param inStart start in the input stream
+ * @param outStart start in the output stream
+ * @param length length of the segment
+ */
+static void segTableAppend(SegTable *t, int64_t inStart, int64_t outStart, int64_t length) {
+    if (t->size > 0) {
+        size_t last = t->size - 1;
+        int64_t lastLength = t->length[last];
+
+        // Contiguous on both sides: extend the previous segment
+        if (lastLength != SEG_INFINITE &&
+            t->inStart[last] + lastLength == inStart &&
+            t->outStart[last] + lastLength == outStart) {
+            t->length[last] = (length == SEG_INFINITE) ? SEG_INFINITE : lastLength + length;
+            return;
+        }
+    }
+
+    t->inStart[t->size] = inStart;
+    t->outStart[t->size] = outStart;
+    t->length[t->size] = length;
+    t->size++;
+}
+
+/**
+ * @brief End of a segment, saturating for the unbounded one
+ *
+ * @param start start of the segment
+ * @param length length of the segment
+ *
+ * @return int64_t exclusive end of the segment
+ */
+static int64_t segEnd(int64_t start, int64_t length) {
+    return (length == SEG_INFINITE) ? SEG_INFINITE : start + length;
+}
+
+/**
+ * @brief Build the table of a single operation
+ *
+ * @param op Operation
+ *
+ * @return SegTable* the new table, NULL on allocation error
+ */
+static SegTable *segTableFromOp(const Operation *op) {
+    SegTable *t = segTableAlloc(2);
+    if (t == NULL)
+        return NULL;
+
+    // Bytes before the operation are untouched
+    if (op->pos > 0)
+        segTableAppend(t, 0, 0, op->pos);
+
+    if (op->opType == ADD) {
+        // Bytes after the insertion point are shifted forward
+        segTableAppend(t, op->pos, op->pos + op->length, SEG_INFINITE);
+    } else {
+        // Bytes after the removed range are shifted backward
+        segTableAppend(t, op->pos + op->length, op->pos, SEG_INFINITE);
+    }
+
+    return t;
+}
+
+/**
+ * @brief Fold a range of operations by divide and conquer
+ *
+ * @param ops Operations in chronological order
+ * @param n Number of operations (> 0)
+ *
+ * @return SegTable* the new table, NULL on allocation error
+ */
+static SegTable *buildRange(const Operation *ops, size_t n) {
+    if (n == 1)
+        return segTableFromOp(ops);
+
+    size_t half = n / 2;
+    SegTable *first = buildRange(ops, half);
+    SegTable *second = buildRange(ops + half, n - half);
+
+    SegTable *t = NULL;
+    if (first != NULL && second != NULL)
+        t = segTableCompose(first, second);
+
+    segTableDestroy(first);
+    segTableDestroy(second);
+
+    return t;
+}
+
+/**
+ * @brief Check the header of a file image
+ *
+ * @param header Header read from the image
+ * @param path Path of the image, for the error message
+ * @return 1 if the image can be used as is, 0 otherwise
+ */
+static int checkHeader(const ImageHeader *header, const char *path) {
+    if (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0 || header->format != IMAGE_FORMAT) {
+        printf("segTableOpenMapped: %s is not a table image\n", path);
+        return 0;
+    }
+
+    if (header->byteOrder != IMAGE_BYTE_ORDER) {
+        printf("segTableOpenMapped: %s was saved with another byte order\n", path);
+        return 0;
+    }
+
+    if (header->size == 0 || header->size > SIZE_MAX / (3 * sizeof(int64_t))) {
+        printf("segTableOpenMapped: Corrupted image %s\n", path);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Write the header and the arrays of a table
+ *
+ * @param t Table
+ * @param version Number of operations folded in the table
+ * @param file File open for writing
+ * @return 1 on success, 0 on write error
+ */
+static int writeImage(const SegTable *t, size_t version, FILE *file) {
+    ImageHeader header;
+    memset(&header, 0, sizeof(ImageHeader));
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.format = IMAGE_FORMAT;
+    header.byteOrder = IMAGE_BYTE_ORDER;
+    header.size = t->size;
+    header.version = version;
+
+    return fwrite(&header, sizeof(ImageHeader), 1, file) == 1 &&
+           fwrite(t->inStart, sizeof(int64_t), t->size, file) == t->size &&
+           fwrite(t->outStart, sizeof(int64_t), t->size, file) == t->size &&
+           fwrite(t->length, sizeof(int64_t), t->size, file) == t->size;
+}
+
+/**
+ * @brief Write the buffered data of a file and wait for the disk
+ *
+ * @param file File open for writing
+ * @return 1 on success, 0 on write error
+ */
+static int syncFile(FILE *file) {
+    if (fflush(file) != 0)
+        return 0;
+#ifdef SEG_MMAP
+    if (fsync(fileno(file)) != 0)
+        return 0;
+#endif
+    return 1;
+}
@@ -0,0 +1,232 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file segtable.h
+ * @brief Interface of the compacted segment table
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * A segment table is the canonical form of a sequence of operations: the sorted
+ * list of input segments that survive in the output stream. Each segment maps
+ * [inStart, inStart + length) to [outStart, outStart + length). Segments are sorted
+ * on both inStart and outStart, so a position is mapped with a binary search.
+ * The last segment is unbounded (length SEG_INFINITE) since streams have no end.
+ * A table is never modified once built, so it may be shared (see segTableRetain).
+ * Tables are saved as a flat image (header and the three arrays) that is mapped
+ * back in memory as is, without parsing.
+ *
+ */
+
+#ifndef SEGTABLE_H
+#define SEGTABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "magic.h"
+#include "operation.h"
+
+/* Length of the last (unbounded) segment of a table */
+#define SEG_INFINITE INT64_MAX
+
+typedef struct segTable {
+    int64_t *inStart;   // start of each segment in the input stream
+    int64_t *outStart;  // start of each segment in the output stream
+    int64_t *length;    // length of each segment (SEG_INFINITE for the last one)
+    size_t size;        // number of segments (always >= 1)
+    size_t capacity;    // allocated number of segments
+    size_t refs;        // number of holders (segTableDestroy releases one)
+    void *mapping;      // file image holding the arrays, NULL if they are allocated
+    size_t mappingBytes;  // size of the image
+} SegTable;
+
+/* Runs of a range mapping, stored up to maxRuns but all counted */
+typedef struct runList {
+    MAGICrun *runs;     // output array (may be NULL if maxRuns is 0)
+    size_t maxRuns;     // capacity of runs
+    size_t count;       // number of runs found so far
+    MAGICrun last;      // last run found, extended while contiguous
+} RunList;
+
+/**
+ * @brief Creates the identity table (no operation applied)
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *segTableCreate(void);
+
+/**
+ * @brief Creates an empty table, to be filled with segTablePush
+ *
+ * @param capacity Number of segments to reserve
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *segTableAlloc(size_t capacity);
+
+/**
+ * @brief Appends a segment after the last one, growing the table if needed
+ *
+ * Segments must be pushed in increasing order on both streams, the last one
+ * being unbounded. A segment contiguous to the previous one extends it.
+ *
+ * @param t Table
+ * @param inStart Start in the input stream
+ * @param outStart Start in the output stream
+ * @param length Length of the segment (SEG_INFINITE for the last one)
+ *
+ * @return 1 on success, 0 on allocation error
+ */
+int segTablePush(SegTable *t, int64_t inStart, int64_t outStart, int64_t length);
+
+/**
+ * @brief Builds the table equivalent to a chronological sequence of operations
+ *
+ * @param ops Operations in chronological order
+ * @param n Number of operations
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *segTableFromOps(const Operation *ops, size_t n);
+
+/**
+ * @brief Composes two tables: the result applies a, then b
+ *
+ * Runs in O(a->size + b->size).
+ *
+ * @param a First mapping applied
+ * @param b Second mapping applied
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *segTableCompose(const SegTable *a, const SegTable *b);
+
+/**
+ * @brief Inverts a table: the result maps the output stream to the input stream
+ *
+ * Runs in O(t->size), segments being sorted on both streams.
+ *
+ * @param t Table
+ *
+ * @return Pointer to the new table, NULL on allocation error
+ */
+SegTable *segTableInvert(const SegTable *t);
+
+/**
+ * @brief Maps a position through the table with a binary search
+ *
+ * @param t Table
+ * @param direction Mapping direction
+ * @param pos Position to map
+ *
+ * @return Mapped position, -1 if the position has no counterpart
+ */
+int64_t segTableMap(const SegTable *t, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Finds the segment of a position, searching forward from a hint
+ *
+ * Gallops from the hint, so a sequence of non-decreasing positions is located
+ * in O(log distance) each instead of a full binary search.
+ *
+ * @param t Table
+ * @param direction STREAM_IN_OUT to search on inStart, STREAM_OUT_IN on outStart
+ * @param pos Position to locate
+ * @param hint Index of a segment starting at or before pos (0 if unknown)
+ *
+ * @return Index of the last segment starting at or before pos, t->size if none
+ */
+size_t segTableSeek(const SegTable *t, enum MAGICDirection direction, int64_t pos, size_t hint);
+
+/**
+ * @brief Maps positions sorted in non-decreasing order in a single sweep
+ *
+ * Negative positions, and positions mapped past INT_MAX, give -1. in and out may
+ * be the same array.
+ *
+ * @param t Table
+ * @param direction Mapping direction
+ * @param in Positions to map
+ * @param out Mapped positions
+ * @param n Number of positions
+ */
+void segTableMapSorted(const SegTable *t, enum MAGICDirection direction, const int *in, int *out, size_t n);
+
+/**
+ * @brief Maps a range, run by run, in O(log size + runs)
+ *
+ * @param t Table
+ * @param direction Mapping direction
+ * @param pos First position of the range
+ * @param length Length of the range
+ * @param list Runs the range becomes, appended in order
+ */
+void segTableMapRange(const SegTable *t, enum MAGICDirection direction, int64_t pos, int64_t length, RunList *list);
+
+/**
+ * @brief Appends a run to a list, merged with the previous one when contiguous
+ *
+ * @param list List of runs
+ * @param pos First position of the run in the source stream
+ * @param mapped First position of the run in the target stream
+ * @param length Length of the run
+ */
+void runListPush(RunList *list, int64_t pos, int64_t mapped, int64_t length);
+
+/**
+ * @brief Saves a table as a file image, replacing the file atomically
+ *
+ * The image is written to path.tmp, then renamed, so a process opening path sees
+ * either the old image or the new one. A durable image and its rename are synced
+ * to the disk before returning.
+ *
+ * @param t Table
+ * @param version Number of operations folded in the table
+ * @param path Path of the image
+ * @param durable 1 to sync the image, 0 for a temporary image
+ *
+ * @return 1 on success, 0 on error
+ */
+int segTableSave(const SegTable *t, size_t version, const char *path, int durable);
+
+/**
+ * @brief Syncs the directory of a file, so a rename into it survives a crash
+ *
+ * @param path Path of the file
+ *
+ * @return 1 on success (or where files are not synced), 0 on error
+ */
+int segTableSyncDirectory(const char *path);
+
+/**
+ * @brief Opens a file image as a table, mapped read-only in memory
+ *
+ * Nothing is read but the header and the last segment: pages are loaded by the
+ * searches that need them, and shared with every process mapping the same file.
+ * Images from another build are rejected; their content is trusted.
+ *
+ * @param path Path of the image
+ * @param version Output: number of operations folded in the table
+ *
+ * @return Pointer to the table, NULL on error
+ */
+SegTable *segTableOpenMapped(const char *path, size_t *version);
+
+/**
+ * @brief Adds a holder to a table (snapshots share the table of their version)
+ *
+ * @param t Table
+ *
+ * @return t
+ */
+SegTable *segTableRetain(SegTable *t);
+
+/**
+ * @brief Destroys a table, once its last holder releases it
+ *
+ * @param t Table to destroy
+ */
+void segTableDestroy(SegTable *t);
+
+#endif
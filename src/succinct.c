@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "succinct.h"
+
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * \file succinct.c
+ * \brief Implementation of the rank/select index of a segment table
+ * \author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * \version 0.1
+ * \date 04/04/2025
+ *
+ */
+
+/* Implementation of API */
+
+Succinct *succinctFromTable(const SegTable *t, int64_t bound) {
+    Succinct *s = malloc(sizeof(Succinct));
+    if (s == NULL) {
+        printf("succinctFromTable: Allocation error\n");
+        return NULL;
+    }
+
+    s->inLast = t->inStart[t->size - 1];
+    s->outLast = t->outStart[t->size - 1];
+
+    // Past the start of the last segment, positions are shifted: no bit needed
+    int64_t inBound = (s->inLast < bound) ? s->inLast : bound;
+    int64_t outBound = (s->outLast < bound) ? s->outLast : bound;
+    s->in = bitVectorCreate((size_t)inBound);
+    s->out = bitVectorCreate((size_t)outBound);
+    if (s->in == NULL || s->out == NULL) {
+        succinctDestroy(s);
+        return NULL;
+    }
+
+    // The last segment starts at or past the bounds
+    for (size_t i = 0; i + 1 < t->size; i++) {
+        bitVectorSetRange(s->in, (size_t)t->inStart[i], (size_t)(t->inStart[i] + t->length[i]));
+        bitVectorSetRange(s->out, (size_t)t->outStart[i], (size_t)(t->outStart[i] + t->length[i]));
+    }
+
+    if (!bitVectorBuild(s->in) || !bitVectorBuild(s->out)) {
+        succinctDestroy(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+int64_t succinctMap(const Succinct *s, const SegTable *t, enum MAGICDirection direction, int64_t pos) {
+    if (pos < 0)
+        return -1;
+
+    const BitVector *from = (direction == STREAM_IN_OUT) ? s->in : s->out;
+    const BitVector *to = (direction == STREAM_IN_OUT) ? s->out : s->in;
+    int64_t fromLast = (direction == STREAM_IN_OUT) ? s->inLast : s->outLast;
+    int64_t toLast = (direction == STREAM_IN_OUT) ? s->outLast : s->inLast;
+
+    if (pos >= fromLast)
+        return toLast + (pos - fromLast);
+
+    if ((size_t)pos < from->nbBits) {
+        if (!bitVectorGet(from, (size_t)pos))
+            return -1; // removed (or added) byte
+
+        // The k-th byte with a counterpart on one stream is the k-th on the other
+        size_t mapped = bitVectorSelect(to, bitVectorRank(from, (size_t)pos));
+        if (mapped < to->nbBits)
+            return (int64_t)mapped;
+    }
+
+    // Counterpart past the bound
+    return segTableMap(t, direction, pos);
+}
+
+size_t succinctBytes(const Succinct *s) {
+    return (s == NULL) ? 0 : sizeof(Succinct) + bitVectorBytes(s->in) + bitVectorBytes(s->out);
+}
+
+void succinctDestroy(Succinct *s) {
+    if (s == NULL)
+        return;
+
+    bitVectorDestroy(s->in);
+    bitVectorDestroy(s->out);
+    free(s);
+}
@@ -0,0 +1,73 @@
+/**
+ * INFO0027: - Programming Techniques (Algorithmics)
+ *  Project 1: Bytestream mapper
+ *
+ * @file succinct.h
+ * @brief Interface of the rank/select index of a segment table (succinct engine)
+ * @author Boustani Mehdi -- Albashityalshaier Abdelkader
+ * @version 0.1
+ * @date 04/04/2025
+ *
+ * The surviving bytes of the input stream and the output bytes coming from the
+ * input are two bitvectors. The k-th surviving input byte is the k-th output byte
+ * coming from the input, so a mapping is a rank in one vector and a select in the
+ * other, both O(1) (see bitvector.h). Past the last segment of the table a mapping is
+ * a shift; the vectors stop at a bound, past which the table is searched instead.
+ *
+ */
+
+#ifndef SUCCINCT_H
+#define SUCCINCT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "magic.h"
+#include "segtable.h"
+#include "bitvector.h"
+
+typedef struct succinct {
+    BitVector *in;       // surviving input bytes, up to min(bound, inLast)
+    BitVector *out;      // output bytes coming from the input, up to min(bound, outLast)
+    int64_t inLast;      // start of the last (unbounded) segment in the input stream
+    int64_t outLast;     // start of the last (unbounded) segment in the output stream
+} Succinct;
+
+/**
+ * @brief Builds the index of a table, in O(size + bound / 64)
+ *
+ * @param t Table
+ * @param bound Number of bytes of each stream covered by the vectors
+ *
+ * @return Pointer to the new index, NULL on allocation error
+ */
+Succinct *succinctFromTable(const SegTable *t, int64_t bound);
+
+/**
+ * @brief Maps a position by a rank and a select, or through the table past the bound
+ *
+ * @param s Index
+ * @param t Table the index was built from
+ * @param direction Mapping direction
+ * @param pos Position to map
+ *
+ * @return Mapped position, -1 if the position has no counterpart
+ */
+int64_t succinctMap(const Succinct *s, const SegTable *t, enum MAGICDirection direction, int64_t pos);
+
+/**
+ * @brief Number of bytes allocated by an index
+ *
+ * @param s Index (may be NULL)
+ *
+ * @return Number of bytes
+ */
+size_t succinctBytes(const Succinct *s);
+
+/**
+ * @brief Destroys an index
+ *
+ * @param s Index to destroy
+ */
+void succinctDestroy(Succinct *s);
+
+#endif